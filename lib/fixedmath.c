@@ -0,0 +1,105 @@
+// 16.16 fixed point math for floats. pass this file to the compiler in front of the files that use it:
+//     i2c2 fixedmath.c main.c -o main.s
+// each function looks up the two closest entries of a table in memory and interpolates between them,
+// which is good to about 1/10000. the last entry of each table is repeated, for looking up the end itself
+
+// sqrt(i / 64) for i = 16 ... 64
+float fixed_sqrt_table[50] = {
+        0.500000, 0.515388, 0.530330, 0.544862, 0.559017, 0.572822, 0.586302, 0.599479, 0.612372,
+        0.625000, 0.637377, 0.649519, 0.661438, 0.673146, 0.684653, 0.695971, 0.707107, 0.718070,
+        0.728869, 0.739510, 0.750000, 0.760345, 0.770552, 0.780625, 0.790569, 0.800391, 0.810093,
+        0.819680, 0.829156, 0.838525, 0.847791, 0.856957, 0.866025, 0.875000, 0.883883, 0.892679,
+        0.901388, 0.910014, 0.918559, 0.927025, 0.935414, 0.943729, 0.951972, 0.960143, 0.968246,
+        0.976281, 0.984251, 0.992157, 1.000000, 1.000000
+};
+
+// sin(i * pi / 128) for i = 0 ... 64, a quarter of the circle
+float fixed_sin_table[66] = {
+        0.000000, 0.024541, 0.049068, 0.073565, 0.098017, 0.122411, 0.146730, 0.170962, 0.195090,
+        0.219101, 0.242980, 0.266713, 0.290285, 0.313682, 0.336890, 0.359895, 0.382683, 0.405241,
+        0.427555, 0.449611, 0.471397, 0.492898, 0.514103, 0.534998, 0.555570, 0.575808, 0.595699,
+        0.615232, 0.634393, 0.653173, 0.671559, 0.689541, 0.707107, 0.724247, 0.740951, 0.757209,
+        0.773010, 0.788346, 0.803208, 0.817585, 0.831470, 0.844854, 0.857729, 0.870087, 0.881921,
+        0.893224, 0.903989, 0.914210, 0.923880, 0.932993, 0.941544, 0.949528, 0.956940, 0.963776,
+        0.970031, 0.975702, 0.980785, 0.985278, 0.989177, 0.992480, 0.995185, 0.997290, 0.998795,
+        0.999699, 1.000000, 1.000000
+};
+
+// atan(i / 32) for i = 0 ... 32
+float fixed_atan_table[34] = {
+        0.000000, 0.031240, 0.062419, 0.093477, 0.124355, 0.154997, 0.185348, 0.215358, 0.244979,
+        0.274167, 0.302885, 0.331096, 0.358771, 0.385883, 0.412410, 0.438337, 0.463648, 0.488334,
+        0.512389, 0.535811, 0.558599, 0.580756, 0.602287, 0.623199, 0.643501, 0.663203, 0.682317,
+        0.700854, 0.718830, 0.736257, 0.753151, 0.769526, 0.785398, 0.785398
+};
+
+float sqrt(float x){
+    if (x <= 0.0){ return 0.0; }
+    // x = m * scale^2, with m in [0.25, 1)
+    float m = x;
+    float scale = 1.0;
+    while (m >= 1.0){
+        m = m / 4;
+        scale = scale * 2;
+    }
+    while (m < 0.25){
+        m = m * 4;
+        scale = scale / 2;
+    }
+    float p = m * 64;
+    int i = p;
+    float f = p - i;
+    float low = fixed_sqrt_table[i - 16];
+    float high = fixed_sqrt_table[i - 15];
+    return (low + (high - low) * f) * scale;
+}
+
+float sin(float x){
+    // down to a single turn, then 256ths of a turn
+    int turns = x * 0.159155;
+    float p = (x - turns * 6.283185) * 40.743665;
+    if (p < 0.0){ p = p + 256; }
+    int i = p;
+    int quadrant = i / 64;
+    float pos = p - quadrant * 64;
+    // the second and fourth quarters run backwards through the table
+    if (quadrant == 1){ pos = 64 - pos; }
+    if (quadrant == 3){ pos = 64 - pos; }
+    int k = pos;
+    float f = pos - k;
+    float low = fixed_sin_table[k];
+    float high = fixed_sin_table[k + 1];
+    float s = low + (high - low) * f;
+    if (quadrant >= 2){ return 0.0 - s; }
+    return s;
+}
+
+float cos(float x){
+    return sin(x + 1.570796);
+}
+
+float atan2(float y, float x){
+    float ax = x;
+    if (ax < 0.0){ ax = 0.0 - ax; }
+    float ay = y;
+    if (ay < 0.0){ ay = 0.0 - ay; }
+    if (ax == 0.0 && ay == 0.0){ return 0.0; }
+    // the table covers 0 to 45 degrees, the rest is reflected into it
+    float r = 0.0;
+    if (ay > ax){
+        r = ax / ay;
+    }
+    else {
+        r = ay / ax;
+    }
+    float p = r * 32;
+    int k = p;
+    float f = p - k;
+    float low = fixed_atan_table[k];
+    float high = fixed_atan_table[k + 1];
+    float a = low + (high - low) * f;
+    if (ay > ax){ a = 1.570796 - a; }
+    if (x < 0.0){ a = 3.141593 - a; }
+    if (y < 0.0){ a = 0.0 - a; }
+    return a;
+}
@@ -2,15 +2,86 @@
 #include <fstream>
 #include <string>
 #include <bitset>
+#include <chrono>
+#include <sstream>
 #include "parsing/tokenize.h"
 #include "parsing/parse.h"
 #include "mipsCompiler/MipsCompiler.h"
+#include "mipsCompiler/inliner.h"
+#include "mipsCompiler/specializer.h"
+#include "mipsCompiler/globalPromotion.h"
+#include "mipsCompiler/runtime.h"
+#include "mipsCompiler/memoryBudget.h"
+
+// one 32 bit binary word per line, filled up to 4096 words
+void write_mem(std::ofstream& out, const std::vector<uint32_t>& mem){
+    for (uint32_t word : mem) {
+        std::bitset<32> bits(word);
+        out.write(bits.to_string().c_str(), 32);
+        out << std::endl;
+    }
+    if (mem.size() < 4096){
+        for (int i = 0; i < 4096 - mem.size(); i++) {
+            out << "00000000000000000000000000000000" << std::endl;
+        }
+    }
+}
+
+void write_numbers(std::ofstream& out, const std::vector<uint32_t>& mem){
+    out << "{";
+    for (int i = 0; i < mem.size(); i++) {
+        out << mem[i];
+        if (i < mem.size() - 1) out << ", ";
+    }
+    out << "}";
+}
+
+// the output file with its extension changed to .dmem
+std::string data_file_name(const std::string& output_file){
+    size_t dot = output_file.find_last_of('.');
+    size_t slash = output_file.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return output_file + ".dmem";
+    return output_file.substr(0, dot) + ".dmem";
+}
+
+// #pragma optimize <function> <level> gives a function a level of its own, like O0 to keep it as it's written
+void read_optimize_pragmas(const std::vector<Token*>& ast, MipsBuilder& builder){
+    for (Token* token : ast) {
+        if (token->type != TYPE_KEYWORD || token->val_type != PRAGMA) continue;
+        std::istringstream words(token->lexeme);
+        std::string kind, function, level, rest;
+        words >> kind;
+        if (kind != "optimize") continue;
+        if (!(words >> function >> level) || (words >> rest))
+            throw std::runtime_error("Expected #pragma optimize <function> <level> at line " + std::to_string(token->line));
+        builder.setFunctionLevel(function, level);
+    }
+}
+
+// the steps of main are timed like the builder's passes, for -ftime-report
+void add_phase(std::vector<PassTiming>& phases, const std::string& name, std::chrono::steady_clock::time_point start,
+               int before, int after){
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    phases.push_back({name, 1, ms, before, after});
+}
 
 int main(int argc, char** argv) {
     /*
      -o = output file
      -type = type of output (s, mem)
      -r a b ... = run, print variables a, b, ... at end
+     -peephole-stats = print how many times each peephole rule was applied
+     -schedule-stats = print the stall cycles the scheduler removed from each function
+     -O0, -O1, -O2, -Os = optimization level (default 1). -O0 only cleans up after the compiler.
+                          -O2 also copies functions for constant arguments and inlines small functions without the inline keyword.
+                          -Os is -O1 without unrolling loops, hoisting out of loops or scheduling.
+                          from -O1, globals set to numbers start out in dmem instead of being stored by the program.
+                          their values go in a .dmem file next to the output, in the same format, for dmem to be loaded with.
+                          #pragma optimize <function> <level> compiles one function at another level
+     -ftime-report = print how long each step and pass took, and how many instructions it added or removed
+     -inline-report = print what the inliner decided for each call
+     -memory-report = print each function's frame and the most stack it can use, and how much of dmem is left
+     -memory-warn = only warn, instead of failing, when the stack can grow into the globals
      */
 
     std::string output_file;
@@ -18,6 +89,14 @@ int main(int argc, char** argv) {
     std::vector<std::string> runVars;
     std::string output_type = "s";
     bool run = false;
+    bool peephole_stats = false;
+    bool schedule_stats = false;
+    bool inline_report = false;
+    bool memory_report = false;
+    bool memory_warn = false;
+    bool time_report = false;
+    int opt_level = 1;
+    bool size_first = false;
     for (int i = 1; i < argc; i++) {
         if (std::string(argv[i]) == "-o") {
             output_file = argv[++i];
@@ -31,6 +110,31 @@ int main(int argc, char** argv) {
         else if (std::string(argv[i]) == "-type"){
             output_type = argv[++i];
         }
+        else if (std::string(argv[i]) == "-peephole-stats"){
+            peephole_stats = true;
+        }
+        else if (std::string(argv[i]) == "-schedule-stats"){
+            schedule_stats = true;
+        }
+        else if (std::string(argv[i]) == "-inline-report"){
+            inline_report = true;
+        }
+        else if (std::string(argv[i]) == "-memory-report"){
+            memory_report = true;
+        }
+        else if (std::string(argv[i]) == "-memory-warn"){
+            memory_warn = true;
+        }
+        else if (std::string(argv[i]) == "-ftime-report"){
+            time_report = true;
+        }
+        else if (std::string(argv[i]) == "-Os"){
+            opt_level = 1;
+            size_first = true;
+        }
+        else if (std::string(argv[i]).size() == 3 && std::string(argv[i]).substr(0, 2) == "-O" && isdigit(argv[i][2])){
+            opt_level = argv[i][2] - '0';
+        }
         else {
             files.emplace_back(argv[i]);
         }
@@ -43,6 +147,8 @@ int main(int argc, char** argv) {
         std::cerr << "No output file" << std::endl;
         return 1;
     }
+    std::vector<PassTiming> phases;
+    auto start = std::chrono::steady_clock::now();
     std::vector<Token*> tokens;
     for (const std::string& file : files) {
         std::ifstream in(file);
@@ -61,26 +167,100 @@ int main(int argc, char** argv) {
 
     TokenIterator tokens_iter(tokens);
     Scope scope(nullptr);
+    declare_runtime(&scope);
     std::vector<Token*> ast = parse(tokens_iter, &scope);
 
     sort_ast(&ast, &scope);
+    add_phase(phases, "parse", start, 0, 0);
 
+    std::string level = size_first ? "Os" : opt_level == 0 ? "O0" : opt_level == 1 ? "O1" : "O2";
     MipsBuilder builder;
-    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    builder.addInstruction(new InstrAddi(29, 29, DMEM_WORDS - 1), "");
+    read_optimize_pragmas(ast, builder);
     VariableTracker tracker(&builder);
+    tracker.set_data_image(opt_level >= 1);
+    tracker.set_size_first(size_first);
+    if (opt_level >= 2) {
+        start = std::chrono::steady_clock::now();
+        specialize_functions(ast, &tracker);
+        add_phase(phases, "specialize", start, 0, 0);
+        start = std::chrono::steady_clock::now();
+        std::vector<InlineDecision> decisions = auto_inline(ast, &tracker);
+        add_phase(phases, "inline", start, 0, 0);
+        if (inline_report) {
+            for (const InlineDecision& d : decisions) {
+                std::string caller = d.caller.empty() ? "top level" : d.caller;
+                printf("%-10s %-28s line %-4d size %-3d loops %d  %s\n", d.inlined ? "inlined" : "kept call",
+                       (d.callee + " in " + caller).c_str(), d.line, d.size, d.loop_depth, d.reason.c_str());
+            }
+        }
+    }
+    start = std::chrono::steady_clock::now();
+    int before = builder.numInstructions();
+    find_global_effects(ast, &tracker);
     BreakScope breakScope;
     compile_instructions(&breakScope, ast, &builder, &tracker);
+    add_phase(phases, "compile", start, before, builder.numInstructions());
 
+    start = std::chrono::steady_clock::now();
+    before = builder.numInstructions();
+    link_runtime(&builder, &tracker);
+    add_phase(phases, "link runtime", start, before, builder.numInstructions());
+
+    start = std::chrono::steady_clock::now();
+    MemoryBudget budget = analyze_memory_budget(ast, &tracker);
+    add_phase(phases, "memory budget", start, 0, 0);
     for (Token* token : ast) {
         delete token;
     }
-
+    for (const std::string& warning : budget.warnings) {
+        std::cerr << "warning: " << warning << std::endl;
+    }
+    if (memory_report) {
+        for (const FunctionStack& f : budget.functions) {
+            printf("%-20s frame %-4d depth %-5d %s\n", f.name.c_str(), f.frame, f.depth, show_chain(f.deepest).c_str());
+        }
+        printf("stack %d words, globals %d words, %d words free of %d\n", budget.stack, budget.globals,
+               budget.free_words, DMEM_WORDS);
+    }
+    if (budget.free_words < 0) {
+        std::string chain = budget.deepest.empty() ? "" : " through " + show_chain(budget.deepest);
+        std::cerr << (memory_warn ? "warning: " : "error: ") << "the stack can reach " << budget.stack << " words"
+                  << chain << ", " << -budget.free_words << " more than dmem has room for after "
+                  << budget.globals << " words of globals" << std::endl;
+        if (!memory_warn) return 1;
+    }
     int mem_loc = tracker.get_mem_offset();
     builder.prependInstruction(new InstrAddi(28, 0, mem_loc));
 
-    builder.simplify();
+    builder.simplify(level);
     builder.linkLabels();
 
+    if (time_report) {
+        std::vector<PassTiming> passes = builder.getPassTimings();
+        phases.insert(phases.end(), passes.begin(), passes.end());
+        double total = 0;
+        for (const PassTiming& p : phases) total += p.ms;
+        printf("%-16s %4s %10s %6s  %s\n", "pass", "runs", "time", "", "instructions");
+        for (const PassTiming& p : phases) {
+            printf("%-16s %4d %8.3fms %5.1f%%", p.pass.c_str(), p.runs, p.ms, total > 0 ? 100 * p.ms / total : 0);
+            if (p.before > 0 || p.after > 0) printf("  %+d", p.after - p.before);
+            printf("\n");
+        }
+        printf("%-16s %4s %8.3fms\n", "total", "", total);
+    }
+
+    if (peephole_stats) {
+        for (const auto& [rule, hits] : builder.getPeepholeHits()) {
+            printf("%-28s %d\n", rule.c_str(), hits);
+        }
+    }
+    if (schedule_stats) {
+        for (const auto& [function, stalls] : builder.getStallsRemoved()) {
+            printf("%-28s %d stall cycles removed\n", function.c_str(), stalls);
+        }
+    }
+
     // save to file
     if (output_type == "s") {
         std::ofstream out(output_file);
@@ -97,17 +277,7 @@ int main(int argc, char** argv) {
             std::cerr << "Could not open output file " << output_file << std::endl;
             return 1;
         }
-        std::vector<uint32_t> mem = builder.export_mem();
-        for (uint32_t word : mem) {
-            std::bitset<32> bits(word);
-            out.write(bits.to_string().c_str(), 32);
-            out << std::endl;
-        }
-        if (mem.size() < 4096){
-            for (int i = 0; i < 4096 - mem.size(); i++) {
-                out << "00000000000000000000000000000000" << std::endl;
-            }
-        }
+        write_mem(out, builder.export_mem());
     }
     else if (output_type == "numbers"){
         std::vector<uint32_t> mem = builder.export_mem();
@@ -116,21 +286,30 @@ int main(int argc, char** argv) {
             std::cerr << "Could not open output file " << output_file << std::endl;
             return 1;
         }
-        out << "{";
-        for (int i = 0; i < mem.size(); i++) {
-            out << mem[i];
-            if (i < mem.size() - 1) out << ", ";
-        }
-        out << "}";
+        write_numbers(out, mem);
     }
     else {
         std::cerr << "Invalid output type " << output_type << std::endl;
         return 1;
     }
 
+    std::vector<int32_t> data = tracker.get_static_data();
+    if (!data.empty()) {
+        std::string data_file = data_file_name(output_file);
+        std::ofstream out(data_file);
+        if (!out.is_open()) {
+            std::cerr << "Could not open output file " << data_file << std::endl;
+            return 1;
+        }
+        std::vector<uint32_t> words(data.begin(), data.end());
+        if (output_type == "numbers") write_numbers(out, words);
+        else write_mem(out, words);
+    }
+
     if (run){
         std::vector<Instruction*> instructions = builder.getInstructions();
-        MipsRunner runner(2048, instructions.data(), instructions.size());
+        MipsRunner runner(DMEM_WORDS, instructions.data(), instructions.size());
+        runner.load_dmem(data);
         int num_cycles = runner.run(50000);
         printf("Ran for %d cycles\n", num_cycles);
         for (const std::string& var : runVars){
@@ -39,6 +39,14 @@ public:
     bool is_noop(){
         return rd == 0 && rs == 0 && rt == 0;
     }
+    Operands get_operands() override{
+        return {rd, rs, rt, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        rt = ops.rt;
+    }
     std::string export_str() override{
         return "add $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", $" + std::to_string(rt);
     }
@@ -72,6 +80,14 @@ public:
             regfile->set(RSTATUS, 2);
         }
     }
+    Operands get_operands() override{
+        return {rd, rs, -1, imm};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        imm = ops.imm;
+    }
     std::string export_str() override{
         return "addi $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", " + std::to_string(imm);
     }
@@ -103,6 +119,14 @@ public:
             regfile->set(RSTATUS, 3);
         }
     }
+    Operands get_operands() override{
+        return {rd, rs, rt, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        rt = ops.rt;
+    }
     std::string export_str() override{
         return "sub $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", $" + std::to_string(rt);
     }
@@ -129,6 +153,14 @@ public:
     void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) override{
         regfile->set(rd, regfile->get(rs) & regfile->get(rt));
     }
+    Operands get_operands() override{
+        return {rd, rs, rt, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        rt = ops.rt;
+    }
     std::string export_str() override{
         return "and $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", $" + std::to_string(rt);
     }
@@ -155,6 +187,14 @@ public:
     void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) override{
         regfile->set(rd, regfile->get(rs) | regfile->get(rt));
     }
+    Operands get_operands() override{
+        return {rd, rs, rt, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        rt = ops.rt;
+    }
     std::string export_str() override{
         return "or $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", $" + std::to_string(rt);
     }
@@ -182,6 +222,14 @@ public:
     void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) override{
         regfile->set(rd, regfile->get(rs) << shamt);
     }
+    Operands get_operands() override{
+        return {rd, rs, -1, shamt};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        shamt = ops.imm;
+    }
     std::string export_str() override{
         return "sll $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", " + std::to_string(shamt);
     }
@@ -207,6 +255,14 @@ public:
     void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) override{
         regfile->set(rd, (int32_t)regfile->get(rs) >> shamt);
     }
+    Operands get_operands() override{
+        return {rd, rs, -1, shamt};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        shamt = ops.imm;
+    }
     std::string export_str() override{
         return "sra $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", " + std::to_string(shamt);
     }
@@ -238,6 +294,14 @@ public:
             regfile->set(RSTATUS, 4);
         }
     }
+    Operands get_operands() override{
+        return {rd, rs, rt, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        rt = ops.rt;
+    }
     std::string export_str() override{
         return "mul $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", $" + std::to_string(rt);
     }
@@ -267,6 +331,14 @@ public:
         int32_t result = (a * b) >> 16;
         regfile->set(rd, result);
     }
+    Operands get_operands() override{
+        return {rd, rs, rt, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        rt = ops.rt;
+    }
     std::string export_str() override{
         return "hmul $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", $" + std::to_string(rt);
     }
@@ -300,6 +372,14 @@ public:
             regfile->set(RSTATUS, 5);
         }
     }
+    Operands get_operands() override{
+        return {rd, rs, rt, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        rt = ops.rt;
+    }
     std::string export_str() override{
         return "div $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", $" + std::to_string(rt);
     }
@@ -326,6 +406,14 @@ public:
     void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) override{
         regfile->set(rd, regfile->get(rs) < regfile->get(rt) ? 1 : 0);
     }
+    Operands get_operands() override{
+        return {rd, rs, rt, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        rt = ops.rt;
+    }
     std::string export_str() override{
         return "slt $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", $" + std::to_string(rt);
     }
@@ -352,6 +440,14 @@ public:
     void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) override{
         regfile->set(rd, regfile->get(rs) > regfile->get(rt) ? 1 : 0);
     }
+    Operands get_operands() override{
+        return {rd, rs, rt, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        rt = ops.rt;
+    }
     std::string export_str() override{
         return "sgt $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", $" + std::to_string(rt);
     }
@@ -379,6 +475,14 @@ public:
     void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) override{
         regfile->set(rd, regfile->get(rs) >= regfile->get(rt) ? 1 : 0);
     }
+    Operands get_operands() override{
+        return {rd, rs, rt, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        rt = ops.rt;
+    }
     std::string export_str() override{
         return "sge $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", $" + std::to_string(rt);
     }
@@ -418,6 +522,14 @@ public:
             printf("Writing pin %d %s to %s\n", pin, writing_mode ? "mode" : "value", mode_str.c_str());
         }
     }
+    Operands get_operands() override{
+        return {rd, rs, -1, imm};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        imm = ops.imm;
+    }
     std::string export_str() override{
         return "sw $" + std::to_string(rd) + ", " + std::to_string(imm) + "($" + std::to_string(rs) + ")";
     }
@@ -449,6 +561,14 @@ public:
             printf("Reading pin %d\n", pin);
         }
     }
+    Operands get_operands() override{
+        return {rd, rs, -1, imm};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+        imm = ops.imm;
+    }
     std::string export_str() override{
         return "lw $" + std::to_string(rd) + ", " + std::to_string(imm) + "($" + std::to_string(rs) + ")";
     }
@@ -476,6 +596,9 @@ public:
         if (i == nullptr) throw std::runtime_error("Label " + label + " not found");
         target = i->line_num;
     }
+    std::string get_target() override{
+        return label;
+    }
     bool replace_target(std::string old_target, std::string new_target) override{
         if (label == old_target){
             label = new_target;
@@ -513,6 +636,9 @@ public:
         if (i == nullptr) throw std::runtime_error("Label " + label + " not found");
         imm = i->line_num - line_num - 1;
     }
+    std::string get_target() override{
+        return label;
+    }
     bool replace_target(std::string old_target, std::string new_target) override{
         if (label == old_target){
             label = new_target;
@@ -527,6 +653,13 @@ public:
             *pc += imm;
         }
     }
+    Operands get_operands() override{
+        return {rd, rs, -1, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+    }
     std::string export_str() override{
         return "bne $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", " + label;
     }
@@ -548,6 +681,12 @@ public:
     void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) override{
         *pc = (uint32_t)regfile->get(rd);
     }
+    Operands get_operands() override{
+        return {rd, -1, -1, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+    }
     std::string export_str() override{
         return "jr $" + std::to_string(rd);
     }
@@ -572,6 +711,9 @@ public:
         if (i == nullptr) throw std::runtime_error("Label " + label + " not found");
         target = i->line_num;
     }
+    std::string get_target() override{
+        return label;
+    }
     bool replace_target(std::string old_target, std::string new_target) override{
         if (label == old_target){
             label = new_target;
@@ -609,6 +751,9 @@ public:
         if (i == nullptr) throw std::runtime_error("Label " + label + " not found");
         imm = i->line_num - line_num - 1;
     }
+    std::string get_target() override{
+        return label;
+    }
     bool replace_target(std::string old_target, std::string new_target) override{
         if (label == old_target){
             label = new_target;
@@ -623,6 +768,13 @@ public:
             *pc += imm;
         }
     }
+    Operands get_operands() override{
+        return {rd, rs, -1, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+        rs = ops.rs;
+    }
     std::string export_str() override{
         return "blt $" + std::to_string(rd) + ", $" + std::to_string(rs) + ", " + label;
     }
@@ -634,6 +786,53 @@ public:
     }
 };
 
+/// Puts the address of a label in a register, so it can be stored and jumped to later with jr.
+/// An addi from $0 once the label is linked
+class InstrLa : public Instruction{
+private:
+    uint8_t rd;
+    uint32_t target;
+    std::string label;
+public:
+    InstrLa(uint8_t rd, std::string label): Instruction(I_LA){
+        this->rd = rd;
+        this->label = std::move(label);
+        this->target = 0;
+    }
+    void link_labels(std::map<std::string, Instruction*> label_map) override{
+        Instruction* i = label_map[label];
+        if (i == nullptr) throw std::runtime_error("Label " + label + " not found");
+        target = i->line_num;
+    }
+    std::string get_target() override{
+        return label;
+    }
+    bool replace_target(std::string old_target, std::string new_target) override{
+        if (label == old_target){
+            label = new_target;
+            return true;
+        }
+        return false;
+    }
+    void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) override{
+        regfile->set(rd, (int32_t) target);
+    }
+    Operands get_operands() override{
+        return {rd, -1, -1, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+    }
+    std::string export_str() override{
+        return "addi $" + std::to_string(rd) + ", $0, " + std::to_string(target);
+    }
+    uint32_t export_mem() override{
+        uint8_t opcode = 0b00101;
+        uint8_t rd = this->rd & 0b11111;
+        return opcode << 27 | rd << 22 | (target & 0b11111111111111111);
+    }
+};
+
 // SPECIAL
 class InstrBex : public Instruction{
 private:
@@ -649,6 +848,9 @@ public:
         if (i == nullptr) throw std::runtime_error("Label " + label + " not found");
         target = i->line_num;
     }
+    std::string get_target() override{
+        return label;
+    }
     bool replace_target(std::string old_target, std::string new_target) override{
         if (label == old_target){
             label = new_target;
@@ -698,6 +900,12 @@ public:
     void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) override{
         printf("Register %d = %d\n", rd, regfile->get(rd));
     }
+    Operands get_operands() override{
+        return {rd, -1, -1, 0};
+    }
+    void set_operands(Operands ops) override{
+        rd = ops.rd;
+    }
     std::string export_str() override{
         return "";
     }
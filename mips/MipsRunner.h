@@ -47,11 +47,19 @@ public:
 enum InstructionType{
     I_ADD, I_ADDI, I_SUB, I_AND, I_OR, I_SLL, I_SRA, I_MUL, I_HMUL, I_DIV, I_SLT, I_SGT, I_SGE,
     I_SW, I_LW,
-    I_J, I_BNE, I_JR, I_JAL, I_BLT,
+    I_J, I_BNE, I_JR, I_JAL, I_BLT, I_LA,
     I_BEX, I_SETX,
     I_TEST_LOG
 };
 
+/// Register and immediate fields of an instruction, -1 for registers it doesn't have
+struct Operands{
+    int rd;
+    int rs;
+    int rt;
+    int imm;
+};
+
 class Instruction{
 public:
     int line_num;
@@ -62,6 +70,9 @@ public:
     }
     virtual void link_labels(std::map<std::string, Instruction*> label_map){}
     virtual bool replace_target(std::string old_target, std::string new_target){return false;}
+    virtual std::string get_target(){return "";}
+    virtual Operands get_operands(){return {-1, -1, -1, 0};}
+    virtual void set_operands(Operands ops){}
     virtual void execute(int32_t *dmem, RegisterFile* regfile, uint32_t* pc) = 0;
     virtual std::string export_str() = 0;
     virtual uint32_t export_mem() = 0;
@@ -88,6 +99,11 @@ public:
         this->imem = new_imem;
         this->imem_size = new_imem_size;
     }
+    /// Fills dmem from address 0 with a data image, like the one the compiler makes for global initializers
+    void load_dmem(const std::vector<int32_t>& data){
+        if (data.size() > dmem_size) throw std::runtime_error("Data image doesn't fit in dmem");
+        for (int i = 0; i < data.size(); i++) dmem[i] = data[i];
+    }
     int32_t get_reg(uint8_t regNum){
         return regfile.get(regNum);
     }
@@ -95,6 +95,7 @@ void assembleMips(const std::string& mips, MipsBuilder* builder, VariableTracker
     MipsTokenizer tokenizer;
     tokenizer.code = mips;
     tokenizer.index = 0;
+    int start = builder->numInstructions();
 
     std::string token = next_token(&tokenizer);
     while (!token.empty()){
@@ -213,4 +214,5 @@ void assembleMips(const std::string& mips, MipsBuilder* builder, VariableTracker
 
         token = next_token(&tokenizer);
     }
+    builder->markHandWritten(start);
 }
\ No newline at end of file
@@ -3,6 +3,10 @@
 //
 
 #include "MipsBuilder.h"
+#include <algorithm>
+#include <chrono>
+#include "MipsLoops.h"
+#include "MipsScheduler.h"
 
 void MipsBuilder::addInstruction(Instruction *instr, const std::string &label) {
     instructions.push_back(instr);
@@ -16,10 +20,37 @@ void MipsBuilder::prependInstruction(Instruction *instr) {
     instructions.insert(instructions.begin(), instr);
 }
 
+void MipsBuilder::insertInstruction(int index, Instruction *instr) {
+    instructions.insert(instructions.begin() + index, instr);
+}
+
+int MipsBuilder::numInstructions() {
+    return (int) instructions.size();
+}
+
+void MipsBuilder::markHandWritten(int start) {
+    for (int i = start; i < (int) instructions.size(); i++){
+        handWritten.insert(instructions[i]);
+    }
+}
+
 std::string MipsBuilder::genUnnamedLabel() {
     return "\"" + std::to_string(unnamedLabelCounter++) + "\"";
 }
 
+void MipsBuilder::addDataLabel(int address, const std::string& label) {
+    dataLabels[address] = label;
+}
+
+std::map<int, int32_t> MipsBuilder::getDataLabelWords() {
+    std::map<int, int32_t> words;
+    for (const auto& [address, label] : dataLabels) {
+        if (labels.find(label) == labels.end()) throw std::runtime_error("Label " + label + " not found");
+        words[address] = labels[label]->line_num;
+    }
+    return words;
+}
+
 void MipsBuilder::linkLabels() {
     for (int i = 0; i < instructions.size(); i++){
         instructions[i]->line_num = i;
@@ -41,6 +72,11 @@ bool MipsBuilder::replaceLabel(const std::string &oldLabel, const std::string &n
     for (Instruction *instr : instructions) {
         changed |= instr->replace_target(oldLabel, newLabel);
     }
+    for (auto& [address, label] : dataLabels) {
+        if (label != oldLabel) continue;
+        label = newLabel;
+        changed = true;
+    }
     labels.erase(oldLabel);
     return changed;
 }
@@ -95,9 +131,15 @@ void MipsBuilder::filterDoubleJJumps(){
         std::string labelTo = j->label;
         if (labels.find(labelTo) == labels.end())
             throw std::runtime_error("Label " + labelTo + " not found");
+        // a j to itself is an empty infinite loop
+        if (jLabel == labelTo) continue;
         bool result = replaceLabel(jLabel, labelTo);
         if (result) {
             invLabels.erase(j);
+            // the j is still needed if the instruction before it can fall into it
+            bool falls_in = i > 0 && instructions[i - 1]->type != InstructionType::I_J &&
+                            instructions[i - 1]->type != InstructionType::I_JR;
+            if (falls_in) continue;
             instructions.erase(instructions.begin() + i);
             i--;
         }
@@ -134,19 +176,16 @@ void MipsBuilder::filterJs(){
     filterJToNext();
 }
 
-void MipsBuilder::simplify() {
-    filterNoops();
-    filterJs();
-
+void MipsBuilder::removeUnusedLabels() {
     std::vector<std::string> to_remove;
 
-    // remove unused labels
     for (auto pair : labels){
         std::string label = pair.first;
         bool result = false;
         for (Instruction *instr : instructions) {
             result |= instr->replace_target(label, label);
         }
+        for (const auto& [address, data_label] : dataLabels) result |= data_label == label;
         if (!result) to_remove.push_back(label);
     }
     for (const std::string& label : to_remove) {
@@ -156,10 +195,311 @@ void MipsBuilder::simplify() {
     }
 }
 
+void MipsBuilder::removeUnreachable() {
+    std::map<Instruction*, int> index;
+    for (int i = 0; i < instructions.size(); i++) index[instructions[i]] = i;
+
+    // start from the first instruction, every function that gets called and every label in data memory
+    std::vector<int> to_visit = {0};
+    for (Instruction* instr : instructions) {
+        if (instr->type != InstructionType::I_JAL) continue;
+        if (labels.find(instr->get_target()) == labels.end()) return;
+        to_visit.push_back(index[labels[instr->get_target()]]);
+    }
+    for (const auto& [address, label] : dataLabels) {
+        if (labels.find(label) == labels.end()) return;
+        to_visit.push_back(index[labels[label]]);
+    }
+
+    std::vector<bool> reachable(instructions.size(), false);
+    while (!to_visit.empty()) {
+        int i = to_visit.back();
+        to_visit.pop_back();
+        if (i >= instructions.size() || reachable[i]) continue;
+        reachable[i] = true;
+
+        Instruction* instr = instructions[i];
+        std::string target = instr->get_target();
+        if (!target.empty() && instr->type != InstructionType::I_JAL) {
+            if (labels.find(target) == labels.end()) return;
+            to_visit.push_back(index[labels[target]]);
+        }
+        if (instr->type != InstructionType::I_J && instr->type != InstructionType::I_JR) to_visit.push_back(i + 1);
+    }
+
+    for (int i = (int) instructions.size() - 1; i >= 0; i--) {
+        if (reachable[i] || frozen.find(instructions[i]) != frozen.end()) continue;
+        Instruction* instr = instructions[i];
+        if (invLabels.find(instr) != invLabels.end()) {
+            labels.erase(invLabels[instr]);
+            invLabels.erase(instr);
+        }
+        instructions.erase(instructions.begin() + i);
+        peepholeHits["unreachable code"]++;
+    }
+}
+
+bool MipsBuilder::applyPeephole(const PeepholeRule &rule, int index, const std::vector<RegSet>& live) {
+    int length = (int) rule.pattern.size();
+    if (index + length > instructions.size()) return false;
+
+    PeepholeMatch match;
+    for (int i = 0; i < length; i++) {
+        Instruction* instr = instructions[index + i];
+        if (frozen.find(instr) != frozen.end()) return false;
+        // only the first instruction can be jumped to
+        if (i > 0 && invLabels.find(instr) != invLabels.end()) return false;
+        const std::set<InstructionType>& types = rule.pattern[i];
+        if (!types.empty() && types.find(instr->type) == types.end()) return false;
+        match.instrs.push_back(instr);
+        match.ops.push_back(instr->get_operands());
+        match.live.push_back(live[index + i]);
+    }
+    if (!rule.matches(match)) return false;
+
+    std::vector<Instruction*> replacement = rule.rewrite(match);
+    Instruction* first = instructions[index];
+    instructions.erase(instructions.begin() + index, instructions.begin() + index + length);
+    instructions.insert(instructions.begin() + index, replacement.begin(), replacement.end());
+
+    // keep the label of the first instruction on whatever now starts the window
+    moveLabel(first, index);
+
+    peepholeHits[rule.name]++;
+    return true;
+}
+
+void MipsBuilder::moveLabel(Instruction* from, int index) {
+    if (invLabels.find(from) == invLabels.end()) return;
+    std::string label = invLabels[from];
+    invLabels.erase(from);
+    if (index == instructions.size()) {
+        instructions.push_back(new InstrAdd(0, 0, 0));
+    }
+    Instruction* next = instructions[index];
+    if (invLabels.find(next) == invLabels.end()) {
+        labels[label] = next;
+        invLabels[next] = label;
+    }
+    else {
+        replaceLabel(label, invLabels[next]);
+    }
+}
+
+void MipsBuilder::peephole() {
+    removeUnreachable();
+
+    const std::vector<PeepholeRule>& rules = peephole_rules();
+    std::set<std::string> taken;
+    for (const auto& [address, label] : dataLabels) taken.insert(label);
+
+    // propagating copies leaves dead moves for the rules to clean up, and the rules can expose more copies
+    int copies = propagate_copies(instructions, labels, frozen, taken);
+    peepholeHits["copy propagation"] += copies;
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        std::vector<RegSet> live = live_out(instructions, labels, handWritten);
+
+        // keep applying rules until none of them match anywhere
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int i = 0; i < instructions.size(); i++) {
+                for (const PeepholeRule& rule : rules) {
+                    if (!applyPeephole(rule, i, live)) continue;
+                    changed = progress = true;
+                    live = live_out(instructions, labels, handWritten);
+                    // the rewrite may have made the instructions before it match
+                    i = std::max(i - 2, -1);
+                    break;
+                }
+            }
+        }
+
+        if (!progress) break;
+        copies = propagate_copies(instructions, labels, frozen, taken);
+        peepholeHits["copy propagation"] += copies;
+        progress = copies > 0;
+    }
+}
+
+bool MipsBuilder::hoistLoopInvariants() {
+    bool any = false;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::vector<RegSet> live = live_out(instructions, labels, handWritten);
+        for (const Loop& loop : find_loops(instructions, labels)) {
+            std::vector<Hoist> invariants = loop_invariants(loop, instructions, labels, live, handWritten);
+            if (invariants.empty()) continue;
+            int preheader = loop_preheader(loop, instructions, labels);
+            Instruction* guard = preheader < loop.header ? instructions[preheader] : nullptr;
+
+            // take them out back to front so the indices stay valid, then put them in front of the header or its guard.
+            // the latch is a jump, so there's always something left in the loop to take their labels
+            std::vector<Instruction*> hoisted;
+            for (int i = (int) invariants.size() - 1; i >= 0; i--) {
+                int index = invariants[i].index;
+                Instruction* instr = instructions[index];
+                hoisted.insert(hoisted.begin(), instr);
+                instructions.erase(instructions.begin() + index);
+                if (invariants[i].rename != -1) {
+                    instructions.insert(instructions.begin() + index, new InstrAdd(explicit_def(instr), invariants[i].rename, 0));
+                    rename_def(instr, invariants[i].rename);
+                }
+                moveLabel(instr, index);
+            }
+            instructions.insert(instructions.begin() + preheader, hoisted.begin(), hoisted.end());
+            // jumps to the guard have to run the hoisted code too
+            if (guard != nullptr) moveLabel(guard, preheader);
+            peepholeHits["loop invariant"] += (int) hoisted.size();
+
+            // an outer loop may be able to take them further
+            any = changed = true;
+            break;
+        }
+    }
+    return any;
+}
+
+void MipsBuilder::schedule() {
+    std::set<std::string> functions;
+    for (Instruction* instr : instructions) {
+        if (instr->type == InstructionType::I_JAL) functions.insert(instr->get_target());
+    }
+    std::set<Instruction*> labelled;
+    for (const auto& pair : invLabels) labelled.insert(pair.first);
+
+    std::vector<int> starts = block_starts(instructions, labelled, handWritten);
+    starts.push_back((int) instructions.size());
+    std::string function = "init";
+    for (int b = 0; b + 1 < starts.size(); b++) {
+        Instruction* first = instructions[starts[b]];
+        if (invLabels.find(first) != invLabels.end() && functions.find(invLabels[first]) != functions.end()) {
+            function = invLabels[first];
+        }
+        if (handWritten.find(first) != handWritten.end()) continue;
+
+        std::vector<Instruction*> block(instructions.begin() + starts[b], instructions.begin() + starts[b + 1]);
+        std::vector<Instruction*> order = schedule_block(block);
+        int removed = estimate_stalls(block) - estimate_stalls(order);
+        if (removed <= 0) continue;
+
+        std::copy(order.begin(), order.end(), instructions.begin() + starts[b]);
+        // the block's label stays on whatever runs first
+        if (order[0] != first) moveLabel(first, starts[b]);
+        stallsRemoved[function] += removed;
+    }
+}
+
+const std::vector<std::string> PASS_ORDER = {"noops", "jumps", "labels", "peephole", "licm", "jumps", "labels", "schedule"};
+const std::set<std::string> FUNCTION_PASSES = {"peephole", "licm", "schedule"};
+
+const std::map<std::string, std::set<std::string>> LEVEL_PASSES = {
+        {"O0", {"noops", "jumps", "labels"}},
+        {"O1", {"noops", "jumps", "labels", "peephole", "licm", "schedule"}},
+        {"Os", {"noops", "jumps", "labels", "peephole"}},
+};
+
+const std::set<std::string>& level_passes(const std::string& level){
+    // what O2 adds, specializing and inlining, is done to the ast before there are any instructions
+    auto it = LEVEL_PASSES.find(level == "O2" ? "O1" : level);
+    if (it == LEVEL_PASSES.end()) throw std::runtime_error("Unknown optimization level " + level);
+    return it->second;
+}
+
+bool level_runs(const std::string& level, const std::string& pass){
+    const std::set<std::string>& passes = level_passes(level);
+    return passes.find(pass) != passes.end();
+}
+
+void MipsBuilder::licm() {
+    // values copied out of hoisted instructions only become invariant once the copies are propagated
+    while (hoistLoopInvariants()) peephole();
+}
+
+void MipsBuilder::freezeFunctionsWithout(const std::string& pass, const std::string& level) {
+    frozen.clear();
+    std::set<std::string> functions;
+    for (Instruction* instr : instructions) {
+        if (instr->type == InstructionType::I_JAL) functions.insert(instr->get_target());
+    }
+    // a function goes until the next one starts
+    bool skip = !level_runs(level, pass);
+    for (Instruction* instr : instructions) {
+        if (invLabels.find(instr) != invLabels.end() && functions.find(invLabels[instr]) != functions.end()) {
+            auto it = functionLevels.find(invLabels[instr]);
+            skip = !level_runs(it == functionLevels.end() ? level : it->second, pass);
+        }
+        if (skip) frozen.insert(instr);
+    }
+}
+
+void MipsBuilder::runPass(const std::string& pass, const std::string& level) {
+    bool function_pass = FUNCTION_PASSES.find(pass) != FUNCTION_PASSES.end();
+    if (function_pass) freezeFunctionsWithout(pass, level);
+    else if (!level_runs(level, pass)) return;
+    if (function_pass && frozen.size() == instructions.size()) return;
+
+    // the other passes already leave hand written code alone, so they can treat the frozen functions the same way
+    std::set<Instruction*> asm_instrs = handWritten;
+    handWritten.insert(frozen.begin(), frozen.end());
+
+    int before = (int) instructions.size();
+    auto start = std::chrono::steady_clock::now();
+    if (pass == "noops") filterNoops();
+    else if (pass == "jumps") filterJs();
+    else if (pass == "labels") removeUnusedLabels();
+    else if (pass == "peephole") peephole();
+    else if (pass == "licm") licm();
+    else if (pass == "schedule") schedule();
+    auto end = std::chrono::steady_clock::now();
+
+    handWritten = asm_instrs;
+    frozen.clear();
+
+    auto timing = std::find_if(passTimings.begin(), passTimings.end(), [&](const PassTiming& t){ return t.pass == pass; });
+    if (timing == passTimings.end()) {
+        passTimings.push_back({pass});
+        timing = passTimings.end() - 1;
+    }
+    timing->runs++;
+    timing->ms += std::chrono::duration<double, std::milli>(end - start).count();
+    timing->before += before;
+    timing->after += (int) instructions.size();
+}
+
+void MipsBuilder::simplify(const std::string& level) {
+    level_passes(level);
+    for (const std::string& pass : PASS_ORDER) runPass(pass, level);
+}
+
+void MipsBuilder::setFunctionLevel(const std::string& function, const std::string& level) {
+    level_passes(level);
+    functionLevels[function] = level;
+}
+
+std::vector<PassTiming> MipsBuilder::getPassTimings() {
+    return passTimings;
+}
+
+std::map<std::string, int> MipsBuilder::getPeepholeHits() {
+    return peepholeHits;
+}
+
+std::map<std::string, int> MipsBuilder::getStallsRemoved() {
+    return stallsRemoved;
+}
+
 std::vector<Instruction *> MipsBuilder::getInstructions() {
     return instructions;
 }
 
+std::map<std::string, Instruction*> MipsBuilder::getLabels() {
+    return labels;
+}
+
 std::string MipsBuilder::export_str() {
     std::string result;
 
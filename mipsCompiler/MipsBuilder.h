@@ -8,6 +8,29 @@
 #include <vector>
 #include <stdexcept>
 #include "../mips/MipsInstructions.h"
+#include "MipsPeephole.h"
+
+// how long a pass took and what it did to the program, over every time it ran
+struct PassTiming{
+    std::string pass;
+    int runs = 0;
+    double ms = 0;
+    int before = 0;
+    int after = 0;
+};
+
+/*
+ simplify runs the passes of an optimization level in this order, skipping the ones the level doesn't have:
+
+     noops, jumps, labels, peephole, licm, jumps, labels, schedule
+
+     O0          noops, jumps and labels, which only clean up after the compiler
+     O1, O2      everything. O2 also specializes and inlines functions, but that happens before compiling
+     Os          no licm or schedule, which make code faster but never smaller
+
+ peephole, licm and schedule work on one function at a time, so a function can have a level of its own.
+ Code outside of functions, and the runtime, use the level simplify is given
+ */
 
 class MipsBuilder {
 private:
@@ -15,20 +38,56 @@ private:
     std::map<std::string, Instruction*> labels;
     std::map<Instruction*, std::string> invLabels;
     int unnamedLabelCounter = 0;
+    std::map<std::string, int> peepholeHits;
+    std::map<std::string, int> stallsRemoved;
+    std::set<Instruction*> handWritten;
+    // instructions the pass that's running leaves as they are, from functions whose level doesn't have it
+    std::set<Instruction*> frozen;
+    std::map<std::string, std::string> functionLevels;
+    std::vector<PassTiming> passTimings;
+    // labels whose addresses go in words of data memory, by the word, which can be jumped to like an la's
+    std::map<int, std::string> dataLabels;
 
     bool replaceLabel(const std::string& oldLabel, const std::string& newLabel);
     void filterNoops();
     void filterDoubleJJumps();
     void filterJToNext();
     void filterJs();
+    void removeUnusedLabels();
+    void removeUnreachable();
+    void moveLabel(Instruction* from, int index);
+    bool applyPeephole(const PeepholeRule& rule, int index, const std::vector<RegSet>& live);
+    void peephole();
+    bool hoistLoopInvariants();
+    void schedule();
+    void licm();
+    void freezeFunctionsWithout(const std::string& pass, const std::string& level);
+    void runPass(const std::string& pass, const std::string& level);
 public:
     MipsBuilder() = default;
     void addInstruction(Instruction* instr, const std::string& label);
     void prependInstruction(Instruction* instr);
+    void insertInstruction(int index, Instruction* instr);
+    int numInstructions();
+    /// Marks the instructions from index start onwards as hand written asm, which may not follow the calling conventions
+    void markHandWritten(int start);
     std::string genUnnamedLabel();
+    /// Has a word of data memory hold a label's address, instead of the program storing it there with an la
+    void addDataLabel(int address, const std::string& label);
+    /// The address each word from addDataLabel holds, once the labels are linked
+    std::map<int, int32_t> getDataLabelWords();
     void linkLabels();
-    void simplify();
+    void simplify(const std::string& level = "O1");
+    /// Gives a function its own optimization level, instead of the one simplify is given
+    void setFunctionLevel(const std::string& function, const std::string& level);
+    /// Time and instruction counts for each pass simplify ran, in the order they first ran
+    std::vector<PassTiming> getPassTimings();
+    /// Number of times each peephole rule was applied in simplify
+    std::map<std::string, int> getPeepholeHits();
+    /// Stall cycles the scheduler estimates it removed from each function ("init" for code outside functions)
+    std::map<std::string, int> getStallsRemoved();
     std::vector<Instruction*> getInstructions();
+    std::map<std::string, Instruction*> getLabels();
     std::string export_str();
     std::vector<uint32_t> export_mem();
 };
@@ -3,6 +3,12 @@
 //
 
 #include "MipsCompiler.h"
+#include "astAnalysis.h"
+#include "constantPool.h"
+#include "runtime.h"
+#include "stackFrame.h"
+#include "strengthReduction.h"
+#include <algorithm>
 
 #ifndef SP
 #define SP 29
@@ -16,29 +22,123 @@
 #define RSTATUS 30
 #endif
 
+// for loops with a known trip count are unrolled completely if all of the iterations are estimated to
+// take at most UNROLL_FULL_SIZE instructions, and otherwise UNROLL_FACTOR times if one is at most UNROLL_MAX_BODY
+#ifndef UNROLL_FACTOR
+#define UNROLL_FACTOR 4
+#endif
+
+#ifndef UNROLL_FULL_SIZE
+#define UNROLL_FULL_SIZE 48
+#endif
+
+#ifndef UNROLL_MAX_BODY
+#define UNROLL_MAX_BODY 16
+#endif
+
+// copies are only made while the code so far and the copies fit in this much of the 4096 word imem,
+// which leaves room for the rest of the program
+#ifndef UNROLL_IMEM_BUDGET
+#define UNROLL_IMEM_BUDGET 2048
+#endif
+
+// switches with at least SWITCH_TABLE_MIN_CASES cases jump through a table if the cases fill at least
+// SWITCH_TABLE_DENSITY percent of the values from the smallest to the largest. the rest do a binary search,
+// comparing against each case in turn once SWITCH_LINEAR_CASES or fewer are left
+#ifndef SWITCH_TABLE_MIN_CASES
+#define SWITCH_TABLE_MIN_CASES 4
+#endif
+
+#ifndef SWITCH_TABLE_DENSITY
+#define SWITCH_TABLE_DENSITY 40
+#endif
+
+#ifndef SWITCH_LINEAR_CASES
+#define SWITCH_LINEAR_CASES 3
+#endif
+
+// a number repeated in a row is loaded once. long runs of it, like the zeros after the first few values, use memset,
+// unless the program's own memset is the one that would be called
 void compile_array_init(ArrayInitializationToken* token, int* mem, bool on_stack, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     for (int i = 0; i < token->values.size(); i++){
         Token* t = token->values[i];
         if (t->val_type == ARRAY){
             // compile array
             compile_array_init((ArrayInitializationToken*) t, mem, on_stack, mipsBuilder, varTracker);
+            continue;
+        }
+        int run = same_value_run(token->values, i);
+        std::string value = compile_op("", t, mipsBuilder, varTracker);
+        if (run > MEMORY_UNROLL_WORDS && !varTracker->defines_function("memset")){
+            std::string dst = varTracker->add_temp_variable();
+            mipsBuilder->addInstruction(new InstrAddi(varTracker->getReg(dst), on_stack ? SP : 0, *mem), "");
+            Token size(TYPE_VALUE, NUMBER_INT, std::to_string(run), t->line);
+            compile_memory_intrinsic(dst, "", value, &size, mipsBuilder, varTracker);
         }
         else {
-            std::string value = compile_op("", t, mipsBuilder, varTracker);
-            uint8_t reg = varTracker->getReg(value);
-            if (on_stack){
-                mipsBuilder->addInstruction(new InstrSw(reg, SP, *mem), "");
-                *mem -= 1;
+            for (int j = 0; j < run; j++){
+                mipsBuilder->addInstruction(new InstrSw(varTracker->getReg(value), on_stack ? SP : 0, *mem + j), "");
             }
-            else {
-                mipsBuilder->addInstruction(new InstrSw(reg, 0, *mem), "");
-                *mem += 1;
-            }
-
         }
+        *mem += run;
+        i += run - 1;
+    }
+}
+
+bool is_number_literal(Token* token){
+    return token != nullptr && token->type == TYPE_VALUE && (token->val_type == NUMBER_INT || token->val_type == NUMBER_FLOAT);
+}
+
+bool only_numbers(ArrayInitializationToken* token){
+    for (Token* t : token->values){
+        if (t->val_type == ARRAY ? !only_numbers((ArrayInitializationToken*) t) : !is_number_literal(t)) return false;
+    }
+    return true;
+}
+
+// the values go in as they're written, the same as compile_array_init stores them
+void set_static_array(ArrayInitializationToken* token, int* mem, VariableTracker* varTracker){
+    for (Token* t : token->values){
+        if (t->val_type == ARRAY) set_static_array((ArrayInitializationToken*) t, mem, varTracker);
+        else varTracker->set_static_word((*mem)++, parse_number(t));
     }
 }
 
+// a global whose value is numbers is put in the data image, so the program starts out with it there instead of
+// storing it. only for definitions that run once, since one in a loop sets the variable again each time around
+bool compile_static_def(BreakScope* breakScope, DefinitionToken* def, VariableTracker* varTracker){
+    if (!varTracker->has_data_image() || !varTracker->at_top_level() || !breakScope->breakLabel.empty()) return false;
+
+    if (def->dimensions.empty()){
+        if (!is_number_literal(def->value)) return false;
+        bool fixed = def->valueType == TokenValue::FLOAT && def->refCount == 0;
+        varTracker->add_static_variable(def->name, parse_number_as(def->value, fixed));
+        varTracker->set_var_type(def->name, def->valueType);
+        varTracker->set_var_type_refs(def->name, def->refCount);
+        return true;
+    }
+
+    // lengths that aren't numbers are reported by compile_value_def
+    int length = 1;
+    for (Token* i : def->dimensions){
+        if (i->type != TYPE_VALUE || i->val_type != NUMBER_INT) return false;
+        length *= std::stoi(i->lexeme);
+    }
+    auto* init = (ArrayInitializationToken*) def->value;
+    if (init != nullptr && !only_numbers(init)) return false;
+
+    int mem = -varTracker->set_array(def->name, length);
+    if (init != nullptr){
+        int cur_mem_addr = mem;
+        set_static_array(init, &cur_mem_addr, varTracker);
+    }
+    // the array's variable holds where it starts
+    varTracker->add_static_variable(def->name, mem);
+    varTracker->set_var_type(def->name, def->valueType);
+    varTracker->set_var_type_refs(def->name, 1);
+    return true;
+}
+
 std::string compile_value_def(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     auto* def = (DefinitionToken*) token;
 
@@ -55,7 +155,7 @@ std::string compile_value_def(Token* token, MipsBuilder* mipsBuilder, VariableTr
             }
         }
 
-        // allocate memory
+        // allocate memory. arrays on the stack are found from the stack pointer
         int mem = varTracker->set_array(def->name, length);
         bool on_stack = mem > 0;
         if (mem <= 0) mem = -mem;
@@ -86,6 +186,15 @@ std::string compile_value_def(Token* token, MipsBuilder* mipsBuilder, VariableTr
 
 
     if (def->value->type != TYPE_IDENTIFIER ){
+        // a number of the other type is converted in place
+        bool fixed = def->valueType == TokenValue::FLOAT && def->refCount == 0;
+        if (varTracker->get_var_type_refs(value) == 0 && def->refCount == 0 &&
+            fixed != (varTracker->get_var_type(value) == TokenValue::FLOAT)){
+            uint8_t reg = varTracker->getReg(value);
+            if (fixed) mipsBuilder->addInstruction(new InstrSll(reg, reg, 16), "");
+            else mipsBuilder->addInstruction(new InstrSra(reg, reg, 16), "");
+            varTracker->set_var_type(value, def->valueType);
+        }
         varTracker->renameVar(value, def->name);
     }
     else {
@@ -103,26 +212,128 @@ std::string compile_value_def(Token* token, MipsBuilder* mipsBuilder, VariableTr
     return def->name;
 }
 
-void compile_jump_condition(const std::string& break_to, Token* condition, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
-    if (condition->val_type == LT || condition->val_type == LTE ||
-        condition->val_type == GT || condition->val_type == GTE ||
-        condition->val_type == EQ_EQ || condition->val_type == NOT_EQ ||
-        condition->val_type == NOT){
-        compile_op(break_to, condition, mipsBuilder, varTracker);
+bool contains_call(Token* token, VariableTracker* varTracker){
+    bool found = false;
+    for_each_token(token, [&](Token* t){
+        if (found) return;
+        if (t->type == TYPE_KEYWORD && t->val_type == ASM){
+            found = ((AsmToken*) t)->asmCode.find("jal") != std::string::npos;
+        }
+        // copying or filling an array with a loop may call memcpy or memset
+        MemoryLoop loop;
+        if (t->type == TYPE_KEYWORD && t->val_type == FOR && find_memory_loop((ForToken*) t, &loop)){
+            found = !is_unrolled_memory_size(loop.count) && !varTracker->defines_function(loop.src.empty() ? "memset" : "memcpy");
+        }
+        if (t->type == TYPE_VALUE && t->val_type == ARRAY){
+            const std::vector<Token*>& values = ((ArrayInitializationToken*) t)->values;
+            for (int i = 0; i < values.size(); i++)
+                found |= same_value_run(values, i) > MEMORY_UNROLL_WORDS && !varTracker->defines_function("memset");
+        }
+        if (found || t->type != TYPE_OPERATOR || t->val_type != FUNCTION) return;
+        auto* call = (FunctionCallToken*) t;
+        if (!call->is_inline) found = !is_memory_intrinsic(call, varTracker);
+        else found = contains_call(varTracker->get_inline_function(call->lexeme)->body, varTracker);
+    });
+    return found;
+}
+
+int estimate_size(Token* token, VariableTracker* varTracker){
+    int size = 0;
+    for_each_token(token, [&](Token* t){
+        size++;
+        if (t->type == TYPE_KEYWORD && t->val_type == ASM){
+            const std::string& code = ((AsmToken*) t)->asmCode;
+            size += (int) std::count(code.begin(), code.end(), '\n');
+        }
+        if (t->type == TYPE_OPERATOR && t->val_type == FUNCTION && ((FunctionCallToken*) t)->is_inline){
+            size += estimate_size(varTracker->get_inline_function(t->lexeme)->body, varTracker);
+        }
+    });
+    return size;
+}
+
+int estimate_program_size(const std::vector<Token*>& ast, VariableTracker* varTracker){
+    int size = 0;
+    for (Token* token : ast){
+        if (token->type != TYPE_KEYWORD || token->val_type != FUNCTION) size += estimate_size(token, varTracker);
+        else if (!((FunctionToken*) token)->is_inline) size += estimate_size(((FunctionToken*) token)->body, varTracker);
     }
-    else {
-        std::string v = compile_op("", condition, mipsBuilder, varTracker);
-        uint8_t reg = varTracker->getReg(v);
-        mipsBuilder->addInstruction(new InstrBne(reg, 0, break_to), "");
+    return size;
+}
+
+// jumps to label if the condition holds. if true_falls_through, the code for when it holds comes right after,
+// so label is where to go when it doesn't
+void compile_jump_condition(const std::string& label, Token* condition, MipsBuilder* mipsBuilder, VariableTracker* varTracker,
+                            bool true_falls_through = false){
+    compile_branch(!true_falls_through, label, condition, mipsBuilder, varTracker);
+}
+
+void end_branch(bool restore_return_address, ReturnAddressState* join, VariableTracker* varTracker){
+    if (restore_return_address) varTracker->restore_return_address();
+    ReturnAddressState state = varTracker->get_return_address_state();
+    join->in_reg &= state.in_reg;
+    join->in_stack &= state.in_stack;
+}
+
+/*
+ Structure:
+ [jump to else if not condition]
+ [if]
+ j end
+ else:
+    [else]
+ end: noop
+ */
+void compile_if_else(BreakScope* breakScope, IfElseToken* if_statement, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    std::string label_else = mipsBuilder->genUnnamedLabel();
+    std::string label_end = mipsBuilder->genUnnamedLabel();
+
+    std::set<std::string> live;
+    collect_identifiers(if_statement, live);
+    varTracker->push_live(live);
+    compile_jump_condition(label_else, if_statement->condition, mipsBuilder, varTracker, true);
+    ReturnAddressState if_state = varTracker->get_return_address_state();
+    varTracker->pop_live();
+
+    bool restore_at_end = !if_state.in_stack;
+    ReturnAddressState end_state = {true, true};
+
+    compile_instructions(breakScope, if_statement->ifBody->expressions, mipsBuilder, varTracker);
+    end_branch(restore_at_end, &end_state, varTracker);
+    if (if_statement->elseBody != nullptr) mipsBuilder->addInstruction(new InstrJ(label_end), "");
+
+    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_else);
+    varTracker->set_return_address_state(if_state);
+    if (if_statement->elseBody != nullptr){
+        compile_instructions(breakScope, if_statement->elseBody->expressions, mipsBuilder, varTracker);
     }
+    end_branch(restore_at_end, &end_state, varTracker);
+
+    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_end);
+    varTracker->set_return_address_state(end_state);
 }
 
 void compile_if(BreakScope* breakScope, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     auto* if_statement = (IfElseToken*) token;
+    // without else ifs, the if body can come first so the condition only has to jump when it doesn't hold
+    if (if_statement->elseIfConditions.empty()){
+        compile_if_else(breakScope, if_statement, mipsBuilder, varTracker);
+        return;
+    }
+
     Token* condition = if_statement->condition;
     std::string label_true = mipsBuilder->genUnnamedLabel();
     std::string label_end = mipsBuilder->genUnnamedLabel();
+
+    // calls in the conditions happen before any of the bodies run
+    std::set<std::string> live;
+    collect_identifiers(token, live);
+    varTracker->push_live(live);
+
     compile_jump_condition(label_true, condition, mipsBuilder, varTracker);
+    // each branch starts with the return address wherever the conditions before it left it
+    ReturnAddressState if_state = varTracker->get_return_address_state();
+    std::vector<ReturnAddressState> elseIfStates;
     // if elses
     std::vector<std::string> elseIfLabels;
     if (!if_statement->elseIfConditions.empty()){
@@ -130,29 +341,42 @@ void compile_if(BreakScope* breakScope, Token* token, MipsBuilder* mipsBuilder,
             std::string label = mipsBuilder->genUnnamedLabel();
             elseIfLabels.push_back(label);
             compile_jump_condition(label, c, mipsBuilder, varTracker);
+            elseIfStates.push_back(varTracker->get_return_address_state());
         }
     }
+    varTracker->pop_live();
+
+    // if some branch might not have saved $31, branches that made calls reload it before joining
+    bool restore_at_end = !if_state.in_stack;
+    ReturnAddressState end_state = {true, true};
+
     // write else, then jump
     if (if_statement->elseBody != nullptr){
         compile_instructions(breakScope, if_statement->elseBody->expressions, mipsBuilder, varTracker);
     }
+    end_branch(restore_at_end, &end_state, varTracker);
     mipsBuilder->addInstruction(new InstrJ(label_end), "");
 
     // write if elses
     for (int i = 0; i < if_statement->elseIfBodies.size(); i++){
         // noop as start to label
         mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), elseIfLabels[i]);
+        varTracker->set_return_address_state(elseIfStates[i]);
         compile_instructions(breakScope, if_statement->elseIfBodies[i]->expressions, mipsBuilder, varTracker);
+        end_branch(restore_at_end, &end_state, varTracker);
         mipsBuilder->addInstruction(new InstrJ(label_end), "");
     }
 
     // write if
     // noop as start
     mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_true);
+    varTracker->set_return_address_state(if_state);
     compile_instructions(breakScope, if_statement->ifBody->expressions, mipsBuilder, varTracker);
+    end_branch(restore_at_end, &end_state, varTracker);
 
     // noop at end as end label
     mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_end);
+    varTracker->set_return_address_state(end_state);
 }
 
 void compile_break(Token* token, BreakScope* breakScope, MipsBuilder* mipsBuilder){
@@ -163,47 +387,303 @@ void compile_continue(Token* token, BreakScope* breakScope, MipsBuilder* mipsBui
     if (breakScope->continueLabel.empty()) throw std::runtime_error("Continue outside of loop at " + token->toString());
     mipsBuilder->addInstruction(new InstrJ(breakScope->continueLabel), "");
 }
+// a local array or an address taken in the function may be passed on, and would point into a popped frame
+bool frame_escapes(Token* body){
+    bool escapes = false;
+    for_each_token(body, [&](Token* t){
+        if (t->type == TYPE_OPERATOR && t->val_type == IDENTIFIER && !((DefinitionToken*) t)->dimensions.empty()) escapes = true;
+        if (t->type == TYPE_OPERATOR && t->val_type == REF) escapes = true;
+        if (t->type == TYPE_KEYWORD && t->val_type == ASM) escapes = true;
+    });
+    return escapes;
+}
+
+// whether a returned value can be a jump to the function it calls, wherever the return is
+bool call_can_jump(Token* value, TokenValue returnType){
+    if (value == nullptr || value->type != TYPE_OPERATOR || value->val_type != FUNCTION) return false;
+    auto* call = (FunctionCallToken*) value;
+    // a float returned from an int function, or the other way around, has to be converted after the call
+    bool fixed = call->returnType == TokenValue::FLOAT && call->returnTypeRefs == 0;
+    if (fixed != (returnType == TokenValue::FLOAT)) return false;
+    // arguments past the fourth go in the caller's part of the stack, which may not have room for them
+    return !call->is_inline && call->arguments.size() <= 4;
+}
+
+bool is_tail_call(Token* value, BreakScope* breakScope, VariableTracker* varTracker){
+    if (!breakScope->tailCalls || varTracker->in_inline()) return false;
+    return call_can_jump(value, breakScope->returnType);
+}
+
+bool returns_by_jump(FunctionToken* function, ReturnToken* ret){
+    if (function->is_inline || frame_escapes(function->body)) return false;
+    return call_can_jump(ret->value, function->refCount == 0 ? function->returnType : TokenValue::INT);
+}
+
+// the callee returns straight to our caller, so it gets our return address and the stack as it was when we were called
+void compile_tail_call(FunctionCallToken* call, BreakScope* breakScope, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    compile_call_arguments(call, mipsBuilder, varTracker);
+    varTracker->store_globals();
+    varTracker->restore_return_address();
+    breakScope->tailJumps.emplace_back(mipsBuilder->numInstructions(), varTracker->get_stack_offset());
+    mipsBuilder->addInstruction(new InstrJ(call->lexeme), "");
+}
+
 void continue_return(Token* token, BreakScope* breakScope, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     if (breakScope->returnLabel.empty()) throw std::runtime_error("Return outside of function at " + token->toString());
     // get value
     auto* ret = (ReturnToken*) token;
+    if (is_tail_call(ret->value, breakScope, varTracker)){
+        compile_tail_call((FunctionCallToken*) ret->value, breakScope, mipsBuilder, varTracker);
+        return;
+    }
     if (ret->value != nullptr){
         std::string value = compile_op("", ret->value, mipsBuilder, varTracker);
         uint8_t reg = varTracker->getReg(value);
-        mipsBuilder->addInstruction(new InstrAdd(2, 0, reg), "");
+        bool fixed = varTracker->get_var_type(value) == TokenValue::FLOAT && varTracker->get_var_type_refs(value) == 0;
+        if (breakScope->returnType == TokenValue::FLOAT && !fixed && varTracker->get_var_type_refs(value) == 0)
+            mipsBuilder->addInstruction(new InstrSll(2, reg, 16), "");
+        else if (breakScope->returnType == TokenValue::INT && fixed)
+            mipsBuilder->addInstruction(new InstrSra(2, reg, 16), "");
+        else mipsBuilder->addInstruction(new InstrAdd(2, 0, reg), "");
     }
+    if (breakScope->leafFunction && varTracker->get_stack_offset() == 0){
+        // nothing to undo, return straight to the caller
+        varTracker->store_globals();
+        mipsBuilder->addInstruction(new InstrJr(31), "");
+        return;
+    }
+    varTracker->restore_return_address();
     mipsBuilder->addInstruction(new InstrJ(breakScope->returnLabel), "");
 }
 
+void save_return_address_for_loop(VariableTracker* varTracker){
+    // calls inside a loop save $31 once before it, and every iteration treats $31 as overwritten
+    varTracker->save_return_address();
+    varTracker->set_return_address_state({false, true});
+}
+
+// calls put their arguments in $4-$7, so the variables there move out before the loop, not in the middle of it,
+// where the move would run again on the next iteration
+void free_argument_regs(VariableTracker* varTracker){
+    for (int reg = 4; reg < 8; reg++) varTracker->reserve_reg(reg);
+}
+
+// how many iterations to put in each pass through a for loop: 1 to leave it as is, or trips to get rid of the loop
+int unroll_copies(ForToken* for_statement, int trips, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    if (trips < 0) return 1;
+    // every copy of the body makes the code bigger, unless there's only one and the loop goes away
+    if (varTracker->is_size_first()) return trips <= 1 ? trips : 1;
+    int64_t size = estimate_size(for_statement->body, varTracker) + estimate_size(for_statement->increment, varTracker);
+    int64_t room = UNROLL_IMEM_BUDGET - mipsBuilder->numInstructions();
+    if (size * trips <= UNROLL_FULL_SIZE && size * trips <= room) return trips;
+
+    // the iterations that don't fill a whole pass are run before the loop
+    int copies = UNROLL_FACTOR;
+    if (copies <= 1 || trips < 2 * copies || size > UNROLL_MAX_BODY) return 1;
+    if (size * (copies - 1 + trips % copies) > room) return 1;
+    return copies;
+}
+
+bool always_true(Token* condition){
+    return condition == nullptr || (condition->type == TYPE_VALUE && condition->val_type == NUMBER_INT && stoi(condition->lexeme) != 0);
+}
+
+// loops are laid out bottom tested, so an iteration only takes the branch back to the top.
+// the guard skips the loop if the condition doesn't hold the first time
+void compile_loop_guard(const std::string& label_end, Token* condition, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    if (always_true(condition)) return;
+    compile_jump_condition(label_end, condition, mipsBuilder, varTracker, true);
+}
+
+void compile_loop_branch(const std::string& label_loop, Token* condition, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    if (always_true(condition)) mipsBuilder->addInstruction(new InstrJ(label_loop), "");
+    else compile_jump_condition(label_loop, condition, mipsBuilder, varTracker);
+}
+
+// pointers a for loop moves along with its counter, for the arrays the counter indexes
+struct LoopPointers{
+    InductionVariable iv;
+    std::vector<std::string> variables;
+    // a condition comparing a pointer instead of the counter, or nullptr
+    Token* condition;
+    // nothing reads the counter, so it isn't updated
+    bool counter_unused;
+};
+
+std::string pointer_name(const std::string& array, const std::string& counter){
+    return "&" + array + "[" + counter + "]";
+}
+
+// sets the pointers up after the init: &a[i] for every array, plus &a[bound] if the condition can compare
+// against it instead of i. the pointer names must already be live
+LoopPointers start_loop_pointers(ForToken* for_statement, bool unrolled, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    LoopPointers pointers = {find_induction_variable(for_statement), {}, nullptr, false};
+    InductionVariable& iv = pointers.iv;
+    // globals could be changed by the functions the loop calls
+    if (iv.counter.empty() || varTracker->is_global(iv.counter)) return {{"", 0, {}, false}, {}, nullptr, false};
+
+    std::vector<std::string> arrays;
+    for (const std::string& array : iv.arrays){
+        if (!varTracker->var_exists(array) || varTracker->get_var_type_refs(array) == 0) continue;
+        std::string name = pointer_name(array, iv.counter);
+        uint8_t reg = varTracker->add_variable(name);
+        mipsBuilder->addInstruction(new InstrAdd(reg, varTracker->getReg(iv.counter), varTracker->getReg(array)), "");
+        varTracker->set_var_type(name, TokenValue::INT);
+        varTracker->add_induction_pointer(array, iv.counter, name);
+        pointers.variables.push_back(name);
+        arrays.push_back(array);
+    }
+    iv.arrays = arrays;
+    if (arrays.empty()) iv.counter = "";
+    if (iv.counter.empty() || !iv.only_indexes) return pointers;
+
+    // with no condition left, nothing needs the counter
+    if (unrolled){
+        pointers.counter_unused = true;
+        return pointers;
+    }
+
+    // i < n becomes &a[i] < &a[n] when n can't change during the loop
+    auto* condition = (BinaryOpToken*) for_statement->condition;
+    if (condition == nullptr || condition->type != TYPE_OPERATOR) return pointers;
+    TokenValue cmp = condition->val_type;
+    if (cmp != LT && cmp != LTE && cmp != GT && cmp != GTE && cmp != NOT_EQ) return pointers;
+    if (condition->left->type != TYPE_IDENTIFIER || condition->left->lexeme != iv.counter) return pointers;
+    bool invariant_bound = condition->right->type == TYPE_IDENTIFIER && !varTracker->is_global(condition->right->lexeme) &&
+                           !may_change(for_statement->body, condition->right->lexeme) && !contains_call(for_statement->body, varTracker);
+    if (!is_int_literal(condition->right) && !invariant_bound) return pointers;
+
+    std::string end = pointer_name(arrays[0], iv.counter + ".end");
+    std::string bound = compile_op("", condition->right, mipsBuilder, varTracker);
+    uint8_t reg_end = varTracker->add_variable(end);
+    mipsBuilder->addInstruction(new InstrAdd(reg_end, varTracker->getReg(bound), varTracker->getReg(arrays[0])), "");
+    varTracker->removeIfTemp(bound);
+    varTracker->set_var_type(end, TokenValue::INT);
+    pointers.variables.push_back(end);
+
+    auto* compare = new BinaryOpToken(cmp, condition->lexeme, condition->line);
+    compare->left = new Token(TYPE_IDENTIFIER, IDENTIFIER, pointer_name(arrays[0], iv.counter), condition->line);
+    compare->right = new Token(TYPE_IDENTIFIER, IDENTIFIER, end, condition->line);
+    pointers.condition = compare;
+    pointers.counter_unused = true;
+    return pointers;
+}
+
+void end_loop_pointers(LoopPointers& pointers, VariableTracker* varTracker){
+    if (pointers.iv.counter.empty()) return;
+    varTracker->remove_induction_pointers(pointers.iv.counter);
+    for (const std::string& name : pointers.variables) varTracker->removeVar(name);
+    if (pointers.condition != nullptr){
+        auto* compare = (BinaryOpToken*) pointers.condition;
+        delete compare->left;
+        delete compare->right;
+        delete compare;
+    }
+}
+
+// a variable first loaded inside a loop would be loaded again on every pass, losing what the last one did to it,
+// so everything the loop uses is put in a register before it starts
+void load_loop_variables(Token* loop, VariableTracker* varTracker){
+    for_each_token(loop, [varTracker](Token* t){
+        if (t->type == TYPE_IDENTIFIER && varTracker->var_exists(t->lexeme)) varTracker->getReg(t->lexeme, false);
+    });
+}
+
+// the body and increment of one iteration, where continue goes to the increment.
+// copies after the first define the body's variables again, so the previous copy's registers are let go first
+void compile_for_iteration(BreakScope* breakScope, ForToken* for_statement, bool copy, LoopPointers& pointers,
+                           MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    std::string label_incr = mipsBuilder->genUnnamedLabel();
+    breakScope->continueLabel = label_incr;
+
+    if (copy){
+        for_each_token(for_statement->body, [varTracker](Token* t){
+            if (t->type == TYPE_OPERATOR && t->val_type == IDENTIFIER) varTracker->removeVar(((DefinitionToken*) t)->name);
+        });
+    }
+
+    if (for_statement->body != nullptr){
+        compile_instructions(breakScope, for_statement->body->expressions, mipsBuilder, varTracker);
+    }
+    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_incr);
+    if (for_statement->increment != nullptr && !pointers.counter_unused){
+        compile_expr(breakScope, for_statement->increment, mipsBuilder, varTracker);
+    }
+    // the pointers only catch up when the loop jumps back, until then accesses are offset from them instead
+    if (!pointers.iv.counter.empty()) varTracker->advance_induction_pointers(pointers.iv.counter, pointers.iv.step);
+}
+
+// a loop that only copies one array into another or fills one becomes memcpy or memset.
+// there's no counter left afterwards, so nothing after the loop can use it
+bool compile_memory_loop(ForToken* for_statement, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    MemoryLoop loop;
+    if (!find_memory_loop(for_statement, &loop) || varTracker->used_later(loop.counter)) return false;
+    // anything wrong with the variables is left for the loop to report
+    for (const std::string& array : {loop.dst, loop.src}){
+        if (!array.empty() && (!varTracker->var_exists(array) || varTracker->get_var_type_refs(array) == 0)) return false;
+    }
+    Token* count = loop.count;
+    // the program's own memcpy or memset may not do what the loop does
+    if (!is_unrolled_memory_size(count) && varTracker->defines_function(loop.src.empty() ? "memset" : "memcpy")) return false;
+    if (count->type == TYPE_IDENTIFIER && (!varTracker->var_exists(count->lexeme) || varTracker->get_var_type_refs(count->lexeme) != 0 ||
+                                           varTracker->get_var_type(count->lexeme) == TokenValue::FLOAT)) return false;
+    if (loop.value != nullptr && loop.value->type == TYPE_IDENTIFIER && !varTracker->var_exists(loop.value->lexeme)) return false;
+
+    std::string value = loop.value != nullptr ? compile_op("", loop.value, mipsBuilder, varTracker) : "";
+    compile_memory_intrinsic(loop.dst, loop.src, value, count, mipsBuilder, varTracker);
+    return true;
+}
+
 void compile_for(BreakScope* breakScope, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     auto* for_statement = (ForToken*) token;
+    if (compile_memory_loop(for_statement, mipsBuilder, varTracker)) return;
+
     std::string label_loop_condition = mipsBuilder->genUnnamedLabel();
     std::string label_loop = mipsBuilder->genUnnamedLabel();
-    std::string label_incr = mipsBuilder->genUnnamedLabel();
     std::string label_end = mipsBuilder->genUnnamedLabel();
 
     /*
      Structure:
      [init]
-     loopCondition:
-        [condition]
-        j loopEnd
+     [trips % copies iterations]
+     [jump to loopEnd if not condition]
      loop:
         [loop]
         [increment]
-        j loopCondition
+        ... copies times
+     loopCondition:
+        [condition]
      loopEnd: noop
+
+     If every iteration is copied, there's no condition or jump back at all.
+     The guard before the loop is left out if it's known to run at least once.
      */
 
+    // everything in the loop can be used again on the next iteration, including pointers into arrays
+    std::set<std::string> live;
+    collect_identifiers(token, live);
+    InductionVariable iv = find_induction_variable(for_statement);
+    for (const std::string& array : iv.arrays) live.insert(pointer_name(array, iv.counter));
+    if (!iv.arrays.empty()) live.insert(pointer_name(iv.arrays[0], iv.counter + ".end"));
+    varTracker->push_live(live);
+
     // init
     if (for_statement->init != nullptr){
         compile_expr(breakScope, for_statement->init, mipsBuilder, varTracker);
     }
-    // loop condition
-    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_loop_condition);
-    if (for_statement->condition != nullptr){
-        compile_jump_condition(label_loop, for_statement->condition, mipsBuilder, varTracker);
-        mipsBuilder->addInstruction(new InstrJ(label_end), "");
+
+    // a known trip count means the condition only has to be checked once per pass
+    int trips = constant_trip_count(for_statement);
+    int copies = unroll_copies(for_statement, trips, mipsBuilder, varTracker);
+    bool unrolled = copies == trips;
+
+    LoopPointers pointers = start_loop_pointers(for_statement, unrolled, mipsBuilder, varTracker);
+    Token* condition = pointers.condition != nullptr ? pointers.condition : for_statement->condition;
+
+    bool calls = contains_call(token, varTracker);
+    if (calls && !unrolled){
+        save_return_address_for_loop(varTracker);
+        free_argument_regs(varTracker);
     }
 
     // configure break scope
@@ -211,25 +691,41 @@ void compile_for(BreakScope* breakScope, Token* token, MipsBuilder* mipsBuilder,
     std::string prev_continue = breakScope->continueLabel;
 
     breakScope->breakLabel = label_end;
-    breakScope->continueLabel = label_incr;
 
-    // loop body
-    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_loop);
-    if (for_statement->body != nullptr){
-        compile_instructions(breakScope, for_statement->body->expressions, mipsBuilder, varTracker);
+    int emitted = 0;
+    if (unrolled){
+        for (int i = 0; i < trips; i++){
+            compile_for_iteration(breakScope, for_statement, emitted++ > 0, pointers, mipsBuilder, varTracker);
+        }
     }
-    // increment
-    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_incr);
-    if (for_statement->increment != nullptr){
-        compile_expr(breakScope, for_statement->increment, mipsBuilder, varTracker);
+    else {
+        for (int i = 0; trips > 0 && i < trips % copies; i++){
+            compile_for_iteration(breakScope, for_statement, emitted++ > 0, pointers, mipsBuilder, varTracker);
+        }
+        load_loop_variables(token, varTracker);
+        // guard
+        varTracker->update_induction_pointers(pointers.iv.counter);
+        if (trips <= 0) compile_loop_guard(label_end, condition, mipsBuilder, varTracker);
+
+        // loop body and increment
+        mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_loop);
+        for (int i = 0; i < copies; i++){
+            compile_for_iteration(breakScope, for_statement, emitted++ > 0, pointers, mipsBuilder, varTracker);
+        }
+        // go back to the top while the condition holds
+        varTracker->update_induction_pointers(pointers.iv.counter);
+        mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_loop_condition);
+        compile_loop_branch(label_loop, condition, mipsBuilder, varTracker);
     }
-    // jump back to condition and label end
-    mipsBuilder->addInstruction(new InstrJ(label_loop_condition), "");
+    end_loop_pointers(pointers, varTracker);
     mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_end);
 
     // reset break and continue
     breakScope->breakLabel = prev_break;
     breakScope->continueLabel = prev_continue;
+
+    if (calls && !unrolled) save_return_address_for_loop(varTracker);
+    varTracker->pop_live();
 }
 
 void compile_while(BreakScope* breakScope, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
@@ -240,19 +736,28 @@ void compile_while(BreakScope* breakScope, Token* token, MipsBuilder* mipsBuilde
 
     /*
      Structure:
-     loopCondition:
-        [condition]
-        j loopEnd
+     [jump to loopEnd if not condition]
      loop:
         [loop]
-        j loopCondition
+     loopCondition:
+        [condition]
      loopEnd: noop
      */
 
-    // loop condition
-    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_loop_condition);
-    compile_jump_condition(label_loop, while_statement->condition, mipsBuilder, varTracker);
-    mipsBuilder->addInstruction(new InstrJ(label_end), "");
+    // everything in the loop can be used again on the next iteration
+    std::set<std::string> live;
+    collect_identifiers(token, live);
+    varTracker->push_live(live);
+
+    bool calls = contains_call(token, varTracker);
+    if (calls){
+        save_return_address_for_loop(varTracker);
+        free_argument_regs(varTracker);
+    }
+
+    load_loop_variables(token, varTracker);
+    // guard
+    compile_loop_guard(label_end, while_statement->condition, mipsBuilder, varTracker);
 
     // configure break scope
     std::string prev_break = breakScope->breakLabel;
@@ -266,13 +771,154 @@ void compile_while(BreakScope* breakScope, Token* token, MipsBuilder* mipsBuilde
     if (while_statement->body != nullptr){
         compile_instructions(breakScope, while_statement->body->expressions, mipsBuilder, varTracker);
     }
-    // jump back to condition and label end
-    mipsBuilder->addInstruction(new InstrJ(label_loop_condition), "");
+    // go back to the top while the condition holds
+    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_loop_condition);
+    compile_loop_branch(label_loop, while_statement->condition, mipsBuilder, varTracker);
     mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_end);
 
     // reset break and continue
     breakScope->breakLabel = prev_break;
     breakScope->continueLabel = prev_continue;
+
+    if (calls) save_return_address_for_loop(varTracker);
+    varTracker->pop_live();
+}
+
+// jumps to the label of the case value matches, out of cases lo up to hi, which are sorted by value.
+// loaded is the case whose value is already in constant, or -1
+void compile_case_search(uint8_t value, uint8_t constant, const std::vector<std::pair<int, std::string>>& cases, int lo, int hi,
+                         int loaded, const std::string& label_default, MipsBuilder* mipsBuilder){
+    auto case_value = [&](int i){
+        if (cases[i].first == 0) return (uint8_t) 0;
+        if (i != loaded) load_constant(constant, cases[i].first, mipsBuilder);
+        return constant;
+    };
+
+    if (hi - lo <= SWITCH_LINEAR_CASES){
+        if (hi == lo) mipsBuilder->addInstruction(new InstrJ(label_default), "");
+        // the last one goes to default if it doesn't match
+        for (int i = lo; i < hi; i++){
+            bool last = i == hi - 1;
+            std::string label_next = last ? label_default : mipsBuilder->genUnnamedLabel();
+            mipsBuilder->addInstruction(new InstrBne(value, case_value(i), label_next), "");
+            mipsBuilder->addInstruction(new InstrJ(cases[i].second), "");
+            if (!last) mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_next);
+        }
+        return;
+    }
+
+    int mid = (lo + hi) / 2;
+    std::string label_lower = mipsBuilder->genUnnamedLabel();
+    mipsBuilder->addInstruction(new InstrBlt(value, case_value(mid), label_lower), "");
+    compile_case_search(value, constant, cases, mid, hi, mid, label_default, mipsBuilder);
+    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_lower);
+    compile_case_search(value, constant, cases, lo, mid, -1, label_default, mipsBuilder);
+}
+
+/*
+ Structure:
+ [value]
+ [jump to the matching case, or to default: through the jump table, or with a binary search]
+ case: [statements], running on into the next case
+ ...
+ end: noop
+ */
+void compile_switch(BreakScope* breakScope, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    auto* switch_statement = (SwitchToken*) token;
+    const std::vector<Token*>& statements = switch_statement->body->expressions;
+    std::string label_end = mipsBuilder->genUnnamedLabel();
+
+    // cases that start at the same statement share a label
+    std::map<int, std::string> starts;
+    auto label_at = [&](int statement){
+        if (starts.find(statement) == starts.end()) starts[statement] = mipsBuilder->genUnnamedLabel();
+        return starts[statement];
+    };
+    std::vector<std::pair<int, std::string>> cases;
+    for (int i = 0; i < switch_statement->caseValues.size(); i++){
+        cases.emplace_back(switch_statement->caseValues[i], label_at(switch_statement->caseStarts[i]));
+    }
+    std::sort(cases.begin(), cases.end());
+    std::string label_default = switch_statement->defaultStart >= 0 ? label_at(switch_statement->defaultStart) : label_end;
+
+    std::set<std::string> live;
+    collect_identifiers(token, live);
+    varTracker->push_live(live);
+
+    // any case can be the first to run, so each one has to start with the registers and $31 where the dispatch left them
+    bool calls = contains_call(token, varTracker);
+    if (calls){
+        varTracker->save_return_address();
+        varTracker->set_return_address_state({false, true});
+        free_argument_regs(varTracker);
+    }
+    load_loop_variables(switch_statement->body, varTracker);
+
+    Token* value_token = switch_statement->value;
+    int64_t range = cases.empty() ? 0 : (int64_t) cases.back().first - cases.front().first + 1;
+    if (value_token->type == TYPE_VALUE && value_token->val_type == NUMBER_INT){
+        // a constant, usually from a specialized function, goes straight to its case
+        int32_t constant = parse_number(value_token);
+        std::string target = label_default;
+        for (const auto& [case_value, label] : cases) if (case_value == constant) target = label;
+        mipsBuilder->addInstruction(new InstrJ(target), "");
+    }
+    else if (cases.size() >= SWITCH_TABLE_MIN_CASES && range * SWITCH_TABLE_DENSITY <= (int64_t) cases.size() * 100 &&
+             load_constant_cost(cases.front().first) == 1 && load_constant_cost((int32_t) range) == 1){
+        // every value from the smallest case to the largest gets the address to go to in memory
+        int low = cases.front().first;
+        std::vector<std::string> entries(range, label_default);
+        for (const auto& [case_value, label] : cases) entries[case_value - low] = label;
+        int table = varTracker->add_jump_table(entries);
+
+        std::string bound = varTracker->add_temp_variable();
+        uint8_t reg_bound = varTracker->getReg(bound);
+        std::string value = compile_op("", value_token, mipsBuilder, varTracker);
+        uint8_t index = varTracker->getReg(value);
+        if (low != 0){
+            mipsBuilder->addInstruction(new InstrAddi(1, index, -low), "");
+            index = 1;
+        }
+        mipsBuilder->addInstruction(new InstrBlt(index, 0, label_default), "");
+        mipsBuilder->addInstruction(new InstrAddi(reg_bound, 0, (int) range - 1), "");
+        mipsBuilder->addInstruction(new InstrBlt(reg_bound, index, label_default), "");
+        mipsBuilder->addInstruction(new InstrLw(1, index, (int16_t) table), "");
+        mipsBuilder->addInstruction(new InstrJr(1), "");
+        // like a jr in asm, where it goes could need any register
+        mipsBuilder->markHandWritten(mipsBuilder->numInstructions() - 1);
+        varTracker->removeVar(bound);
+        varTracker->removeIfTemp(value);
+    }
+    else {
+        std::string constant = varTracker->add_temp_variable();
+        uint8_t reg_constant = varTracker->getReg(constant);
+        std::string value = compile_op("", value_token, mipsBuilder, varTracker);
+        compile_case_search(varTracker->getReg(value), reg_constant, cases, 0, (int) cases.size(), -1, label_default, mipsBuilder);
+        varTracker->removeVar(constant);
+        varTracker->removeIfTemp(value);
+    }
+
+    std::string prev_break = breakScope->breakLabel;
+    breakScope->breakLabel = label_end;
+
+    // the statements between two labels are compiled together
+    std::vector<Token*> run;
+    for (int i = 0; i <= statements.size(); i++){
+        if (i < statements.size() && starts.find(i) == starts.end()){
+            run.push_back(statements[i]);
+            continue;
+        }
+        compile_instructions(breakScope, run, mipsBuilder, varTracker);
+        run.clear();
+        if (starts.find(i) != starts.end()) mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), starts[i]);
+        if (i < statements.size()) run.push_back(statements[i]);
+    }
+    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_end);
+
+    breakScope->breakLabel = prev_break;
+    if (calls) varTracker->set_return_address_state({false, true});
+    varTracker->pop_live();
+    varTracker->init_jump_tables();
 }
 
 void compile_function(BreakScope* breakScope, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
@@ -309,6 +955,7 @@ void compile_function(BreakScope* breakScope, Token* token, MipsBuilder* mipsBui
     // load first four arguments into registers
     for (int i = 0; i < function->parameters.size() && i < 4; i++){
         varTracker->add_variable(function->parameters[i]->name, 4+i);
+        varTracker->set_var_type(function->parameters[i]->name, function->parameters[i]->valueType);
         varTracker->set_var_type_refs(function->parameters[i]->name, function->parameters[i]->refCount);
     }
 
@@ -317,22 +964,58 @@ void compile_function(BreakScope* breakScope, Token* token, MipsBuilder* mipsBui
         // load arguments into stack pointer
         for (int i = 4; i < function->parameters.size(); i++){
             uint8_t reg = varTracker->getReg(function->parameters[i]->name);
+            varTracker->set_var_type(function->parameters[i]->name, function->parameters[i]->valueType);
+            varTracker->set_var_type_refs(function->parameters[i]->name, function->parameters[i]->refCount);
             mipsBuilder->addInstruction(new InstrLw(reg, SP, i - 4), "");
         }
     }
+    varTracker->promote_globals(name);
+    plan_constants(function, varTracker);
+    plan_frame(function, varTracker);
+    // the whole frame gets one stack adjustment here, once the body shows how many registers are saved across calls
+    int prologue = mipsBuilder->numInstructions();
 
     // adjust breakscope
     std::string func_end = mipsBuilder->genUnnamedLabel();
     std::string prev_return = breakScope->returnLabel;
+    bool prev_leaf = breakScope->leafFunction;
+    bool prev_tail_calls = breakScope->tailCalls;
+    std::vector<std::pair<int, int>> prev_tail_jumps = breakScope->tailJumps;
+    TokenValue prev_return_type = breakScope->returnType;
     breakScope->returnLabel = just_jump;
+    breakScope->returnType = function->refCount == 0 ? function->returnType : TokenValue::INT;
+    breakScope->leafFunction = !contains_call(function->body, varTracker);
+    breakScope->tailCalls = !frame_escapes(function->body);
+    breakScope->tailJumps.clear();
 
     // run code
     compile_instructions(breakScope, function->body->expressions, mipsBuilder, varTracker);
+    varTracker->restore_return_address();
+
+    int frame_size = varTracker->get_frame_size();
+    // latest first, so the earlier jumps stay where they were recorded
+    for (auto it = breakScope->tailJumps.rbegin(); it != breakScope->tailJumps.rend(); it++){
+        int pop = it->second + frame_size;
+        if (pop > 0) mipsBuilder->insertInstruction(it->first, new InstrAddi(SP, SP, pop));
+    }
+    // the part planned before the body is already counted in the stack offset
+    int reserved = varTracker->get_stack_offset() + frame_size;
+    if (reserved > 0){
+        mipsBuilder->insertInstruction(prologue, new InstrAddi(SP, SP, -reserved));
+    }
+    varTracker->set_function_frame(name, reserved);
 
     mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), just_jump);
     varTracker->decScope();
     // jd $ra
     mipsBuilder->addInstruction(new InstrJr(31), "");
+    varTracker->init_jump_tables();
+
+    breakScope->returnLabel = prev_return;
+    breakScope->leafFunction = prev_leaf;
+    breakScope->tailCalls = prev_tail_calls;
+    breakScope->tailJumps = prev_tail_jumps;
+    breakScope->returnType = prev_return_type;
 
     mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), after_function);
 }
@@ -340,15 +1023,20 @@ void compile_function(BreakScope* breakScope, Token* token, MipsBuilder* mipsBui
 std::string compile_expr(BreakScope* breakScope, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     if (token == nullptr) return "";
     if (token->type == TokenType::TYPE_OPERATOR && token->val_type == TokenValue::IDENTIFIER){
+        if (compile_static_def(breakScope, (DefinitionToken*) token, varTracker)) return ((DefinitionToken*) token)->name;
         return compile_value_def(token, mipsBuilder, varTracker);
     }
     else if (token->type == TokenType::TYPE_OPERATOR){
         return compile_op("", token, mipsBuilder, varTracker);
     }
+    else if (token->type == TokenType::TYPE_GROUP){
+        compile_instructions(breakScope, ((GroupToken*) token)->expressions, mipsBuilder, varTracker);
+    }
     else if (token->type == TokenType::TYPE_KEYWORD){
         if (token->val_type == TokenValue::IF) compile_if(breakScope, token, mipsBuilder, varTracker);
         else if (token->val_type == TokenValue::FOR) compile_for(breakScope, token, mipsBuilder, varTracker);
         else if (token->val_type == TokenValue::WHILE) compile_while(breakScope, token, mipsBuilder, varTracker);
+        else if (token->val_type == TokenValue::SWITCH) compile_switch(breakScope, token, mipsBuilder, varTracker);
         else if (token->val_type == TokenValue::BREAK) compile_break(token, breakScope, mipsBuilder);
         else if (token->val_type == TokenValue::CONTINUE) compile_continue(token, breakScope, mipsBuilder);
         else if (token->val_type == TokenValue::RETURN) continue_return(token, breakScope, mipsBuilder, varTracker);
@@ -356,6 +1044,11 @@ std::string compile_expr(BreakScope* breakScope, Token* token, MipsBuilder* mips
         else if (token->val_type == TokenValue::ASM) {
             auto* asmToken = (AsmToken*) token;
             assembleMips(asmToken->asmCode, mipsBuilder, varTracker);
+            std::set<std::string> assigned;
+            collect_asm_identifiers(asmToken->asmCode, assigned, false);
+            for (const std::string& var : assigned){
+                if (varTracker->var_exists(var)) varTracker->mark_assigned(var);
+            }
         }
     }
     return "";
@@ -364,9 +1057,23 @@ std::string compile_expr(BreakScope* breakScope, Token* token, MipsBuilder* mips
 void compile_instructions(BreakScope* breakScope, const std::vector<Token*>& tokens, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     // tokens are the heads of parse trees - parse each one individually, then append them together
     // make main function first, so the first instruction starts there
-    for (Token* token : tokens){
+    // the arrays defined here give their part of the frame back at the end, for the next block to use
+    int frame_mark = varTracker->mark_frame();
+    for (int i = 0; i < tokens.size(); i++){
+        Token* token = tokens[i];
+        // only values used later on need to survive a function call in this statement.
+        // if and loop statements add their own uses while compiling
+        std::set<std::string> live;
+        collect_identifiers(tokens, i + 1, live);
+        if (token->type != TokenType::TYPE_KEYWORD || token->val_type == TokenValue::RETURN ||
+            token->val_type == TokenValue::ASM){
+            collect_identifiers(token, live);
+        }
+        varTracker->push_live(live);
         compile_expr(breakScope, token, mipsBuilder, varTracker);
+        varTracker->pop_live();
     }
+    varTracker->release_frame(frame_mark);
 }
 
 bool sort_ast(std::vector<Token*>* tokens, Scope* scope){
@@ -17,10 +17,21 @@ struct BreakScope {
     std::string returnLabel;
     std::string breakLabel;
     std::string continueLabel;
+    // leaf functions can return with jr $31 instead of jumping to the epilogue
+    bool leafFunction;
+    // calls in tail position can jump instead, reusing the frame, if nothing can point into it
+    bool tailCalls;
+    // where each tail jump is and the stack offset there. the frame is popped in front of them once its size is known
+    std::vector<std::pair<int, int>> tailJumps;
+    // what the function returns, so a float or an int can be converted on the way out. NONE outside of one
+    TokenValue returnType;
     BreakScope(){
         returnLabel = "";
         breakLabel = "";
         continueLabel = "";
+        leafFunction = false;
+        tailCalls = false;
+        returnType = TokenValue::NONE;
     }
 };
 
@@ -28,6 +39,17 @@ std::string compile_expr(BreakScope* breakScope, Token* token, MipsBuilder* mips
 
 void compile_instructions(BreakScope* breakScope, const std::vector<Token*>& tokens, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
 
+/// Returns if compile_function turns a return in the function into a jump to the function it calls, reusing the frame
+bool returns_by_jump(FunctionToken* function, ReturnToken* ret);
+
+/// Returns if running a token may jal somewhere, including through inline functions and asm
+bool contains_call(Token* token, VariableTracker* varTracker);
+
+/// Rough number of instructions a token compiles to, including the inline functions it calls
+int estimate_size(Token* token, VariableTracker* varTracker);
+/// estimate_size of the top level code and every function that isn't inline
+int estimate_program_size(const std::vector<Token*>& ast, VariableTracker* varTracker);
+
 bool sort_ast(std::vector<Token*>* tokens, Scope* scope);
 
 #endif //I2C2_MIPSCOMPILER_H
@@ -0,0 +1,184 @@
+#include "MipsLoops.h"
+#include <algorithm>
+
+std::vector<Loop> find_loops(const std::vector<Instruction*>& instructions, std::map<std::string, Instruction*>& labels){
+    int n = (int) instructions.size();
+    std::vector<int> target = jump_targets(instructions, labels);
+
+    // continue statements also jump back to the header, so the loop ends at the last jump back
+    std::map<int, int> latch_of;
+    for (int i = 0; i < n; i++){
+        if (target[i] < 0 || target[i] > i) continue;
+        latch_of[target[i]] = std::max(latch_of[target[i]], i);
+    }
+
+    std::vector<Loop> loops;
+    for (const auto& [header, latch] : latch_of) loops.push_back({header, latch});
+    std::sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b){
+        return a.latch - a.header < b.latch - b.header;
+    });
+    return loops;
+}
+
+bool in_loop(const Loop& loop, int index){
+    return index >= loop.header && index <= loop.latch;
+}
+
+RegSet live_in(const std::vector<Instruction*>& instructions, const std::vector<RegSet>& live, int index,
+               const std::set<Instruction*>& hand_written){
+    if (index >= instructions.size()) return ALL_REGS;
+    Instruction* instr = instructions[index];
+    bool asm_instr = hand_written.find(instr) != hand_written.end();
+    return reg_uses(instr, asm_instr) | (live[index] & ~reg_defs(instr, asm_instr));
+}
+
+int loop_preheader(const Loop& loop, const std::vector<Instruction*>& instructions, std::map<std::string, Instruction*>& labels){
+    int n = (int) instructions.size();
+    std::vector<int> target = jump_targets(instructions, labels, true);
+
+    // a guard branches into the header from just in front of the loop
+    int start = loop.header;
+    for (int i = 0; i < loop.header; i++){
+        if (target[i] == loop.header){
+            start = i;
+            break;
+        }
+    }
+
+    std::set<Instruction*> labelled;
+    for (const auto& pair : labels) labelled.insert(pair.second);
+
+    for (int i = 0; i < n; i++){
+        if (in_loop(loop, i)) continue;
+        bool guard = i >= start && i < loop.header;
+        // the guard can only be run from its start, and straight through
+        if (guard && i > start && labelled.find(instructions[i]) != labelled.end()) return -1;
+        if (guard && (instructions[i]->type == I_JAL || instructions[i]->type == I_JR || instructions[i]->type == I_SW)) return -1;
+        if (target[i] < 0 || !in_loop(loop, target[i])) continue;
+        if (!guard || target[i] != loop.header) return -1;
+    }
+    return start;
+}
+
+std::vector<Hoist> loop_invariants(const Loop& loop, const std::vector<Instruction*>& instructions,
+                                 std::map<std::string, Instruction*>& labels, const std::vector<RegSet>& live,
+                                 const std::set<Instruction*>& hand_written){
+    int n = (int) instructions.size();
+    std::vector<int> target = jump_targets(instructions, labels, true);
+
+    // the hoisted code goes in front of the guard, if there is one
+    int preheader = loop_preheader(loop, instructions, labels);
+    if (preheader < 0) return {};
+    RegSet guard_uses = 0;
+    RegSet guard_defs = 0;
+    RegSet guard_exit_live = 0;
+    for (int i = preheader; i < loop.header; i++){
+        if (hand_written.find(instructions[i]) != hand_written.end()) return {};
+        guard_uses |= reg_uses(instructions[i]);
+        guard_defs |= reg_defs(instructions[i]);
+        if (target[i] >= 0 && target[i] != loop.header) guard_exit_live |= live_in(instructions, live, target[i], hand_written);
+    }
+
+    int def_count[32] = {0};
+    bool calls = false;
+    bool unknown_store = false;
+    std::set<std::pair<int, int>> stored_slots;
+    RegSet exit_live = 0;
+    for (int i = loop.header; i <= loop.latch; i++){
+        Instruction* instr = instructions[i];
+        if (instr->type == I_BEX || instr->type == I_SETX) return {};
+        // nothing moves across memory accesses in asm
+        bool asm_instr = hand_written.find(instr) != hand_written.end();
+        if (asm_instr && (instr->type == I_SW || instr->type == I_LW)) unknown_store = true;
+
+        RegSet defs = instr->type == I_JAL ? ALL_REGS : reg_defs(instr);
+        for (int r = 0; r < 32; r++) if (defs & REG(r)) def_count[r]++;
+
+        if (instr->type == I_JAL) calls = true;
+        if (instr->type == I_SW){
+            Operands ops = instr->get_operands();
+            // a pointer could be aimed at any variable
+            if (ops.rs != 0 && ops.rs != 29) unknown_store = true;
+            stored_slots.insert({ops.rs, ops.imm});
+        }
+
+        // registers read after leaving the loop
+        if (instr->type == I_JR) exit_live |= reg_uses(instr, asm_instr);
+        else if (instr->type != I_JAL && target[i] >= 0 && !in_loop(loop, target[i]))
+            exit_live |= live_in(instructions, live, target[i], hand_written);
+        if (instr->type != I_J && instr->type != I_JR && !in_loop(loop, i + 1))
+            exit_live |= live_in(instructions, live, i + 1, hand_written);
+    }
+    RegSet header_live = live_in(instructions, live, loop.header, hand_written);
+
+    // registers the loop never mentions and that are dead around it, for values whose register gets reused
+    RegSet mentioned = 0;
+    for (int i = loop.header; i <= loop.latch; i++){
+        mentioned |= explicit_uses(instructions[i]);
+        if (explicit_def(instructions[i]) > 0) mentioned |= REG(explicit_def(instructions[i]));
+    }
+    // calls don't keep the temporaries, so there's nowhere to put them in a loop with one
+    std::vector<int> spare;
+    for (int r = 27; r >= 8 && !calls; r--){
+        if (!((mentioned | header_live | exit_live) & REG(r))) spare.push_back(r);
+    }
+
+    std::vector<int> rename(n, -1);
+    std::vector<bool> hoisted(n, false);
+    RegSet hoisted_defs = 0;
+    bool changed = true;
+    while (changed){
+        changed = false;
+        for (int i = loop.header; i <= loop.latch; i++){
+            if (hoisted[i]) continue;
+            Instruction* instr = instructions[i];
+            if (hand_written.find(instr) != hand_written.end()) continue;
+            Operands ops = instr->get_operands();
+
+            // div can trap on 0, which the loop may have checked for
+            bool pure = is_pure(instr) && instr->type != I_DIV;
+            // dmem variables and stack slots, but never pins
+            bool plain_load = instr->type == I_LW && !calls && !unknown_store &&
+                              ((ops.rs == 0 && ops.imm >= 0 && ops.imm < 4096) || ops.rs == 29) &&
+                              stored_slots.find({ops.rs, ops.imm}) == stored_slots.end();
+            if (!pure && !plain_load) continue;
+
+            int def = explicit_def(instr);
+            if (def <= 0 || def == 3 || def >= 29) continue;
+
+            // the clock and rstatus change on their own
+            RegSet uses = explicit_uses(instr);
+            if (uses & (REG(3) | REG(30))) continue;
+            bool invariant = true;
+            for (int r = 1; r < 32; r++){
+                if ((uses & REG(r)) && def_count[r] > 0 && !(hoisted_defs & REG(r))) invariant = false;
+            }
+            if (!invariant) continue;
+
+            // the register can't hold anything else in the loop, or be read before it's set or after leaving.
+            // otherwise the value is computed into a spare register and copied where it was
+            if (def_count[def] != 1 || (header_live & REG(def)) || (exit_live & REG(def))){
+                if (spare.empty() || move_source(instr) != -1) continue;
+                rename[i] = spare.back();
+                spare.pop_back();
+                def = rename[i];
+            }
+
+            hoisted[i] = true;
+            hoisted_defs |= REG(def);
+            changed = true;
+        }
+    }
+
+    std::vector<Hoist> result;
+    RegSet hoisted_uses = 0;
+    for (int i = loop.header; i <= loop.latch; i++){
+        if (!hoisted[i]) continue;
+        result.push_back({i, rename[i]});
+        hoisted_uses |= explicit_uses(instructions[i]);
+    }
+
+    // the guard now runs after the hoisted code, and may leave without running the loop
+    if ((hoisted_uses & guard_defs) || (hoisted_defs & (guard_uses | guard_defs | guard_exit_live))) return {};
+    return result;
+}
@@ -0,0 +1,40 @@
+#ifndef I2C2_MIPSLOOPS_H
+#define I2C2_MIPSLOOPS_H
+
+#include <vector>
+#include <set>
+#include <map>
+#include <string>
+
+#include "MipsPeephole.h"
+
+/// A loop in the instruction list: everything from header to latch, where latch jumps back to header
+struct Loop{
+    int header;
+    int latch;
+};
+
+/// An instruction that can be moved in front of its loop. If rename isn't -1, the value has to be computed
+/// into that register instead, and copied into the original one where the instruction was.
+struct Hoist{
+    int index;
+    int rename;
+};
+
+/// Loops formed by jumps back to an earlier instruction, innermost first
+std::vector<Loop> find_loops(const std::vector<Instruction*>& instructions, std::map<std::string, Instruction*>& labels);
+
+/// Where code that runs once before the loop goes: the header, or the start of the guard in front of a bottom tested loop,
+/// which is the only other way in. -1 if the loop can be entered from anywhere else.
+int loop_preheader(const Loop& loop, const std::vector<Instruction*>& instructions, std::map<std::string, Instruction*>& labels);
+
+/// Instructions in a loop that compute the same value on every iteration and can be
+/// moved in front of it, in the order they appear. Hand written asm is never moved, and no load is moved
+/// out of a loop with a call, a store through a pointer or asm that touches memory.
+/// Loops with a way in besides the header and its guard are left alone.
+/// live is the result of live_out.
+std::vector<Hoist> loop_invariants(const Loop& loop, const std::vector<Instruction*>& instructions,
+                                 std::map<std::string, Instruction*>& labels, const std::vector<RegSet>& live,
+                                 const std::set<Instruction*>& hand_written);
+
+#endif //I2C2_MIPSLOOPS_H
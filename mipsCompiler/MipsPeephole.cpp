@@ -0,0 +1,327 @@
+#include "MipsPeephole.h"
+#include <array>
+
+bool is_r_type(InstructionType type){
+    return type == I_ADD || type == I_SUB || type == I_AND || type == I_OR ||
+           type == I_MUL || type == I_HMUL || type == I_DIV ||
+           type == I_SLT || type == I_SGT || type == I_SGE;
+}
+
+bool is_i_type(InstructionType type){
+    return type == I_ADDI || type == I_SLL || type == I_SRA || type == I_LW;
+}
+
+RegSet explicit_uses(Instruction* instr){
+    Operands ops = instr->get_operands();
+    RegSet uses = 0;
+    if (is_r_type(instr->type)) uses = REG(ops.rs) | REG(ops.rt);
+    else if (is_i_type(instr->type)) uses = REG(ops.rs);
+    else if (instr->type == I_SW || instr->type == I_BNE || instr->type == I_BLT) uses = REG(ops.rd) | REG(ops.rs);
+    else if (instr->type == I_JR || instr->type == I_TEST_LOG) uses = REG(ops.rd);
+    return uses & ~REG(0);
+}
+
+int explicit_def(Instruction* instr){
+    if (is_r_type(instr->type) || is_i_type(instr->type) || instr->type == I_LA) return instr->get_operands().rd;
+    return -1;
+}
+
+RegSet reg_uses(Instruction* instr, bool hand_written){
+    RegSet uses = explicit_uses(instr);
+    // hand written asm can pass values in any register in either direction of a call
+    if (hand_written && (instr->type == I_JAL || instr->type == I_JR)) return ALL_REGS & ~REG(0);
+    // the callee reads its arguments and the stack and heap pointers
+    if (instr->type == I_JAL) uses |= REG(4) | REG(5) | REG(6) | REG(7) | REG(28) | REG(29);
+    // the caller reads the return value and the stack and heap pointers
+    if (instr->type == I_JR) uses |= REG(2) | REG(28) | REG(29);
+    if (instr->type == I_JAL || instr->type == I_JR || instr->type == I_BEX) uses |= REG(30);
+    return uses;
+}
+
+RegSet reg_defs(Instruction* instr, bool hand_written){
+    // callers reload anything they need after a call, so only the clock, pointers and status survive it.
+    // hand written asm may rely on its callees leaving registers alone
+    if (instr->type == I_JAL && hand_written) return REG(31);
+    if (instr->type == I_JAL) return ALL_REGS & ~(REG(0) | REG(3) | REG(28) | REG(29) | REG(30));
+    if (instr->type == I_SETX) return REG(30);
+    int def = explicit_def(instr);
+    if (def <= 0) return 0;
+    return REG(def);
+}
+
+void rename_uses(Instruction* instr, int old_reg, int new_reg){
+    Operands ops = instr->get_operands();
+    if (is_r_type(instr->type)){
+        if (ops.rs == old_reg) ops.rs = new_reg;
+        if (ops.rt == old_reg) ops.rt = new_reg;
+    }
+    else if (is_i_type(instr->type)){
+        if (ops.rs == old_reg) ops.rs = new_reg;
+    }
+    else if (instr->type == I_SW || instr->type == I_BNE || instr->type == I_BLT){
+        if (ops.rd == old_reg) ops.rd = new_reg;
+        if (ops.rs == old_reg) ops.rs = new_reg;
+    }
+    else if (instr->type == I_JR || instr->type == I_TEST_LOG){
+        if (ops.rd == old_reg) ops.rd = new_reg;
+    }
+    instr->set_operands(ops);
+}
+
+void rename_def(Instruction* instr, int new_reg){
+    if (explicit_def(instr) == -1) return;
+    Operands ops = instr->get_operands();
+    ops.rd = new_reg;
+    instr->set_operands(ops);
+}
+
+int move_source(Instruction* instr){
+    Operands ops = instr->get_operands();
+    if (ops.rd <= 0) return -1;
+    switch (instr->type) {
+        case I_ADD:
+        case I_OR:
+            if (ops.rs == 0) return ops.rt;
+            if (ops.rt == 0) return ops.rs;
+            return -1;
+        case I_ADDI:
+        case I_SLL:
+        case I_SRA:
+            return ops.imm == 0 ? ops.rs : -1;
+        default:
+            return -1;
+    }
+}
+
+bool is_pure(Instruction* instr){
+    return is_r_type(instr->type) || instr->type == I_ADDI || instr->type == I_SLL || instr->type == I_SRA;
+}
+
+std::vector<int> jump_targets(const std::vector<Instruction*>& instructions, std::map<std::string, Instruction*>& labels,
+                              bool include_calls){
+    int n = (int) instructions.size();
+    std::map<Instruction*, int> index;
+    for (int i = 0; i < n; i++) index[instructions[i]] = i;
+
+    std::vector<int> target(n, -1);
+    for (int i = 0; i < n; i++){
+        std::string label = instructions[i]->get_target();
+        if (label.empty() || (instructions[i]->type == I_JAL && !include_calls)) continue;
+        if (labels.find(label) == labels.end() || index.find(labels[label]) == index.end()) target[i] = n;
+        else target[i] = index[labels[label]];
+    }
+    return target;
+}
+
+std::vector<RegSet> live_out(const std::vector<Instruction*>& instructions, std::map<std::string, Instruction*>& labels,
+                             const std::set<Instruction*>& hand_written){
+    int n = (int) instructions.size();
+    std::vector<int> target = jump_targets(instructions, labels);
+
+    std::vector<RegSet> live_in(n + 1, 0);
+    std::vector<RegSet> out(n, 0);
+    live_in[n] = ALL_REGS;
+
+    bool changed = true;
+    while (changed){
+        changed = false;
+        for (int i = n - 1; i >= 0; i--){
+            Instruction* instr = instructions[i];
+            RegSet o = 0;
+            if (instr->type == I_J) o = live_in[target[i]];
+            else if (instr->type != I_JR) {
+                o = live_in[i + 1];
+                if (target[i] != -1) o |= live_in[target[i]];
+            }
+            bool asm_instr = hand_written.find(instr) != hand_written.end();
+            RegSet in = reg_uses(instr, asm_instr) | (o & ~reg_defs(instr, asm_instr));
+            if (o != out[i] || in != live_in[i]){
+                out[i] = o;
+                live_in[i] = in;
+                changed = true;
+            }
+        }
+    }
+    return out;
+}
+
+typedef std::array<int, 32> CopyState;
+
+void copy_transfer(Instruction* instr, CopyState& copy_of){
+    int src = move_source(instr);
+    if (src != -1 && copy_of[src] != -1) src = copy_of[src];
+
+    // a call may change any register
+    RegSet defs = instr->type == I_JAL ? ALL_REGS : reg_defs(instr);
+    for (int r = 0; r < 32; r++){
+        if ((defs & REG(r)) || (copy_of[r] != -1 && (defs & REG(copy_of[r])))) copy_of[r] = -1;
+    }
+
+    // the clock changes on its own and rstatus is set by overflows, so neither can be copied
+    int dest = explicit_def(instr);
+    if (src == -1 || src == dest || src == 3 || src == 30 || dest == 3 || dest == 30) return;
+    copy_of[dest] = src;
+}
+
+int propagate_copies(const std::vector<Instruction*>& instructions, std::map<std::string, Instruction*>& labels,
+                     const std::set<Instruction*>& keep, const std::set<std::string>& taken){
+    int n = (int) instructions.size();
+    std::vector<int> target = jump_targets(instructions, labels, true);
+
+    // nothing is known at the start of the program or of a function, since it can be called from anywhere
+    std::vector<bool> entry(n, false);
+    std::vector<std::vector<int>> preds(n);
+    if (n > 0) entry[0] = true;
+    for (int i = 0; i < n; i++){
+        Instruction* instr = instructions[i];
+        // a label whose address is taken can be jumped to from anywhere too
+        if (instr->type == I_JAL || instr->type == I_LA){
+            if (target[i] < n) entry[target[i]] = true;
+            if (i + 1 < n) preds[i + 1].push_back(i);
+            continue;
+        }
+        if (target[i] >= 0 && target[i] < n) preds[target[i]].push_back(i);
+        if (instr->type != I_J && instr->type != I_JR && i + 1 < n) preds[i + 1].push_back(i);
+    }
+    std::map<Instruction*, int> index;
+    for (int i = 0; i < n; i++) index[instructions[i]] = i;
+    for (const std::string& label : taken){
+        if (labels.find(label) != labels.end() && index.find(labels[label]) != index.end()) entry[index[labels[label]]] = true;
+    }
+
+    // copies that hold on every path into each instruction. predecessors that haven't been
+    // visited yet are skipped, so loops start optimistic and shrink until nothing changes
+    std::vector<CopyState> in(n), out(n);
+    std::vector<bool> visited(n, false);
+    bool changed = true;
+    while (changed){
+        changed = false;
+        for (int i = 0; i < n; i++){
+            CopyState state;
+            state.fill(-1);
+            bool any = entry[i];
+            bool first = !entry[i];
+            for (int p : preds[i]){
+                if (!visited[p]) continue;
+                any = true;
+                if (first) state = out[p];
+                else for (int r = 0; r < 32; r++) if (state[r] != out[p][r]) state[r] = -1;
+                first = false;
+            }
+            if (!any) continue;
+            if (visited[i] && state == in[i]) continue;
+
+            visited[i] = true;
+            in[i] = state;
+            copy_transfer(instructions[i], state);
+            out[i] = state;
+            changed = true;
+        }
+    }
+
+    int rewritten = 0;
+    for (int i = 0; i < n; i++){
+        if (!visited[i] || keep.find(instructions[i]) != keep.end()) continue;
+        Instruction* instr = instructions[i];
+        RegSet uses = explicit_uses(instr);
+        bool renamed = false;
+        for (int r = 1; r < 32; r++){
+            if (!(uses & REG(r)) || in[i][r] == -1) continue;
+            rename_uses(instr, r, in[i][r]);
+            renamed = true;
+        }
+        if (renamed) rewritten++;
+    }
+    return rewritten;
+}
+
+//region rules
+
+bool is_plain_memory(const Operands& ops){
+    // $0 based addresses below 4096 are in dmem and $29 based ones are on the stack, anything else could be a pin
+    return (ops.rs == 0 && ops.imm >= 0 && ops.imm < 4096) || ops.rs == 29;
+}
+
+bool match_self_addi(const PeepholeMatch& m){
+    return m.ops[0].rd == m.ops[0].rs && m.ops[0].imm == 0;
+}
+
+bool match_self_shift(const PeepholeMatch& m){
+    return m.ops[0].rd == m.ops[0].rs && m.ops[0].imm == 0;
+}
+
+std::vector<Instruction*> remove_all(const PeepholeMatch&){
+    return {};
+}
+
+bool match_move_into_use(const PeepholeMatch& m){
+    int src = move_source(m.instrs[0]);
+    int r = m.ops[0].rd;
+    if (src == -1 || src == r) return false;
+    if (!(explicit_uses(m.instrs[1]) & REG(r))) return false;
+    // r must not be needed afterwards, unless the use overwrites it
+    return !(m.live[1] & REG(r)) || explicit_def(m.instrs[1]) == r;
+}
+
+std::vector<Instruction*> rewrite_move_into_use(const PeepholeMatch& m){
+    rename_uses(m.instrs[1], m.ops[0].rd, move_source(m.instrs[0]));
+    return {m.instrs[1]};
+}
+
+bool match_move_into_def(const PeepholeMatch& m){
+    int src = move_source(m.instrs[1]);
+    int dest = m.ops[1].rd;
+    if (src <= 0 || src == dest) return false;
+    if (explicit_def(m.instrs[0]) != src) return false;
+    if (!is_pure(m.instrs[0]) && m.instrs[0]->type != I_LW) return false;
+    return !(m.live[1] & REG(src));
+}
+
+std::vector<Instruction*> rewrite_move_into_def(const PeepholeMatch& m){
+    rename_def(m.instrs[0], m.ops[1].rd);
+    return {m.instrs[0]};
+}
+
+bool match_store_load(const PeepholeMatch& m){
+    const Operands& sw = m.ops[0];
+    const Operands& lw = m.ops[1];
+    return sw.rs == lw.rs && sw.imm == lw.imm && is_plain_memory(sw);
+}
+
+std::vector<Instruction*> rewrite_store_load(const PeepholeMatch& m){
+    if (m.ops[0].rd == m.ops[1].rd) return {m.instrs[0]};
+    return {m.instrs[0], new InstrAdd(m.ops[1].rd, 0, m.ops[0].rd)};
+}
+
+bool match_load_store(const PeepholeMatch& m){
+    const Operands& lw = m.ops[0];
+    const Operands& sw = m.ops[1];
+    return sw.rs == lw.rs && sw.imm == lw.imm && sw.rd == lw.rd && lw.rd != lw.rs && is_plain_memory(lw);
+}
+
+std::vector<Instruction*> keep_first(const PeepholeMatch& m){
+    return {m.instrs[0]};
+}
+
+bool match_dead_def(const PeepholeMatch& m){
+    Instruction* instr = m.instrs[0];
+    if (!is_pure(instr) && !(instr->type == I_LW && is_plain_memory(m.ops[0]))) return false;
+    int def = explicit_def(instr);
+    if (def <= 0 || def == 30) return false;
+    return !(m.live[0] & REG(def));
+}
+
+//endregion
+
+const std::vector<PeepholeRule>& peephole_rules(){
+    static const std::vector<PeepholeRule> rules = {
+            {"addi r, r, 0", {{I_ADDI}}, match_self_addi, remove_all},
+            {"shift r, r, 0", {{I_SLL, I_SRA}}, match_self_shift, remove_all},
+            {"store then load same slot", {{I_SW}, {I_LW}}, match_store_load, rewrite_store_load},
+            {"load then store back", {{I_LW}, {I_SW}}, match_load_store, keep_first},
+            {"move into next use", {{I_ADD, I_ADDI, I_OR, I_SLL, I_SRA}, {}}, match_move_into_use, rewrite_move_into_use},
+            {"move into previous def", {{}, {I_ADD, I_ADDI, I_OR, I_SLL, I_SRA}}, match_move_into_def, rewrite_move_into_def},
+            {"dead definition", {{}}, match_dead_def, remove_all},
+    };
+    return rules;
+}
@@ -0,0 +1,71 @@
+#ifndef I2C2_MIPSPEEPHOLE_H
+#define I2C2_MIPSPEEPHOLE_H
+
+#include <vector>
+#include <set>
+#include <map>
+#include <string>
+
+#include "../mips/MipsInstructions.h"
+
+/// Bit i is set if register $i is in the set
+typedef uint32_t RegSet;
+#define ALL_REGS ((RegSet) 0xFFFFFFFF)
+#define REG(r) ((RegSet) 1 << (r))
+
+/// Registers an instruction reads, including the ones a call or return reads implicitly
+RegSet reg_uses(Instruction* instr, bool hand_written = false);
+/// Registers an instruction writes, including everything a call overwrites
+RegSet reg_defs(Instruction* instr, bool hand_written = false);
+
+/// Registers read through the instruction's own operands (the ones rename_uses can change)
+RegSet explicit_uses(Instruction* instr);
+/// Register written through the instruction's own operands, -1 if none
+int explicit_def(Instruction* instr);
+
+void rename_uses(Instruction* instr, int old_reg, int new_reg);
+void rename_def(Instruction* instr, int new_reg);
+
+/// Returns the source register if the instruction only copies one register into another, -1 otherwise
+int move_source(Instruction* instr);
+
+/// Returns true if the instruction only computes a value into a register (no memory, pins or jumps)
+bool is_pure(Instruction* instr);
+
+/// Index each jump or branch goes to: -1 if there is no jump target (or it's a call), n if it can't be found
+std::vector<int> jump_targets(const std::vector<Instruction*>& instructions, std::map<std::string, Instruction*>& labels,
+                              bool include_calls = false);
+
+/// Registers live after each instruction, found by iterating over the control flow graph.
+/// Everything is live after the last instruction and after jumps to unknown labels.
+/// Calls and returns in hand written asm are assumed to pass values in every register.
+std::vector<RegSet> live_out(const std::vector<Instruction*>& instructions, std::map<std::string, Instruction*>& labels,
+                             const std::set<Instruction*>& hand_written);
+
+/// Rewrites instructions that read a copy of a register to read the original instead, as long as
+/// the copy holds on every path to them. Returns how many instructions were changed.
+/// The copies themselves are left for dead definition removal, and the instructions in keep are left as they are.
+/// Labels in taken have their address kept somewhere other than an la, so they can be jumped to from anywhere too
+int propagate_copies(const std::vector<Instruction*>& instructions, std::map<std::string, Instruction*>& labels,
+                     const std::set<Instruction*>& keep, const std::set<std::string>& taken = {});
+
+/// A window of consecutive instructions being matched against a rule
+struct PeepholeMatch{
+    std::vector<Instruction*> instrs;
+    std::vector<Operands> ops;
+    // registers live after each instruction in the window
+    std::vector<RegSet> live;
+};
+
+/// A pattern of instruction types (an empty set matches any instruction),
+/// a check on their operands, and what to replace them with
+struct PeepholeRule{
+    std::string name;
+    std::vector<std::set<InstructionType>> pattern;
+    bool (*matches)(const PeepholeMatch& match);
+    std::vector<Instruction*> (*rewrite)(const PeepholeMatch& match);
+};
+
+const std::vector<PeepholeRule>& peephole_rules();
+
+#endif //I2C2_MIPSPEEPHOLE_H
@@ -0,0 +1,135 @@
+#include "MipsScheduler.h"
+#include "strengthReduction.h"
+
+#include <algorithm>
+
+int result_latency(Instruction* instr){
+    switch (instr->type) {
+        case I_LW: return LOAD_USE_CYCLES;
+        case I_MUL:
+        case I_HMUL: return MUL_CYCLES;
+        case I_DIV: return DIV_CYCLES;
+        default: return 1;
+    }
+}
+
+bool ends_block(Instruction* instr){
+    return !instr->get_target().empty() || instr->type == I_JR || instr->type == I_BEX || instr->type == I_SETX;
+}
+
+// pins live above 4096, so only dmem variables and the stack are known not to be pins
+bool is_plain_memory(Instruction* instr){
+    Operands ops = instr->get_operands();
+    return (ops.rs == 0 && ops.imm >= 0 && ops.imm < 4096) || ops.rs == 29;
+}
+
+// instructions whose order matters to the outside world
+bool is_ordered(Instruction* instr){
+    if (instr->type == I_TEST_LOG) return true;
+    if ((instr->type == I_LW || instr->type == I_SW) && !is_plain_memory(instr)) return true;
+    return (explicit_uses(instr) & REG(3)) != 0;
+}
+
+// latency[i][j] > 0 if j has to come that many cycles after i
+std::vector<std::vector<int>> dependencies(const std::vector<Instruction*>& block){
+    int n = (int) block.size();
+    std::vector<std::vector<int>> latency(n, std::vector<int>(n, 0));
+    for (int j = 0; j < n; j++){
+        RegSet uses_j = reg_uses(block[j]);
+        RegSet defs_j = reg_defs(block[j]) & ~REG(0);
+        bool memory_j = block[j]->type == I_LW || block[j]->type == I_SW;
+        for (int i = 0; i < j; i++){
+            RegSet defs_i = reg_defs(block[i]) & ~REG(0);
+            bool memory_i = block[i]->type == I_LW || block[i]->type == I_SW;
+            if (defs_i & uses_j) latency[i][j] = result_latency(block[i]);
+            // a slow result can't land on top of a later one
+            else if (defs_i & defs_j) latency[i][j] = result_latency(block[i]);
+            else if (reg_uses(block[i]) & defs_j) latency[i][j] = 1;
+            // stores can't pass any memory access, and pins and the clock have to be read and written in order
+            else if (memory_i && memory_j && (block[i]->type == I_SW || block[j]->type == I_SW)) latency[i][j] = 1;
+            else if ((is_ordered(block[i]) || memory_i) && (is_ordered(block[j]) || memory_j) &&
+                     (is_ordered(block[i]) || is_ordered(block[j]))) latency[i][j] = 1;
+            else if (j == n - 1 && ends_block(block[j])) latency[i][j] = 1;
+        }
+    }
+    return latency;
+}
+
+std::vector<int> block_starts(const std::vector<Instruction*>& instructions, const std::set<Instruction*>& labelled,
+                              const std::set<Instruction*>& hand_written){
+    std::vector<int> starts;
+    for (int i = 0; i < instructions.size(); i++){
+        bool start = i == 0 || labelled.find(instructions[i]) != labelled.end() ||
+                     hand_written.find(instructions[i]) != hand_written.end() ||
+                     ends_block(instructions[i - 1]) || hand_written.find(instructions[i - 1]) != hand_written.end();
+        if (start) starts.push_back(i);
+    }
+    return starts;
+}
+
+int estimate_stalls(const std::vector<Instruction*>& block){
+    // cycle each register's value can be read from
+    int reg_ready[32] = {0};
+    int stalls = 0;
+    int cycle = 0;
+    for (Instruction* instr : block){
+        int issue = cycle;
+        RegSet uses = reg_uses(instr);
+        RegSet defs = reg_defs(instr);
+        for (int r = 1; r < 32; r++) if (uses & REG(r)) issue = std::max(issue, reg_ready[r]);
+        stalls += issue - cycle;
+        cycle = issue + 1;
+        for (int r = 1; r < 32; r++) if (defs & REG(r)) reg_ready[r] = issue + result_latency(instr);
+    }
+    return stalls;
+}
+
+std::vector<Instruction*> schedule_block(const std::vector<Instruction*>& block){
+    int n = (int) block.size();
+    std::vector<std::vector<int>> latency = dependencies(block);
+
+    // the longest chain of latencies from each instruction to the end goes first
+    std::vector<int> priority(n, 0);
+    for (int i = n - 1; i >= 0; i--){
+        priority[i] = result_latency(block[i]);
+        for (int j = i + 1; j < n; j++){
+            if (latency[i][j] > 0) priority[i] = std::max(priority[i], latency[i][j] + priority[j]);
+        }
+    }
+
+    std::vector<int> issue(n, -1);
+    std::vector<Instruction*> order;
+    int cycle = 0;
+    while (order.size() < n){
+        // of the instructions with everything they depend on placed, take the most urgent one that's ready now,
+        // or the one that will be ready soonest
+        int best = -1;
+        int best_ready = 0;
+        for (int j = 0; j < n; j++){
+            if (issue[j] >= 0) continue;
+            int ready = cycle;
+            bool placed = true;
+            for (int i = 0; i < j && placed; i++){
+                if (latency[i][j] == 0) continue;
+                if (issue[i] < 0) placed = false;
+                else ready = std::max(ready, issue[i] + latency[i][j]);
+            }
+            if (!placed) continue;
+            bool now = ready <= cycle;
+            bool best_now = best != -1 && best_ready <= cycle;
+            bool better;
+            if (best == -1) better = true;
+            else if (now != best_now) better = now;
+            else if (now) better = priority[j] > priority[best];
+            else better = ready < best_ready || (ready == best_ready && priority[j] > priority[best]);
+            if (better){
+                best = j;
+                best_ready = ready;
+            }
+        }
+        issue[best] = best_ready;
+        cycle = best_ready + 1;
+        order.push_back(block[best]);
+    }
+    return order;
+}
@@ -0,0 +1,30 @@
+#ifndef I2C2_MIPSSCHEDULER_H
+#define I2C2_MIPSSCHEDULER_H
+
+#include <vector>
+#include <set>
+
+#include "MipsPeephole.h"
+
+// cycles after a lw before the next instruction can use what it loaded
+#ifndef LOAD_USE_CYCLES
+#define LOAD_USE_CYCLES 2
+#endif
+
+/// Cycles after an instruction issues before its result can be read
+int result_latency(Instruction* instr);
+
+/// Index of the first instruction of each basic block: after jumps, branches and calls, and at labels.
+/// Hand written asm instructions are each a block of their own, since they never move.
+std::vector<int> block_starts(const std::vector<Instruction*>& instructions, const std::set<Instruction*>& labelled,
+                              const std::set<Instruction*>& hand_written);
+
+/// Cycles a basic block waits on results that aren't ready yet, running its instructions in order
+int estimate_stalls(const std::vector<Instruction*>& block);
+
+/// The instructions of a basic block in an order that waits less on loads and the multdiv unit.
+/// A jump, branch or call at the end stays there. Memory accesses that could touch pins and reads of the clock
+/// stay in the same order, and so does anything else that depends on something before it.
+std::vector<Instruction*> schedule_block(const std::vector<Instruction*>& block);
+
+#endif //I2C2_MIPSSCHEDULER_H
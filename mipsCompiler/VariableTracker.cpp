@@ -3,6 +3,7 @@
 //
 
 #include "VariableTracker.h"
+#include "operationsCompiler.h"
 #include <algorithm>
 
 void FreqTracker::remove(const std::string &var) {
@@ -111,6 +112,11 @@ void VariableTracker::store_var_in_memory(const std::string& var) {
         throw std::runtime_error("Variable not found");
     }
     VarLocation* loc = var_to_location[var];
+    if (loc->is_constant){
+        if (loc->in_reg) free_regs.push_back(loc->reg);
+        loc->in_reg = false;
+        return;
+    }
     if (loc->in_global_mem){
         if (loc->in_reg){
             mipsBuilder->addInstruction(new InstrSw(loc->reg, 0, (int16_t) loc->global_mem), "");
@@ -165,22 +171,28 @@ void VariableTracker::store_var_in_stack(const std::string &var, const std::stri
     loc->stack_mem = mem;
     stack_offset++;
 }
-void VariableTracker::add_stack_offset(int offset) {
-    stack_offset += offset;
-    mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) -offset), "");
+void VariableTracker::reserve_call_args(int count) {
+    if (in_frame) {
+        if (count > frame_call_args) throw std::runtime_error("Call arguments don't fit in the frame planned for them");
+        return;
+    }
+    stack_offset += count;
+    mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) -count), "");
 }
-void VariableTracker::reduce_stack_offset(int offset) {
-    stack_offset -= offset;
-    mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) offset), "");
+void VariableTracker::release_call_args(int count) {
+    if (in_frame) return;
+    stack_offset -= count;
+    mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) count), "");
 }
 
 uint8_t VariableTracker::getFreeReg() {
     if(free_regs.empty()){
         std::string possible_var;
+        // constants can be built again, so they go first
         for (auto& [name, loc] : var_to_location) {
-            if (loc->in_reg) {
+            if (loc->in_reg && (possible_var.empty() || loc->is_constant)) {
                 possible_var = name;
-                break;
+                if (loc->is_constant) break;
             }
         }
         if (possible_var.empty()) {
@@ -264,11 +276,23 @@ uint8_t VariableTracker::getReg(const std::string &var, bool modify) {
             return loc->reg;
         }
 
+        if (loc->is_constant) {
+            uint8_t reg = getFreeReg();
+            load_constant(reg, loc->constant, mipsBuilder);
+
+            regFreq.use(name);
+            loc->in_reg = true;
+            loc->reg = reg;
+
+            return reg;
+        }
+
         // if variable is in memory, load it into a register
         if (loc->in_stack || loc->in_stack_save) {
             uint32_t mem;
             if (loc->in_stack) {
-                mem = stack_offset - loc->stack_mem;
+                // a function's own slots don't move, while the stack pointer moves with whatever is pushed after
+                mem = in_frame ? loc->stack_mem : stack_offset - loc->stack_mem;
             }
             else {
                 mem = stack_offset - loc->save_location;
@@ -291,6 +315,7 @@ uint8_t VariableTracker::getReg(const std::string &var, bool modify) {
             regFreq.use(name);
             loc->in_reg = true;
             loc->reg = reg;
+            loc->dirty = false;
 
             return reg;
         }
@@ -310,15 +335,46 @@ int VariableTracker::set_array(const std::string &var, int size) {
         mem_offset += size;
         return -mem;
     }
+    else if (in_frame) {
+        // store in the frame, in words set aside for it in the prologue
+        int mem = frame_array_top;
+        frame_array_top += size;
+        if (frame_array_top > stack_offset) throw std::runtime_error("Array " + var + " doesn't fit in the frame planned for it");
+        return mem + 1;
+    }
     else {
-        // store in stack
-        uint32_t mem = stack_offset;
+        // store in stack, right at the stack pointer it was moved down to
         stack_offset += size;
         mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) -size), "");
-        return mem + 1;
+        return 1;
     }
 }
 
+void VariableTracker::set_frame_layout(int call_args, int address_slots, int array_words) {
+    frame_call_args = call_args;
+    frame_next_slot = call_args;
+    frame_slots_end = call_args + address_slots;
+    frame_array_top = frame_slots_end;
+    stack_offset = frame_slots_end + array_words;
+}
+
+void VariableTracker::set_function_frame(const std::string &function, int words) {
+    function_frames[function] = words;
+}
+
+int VariableTracker::get_function_frame(const std::string &function) {
+    auto it = function_frames.find(function);
+    return it == function_frames.end() ? 0 : it->second;
+}
+
+int VariableTracker::mark_frame() {
+    return frame_array_top;
+}
+
+void VariableTracker::release_frame(int mark) {
+    frame_array_top = mark;
+}
+
 bool VariableTracker::var_exists(const std::string &var) {
     int scope = scope_level;
     while (scope >= 0) {
@@ -409,13 +465,56 @@ void VariableTracker::clear_regs() {
     }
 }
 
-void VariableTracker::store_current_regs_in_stack() {
+bool VariableTracker::live_across_call(const std::string &name) {
+    // inline bodies see their arguments through aliases, so keep everything
+    if (in_inline_func || live_vars.empty()) return true;
+    // globals are written back at the end of the function
+    if (name[0] == '0') return true;
+
+    std::string var = name.substr(name.find('-') + 1);
+    // temporaries hold parts of the expression the call is in
+    if (var.find("<temp") != std::string::npos) return true;
+
+    for (auto& live : live_vars) {
+        if (live.find(var) != live.end()) return true;
+    }
+    return false;
+}
+
+void VariableTracker::store_current_regs_in_stack(const std::string& callee) {
 
     std::vector<VarLocation*> to_store;
     std::vector<std::string> to_store_names;
 
+    GlobalEffects callee_effects;
+    bool callee_known = get_global_effects(callee, &callee_effects);
+
     for (auto &[name, loc]: var_to_location) {
-        if (loc->in_reg) {
+        if (scope_level > 0 && loc->in_reg && loc->is_constant) {
+            var_to_reload[name] = loc;
+            continue;
+        }
+        if (scope_level > 0 && loc->in_reg && name[0] == '0' && loc->in_global_mem) {
+            std::string var = name.substr(2);
+            // in a function, every assignment to a global is seen, so a copy that wasn't assigned to is still in memory.
+            // outside of one, only the globals stored as they're assigned to are known to be
+            bool changed = function_effects == nullptr ? !loc->must_load || loc->dirty :
+                           function_effects->changed_here.find(var) != function_effects->changed_here.end() && loc->dirty;
+            bool touched = !callee_known || callee_effects.used.find(var) != callee_effects.used.end() ||
+                           callee_effects.changed.find(var) != callee_effects.changed.end();
+            // a global the callee never sees can wait in the frame like anything else,
+            // but one memory already holds just needs loading again
+            if (changed && !touched) {
+                to_store.push_back(loc);
+                to_store_names.push_back(name);
+                continue;
+            }
+            if (changed) mipsBuilder->addInstruction(new InstrSw(loc->reg, 0, (int16_t) loc->global_mem), "");
+            loc->dirty = false;
+            var_to_reload[name] = loc;
+            continue;
+        }
+        if (loc->in_reg && (scope_level == 0 || live_across_call(name))) {
             to_store.push_back(loc);
             to_store_names.push_back(name);
         }
@@ -424,21 +523,41 @@ void VariableTracker::store_current_regs_in_stack() {
     if (scope_level > 0) {
         // store reg31 in stack
         int size = to_store.size() + 1;
-        mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) -size), "");
-        mipsBuilder->addInstruction(new InstrSw(31, 29, (int16_t) 0), "");
-        stack_offset += size;
-        stack_save_offset += size;
+        // offset of the save area from the current stack pointer
+        int base;
+        if (in_frame) {
+            // the save area is reserved once in the function's prologue, below everything else
+            frame_size = std::max(frame_size, size);
+            base = stack_offset;
+        }
+        else {
+            mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) -size), "");
+            stack_offset += size;
+            stack_save_offset += size;
+            base = 0;
+        }
+        if (!in_frame || !return_address.in_stack) {
+            mipsBuilder->addInstruction(new InstrSw(31, 29, (int16_t) base), "");
+            if (in_frame) return_address.in_stack = true;
+        }
         for (int i = 1; i < size; i++){
             auto loc = to_store[i-1];
-            mipsBuilder->addInstruction(new InstrSw(loc->reg, 29, i), "");
-            loc->save_location = stack_offset - i;
+            mipsBuilder->addInstruction(new InstrSw(loc->reg, 29, (int16_t) (base + i)), "");
+            loc->save_location = stack_offset - base - i;
             loc->in_stack_save = true;
             var_to_stack_save[to_store_names[i-1]] = loc;
         }
     }
     else {
-        // store in mem
+        // store in mem. globals already have a place there, which functions load them from
         for (auto loc : to_store) {
+            if (loc->in_global_mem) {
+                // globals whose address is taken are stored as they're assigned to
+                if (!loc->must_load || loc->dirty)
+                    mipsBuilder->addInstruction(new InstrSw(loc->reg, 0, (int16_t) loc->global_mem), "");
+                loc->dirty = false;
+                continue;
+            }
             loc->in_global_mem = true;
             loc->global_mem = mem_offset;
             mipsBuilder->addInstruction(new InstrSw(loc->reg, 0, (int16_t) mem_offset), "");
@@ -451,23 +570,105 @@ void VariableTracker::store_current_regs_in_stack() {
 void VariableTracker::restore_regs_from_stack() {
     if (scope_level == 0) return;
 
-    // restore reg31
-    mipsBuilder->addInstruction(new InstrLw(31, 29, 0), "");
+    // reg31 stays in the frame until the function returns
+    if (in_frame) return_address.in_reg = false;
+    else mipsBuilder->addInstruction(new InstrLw(31, 29, 0), "");
 
     for (auto &[name, loc]: var_to_stack_save) {
         reserve_reg(loc->reg);
         loc->in_reg = true;
         loc->in_stack_save = false;
         remove_free_reg(loc->reg);
-        uint32_t mem = stack_offset - loc->save_location;
+        int mem = stack_offset - loc->save_location;
         mipsBuilder->addInstruction(new InstrLw(loc->reg, 29, (int16_t) mem), "");
         regFreq.use(name);
     }
+    var_to_stack_save.clear();
+
+    for (auto &[name, loc]: var_to_reload) {
+        reserve_reg(loc->reg);
+        loc->in_reg = true;
+        remove_free_reg(loc->reg);
+        if (loc->is_constant) load_constant(loc->reg, loc->constant, mipsBuilder);
+        else mipsBuilder->addInstruction(new InstrLw(loc->reg, 0, (int16_t) loc->global_mem), "");
+        loc->dirty = false;
+        regFreq.use(name);
+    }
+    var_to_reload.clear();
 
     // restore stack pointer
-    mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) stack_save_offset), "");
-    stack_offset -= stack_save_offset;
-    stack_save_offset = 0;
+    if (stack_save_offset > 0) {
+        mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) stack_save_offset), "");
+        stack_offset -= stack_save_offset;
+        stack_save_offset = 0;
+    }
+}
+
+void VariableTracker::push_live(const std::set<std::string> &names) {
+    live_vars.push_back(names);
+}
+
+void VariableTracker::pop_live() {
+    live_vars.pop_back();
+}
+
+bool VariableTracker::used_later(const std::string &var) {
+    if (scope_level == 0 || live_vars.empty()) return true;
+    for (auto& live : live_vars) {
+        if (live.find(var) != live.end()) return true;
+    }
+    return false;
+}
+
+int VariableTracker::get_frame_size() {
+    return frame_size;
+}
+
+int VariableTracker::get_stack_offset() {
+    return stack_offset;
+}
+
+void VariableTracker::save_return_address() {
+    if (!in_frame || return_address.in_stack) return;
+    mipsBuilder->addInstruction(new InstrSw(31, 29, (int16_t) stack_offset), "");
+    return_address.in_stack = true;
+    frame_size = std::max(frame_size, 1);
+}
+
+void VariableTracker::restore_return_address() {
+    if (!in_frame || return_address.in_reg) return;
+    mipsBuilder->addInstruction(new InstrLw(31, 29, (int16_t) stack_offset), "");
+    return_address.in_reg = true;
+}
+
+ReturnAddressState VariableTracker::get_return_address_state() {
+    return return_address;
+}
+
+void VariableTracker::set_return_address_state(ReturnAddressState state) {
+    return_address = state;
+}
+
+void VariableTracker::store_globals() {
+    for (auto& [name, loc] : var_to_location) {
+        if (loc->in_reg && name[0] == '0') {
+            if (function_effects != nullptr &&
+                (function_effects->changed_here.find(name.substr(2)) == function_effects->changed_here.end() || !loc->dirty)) continue;
+            mipsBuilder->addInstruction(new InstrSw(loc->reg, 0, (int16_t) loc->global_mem), "");
+        }
+    }
+}
+
+void VariableTracker::mark_assigned(const std::string &var) {
+    int scope = scope_level;
+    while (scope >= 0 && var_to_location.find(get_varname(var, scope)) == var_to_location.end()) scope--;
+    if (scope < 0) return;
+    VarLocation* loc = var_to_location[get_varname(var, scope)];
+    loc->dirty = true;
+    if (loc->must_load && loc->in_global_mem && loc->in_reg && !loc->is_constant) {
+        mipsBuilder->addInstruction(new InstrSw(loc->reg, 0, (int16_t) loc->global_mem), "");
+        loc->dirty = false;
+    }
 }
 
 void VariableTracker::incScope(bool is_inline){
@@ -476,6 +677,10 @@ void VariableTracker::incScope(bool is_inline){
 
     if (is_inline) return;
 
+    in_frame = true;
+    frame_size = 0;
+    return_address = {true, false};
+
     for (auto& [name, loc] : var_to_location) {
         if (loc->in_reg) {
             var_to_reg_save[name] = loc;
@@ -491,10 +696,10 @@ void VariableTracker::decScope(bool is_inline) {
 
     std::vector<std::string> names_to_delete;
 
+    if (!is_inline) store_globals();
+
     for (auto& [name, loc] : var_to_location) {
-        if (loc->in_reg && name[0] == '0' && !is_inline) {
-            mipsBuilder->addInstruction(new InstrSw(loc->reg, 0, (int16_t) loc->global_mem), "");
-        }
+        if (name[0] == '0') continue;
         else if (name[0] == '1' && scope_level == 1){
             names_to_delete.push_back(name);
         }
@@ -511,16 +716,29 @@ void VariableTracker::decScope(bool is_inline) {
     if (!is_inline)
         clear_regs();
 
-    if (!is_inline && stack_offset > 0) {
-        mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) stack_offset), "");
+    if (!is_inline && stack_offset + frame_size > 0) {
+        mipsBuilder->addInstruction(new InstrAddi(29, 29, (int16_t) (stack_offset + frame_size)), "");
         stack_offset = 0;
     }
+    if (!is_inline) {
+        in_frame = false;
+        frame_size = 0;
+        frame_call_args = 0;
+        frame_next_slot = 0;
+        frame_slots_end = 0;
+        frame_array_top = 0;
+        function_effects = nullptr;
+        kept_constants.clear();
+        pooled_constants.clear();
+    }
 
     // restore reg spots
     if (!is_inline) {
         for (auto &[name, loc]: var_to_reg_save) {
             loc->in_reg = true;
             loc->reg = loc->reg_save;
+            // the function may have loaded or stored it in between
+            loc->dirty = true;
 
             remove_free_reg(loc->reg);
 
@@ -543,6 +761,23 @@ int VariableTracker::get_mem_addr(const std::string &var) {
     auto* loc = loc_name ? var_to_location[name] : var_to_location[name_global];
     loc->must_load = true;
 
+    if (in_frame && loc_name) {
+        // the first time, the variable gets a slot of its own for the rest of the function
+        if (!loc->in_stack) {
+            if (frame_next_slot >= frame_slots_end) throw std::runtime_error("Variable " + var + " doesn't fit in the frame planned for it");
+            loc->stack_mem = frame_next_slot++;
+            loc->in_stack = true;
+            if (loc->in_reg) mipsBuilder->addInstruction(new InstrSw(loc->reg, 29, (int16_t) loc->stack_mem), "");
+        }
+        return (int) loc->stack_mem + 1;
+    }
+    if (in_frame && loc->in_global_mem) {
+        // memory has to hold the value a pointer to it reads
+        if (loc->in_reg && loc->dirty) mipsBuilder->addInstruction(new InstrSw(loc->reg, 0, (int16_t) loc->global_mem), "");
+        loc->dirty = false;
+        return -loc->global_mem;
+    }
+
     if (loc->in_stack) return stack_offset - loc->stack_mem - 1;
     if (scope_level > 0 && loc->in_reg) {
         store_reg_in_stack(loc->reg, "");
@@ -572,10 +807,10 @@ void VariableTracker::set_var_type(const std::string &var, TokenValue type) {
             continue;
         }
 
+        // only the innermost one, a local can have the same name as a global of another type
         auto* loc = var_to_location[name];
         loc->type = type;
-
-        scope--;
+        return;
     }
 }
 void VariableTracker::set_var_type_refs(const std::string &var, int refs) {
@@ -589,10 +824,10 @@ void VariableTracker::set_var_type_refs(const std::string &var, int refs) {
             continue;
         }
 
+        // only the innermost one, a local can have the same name as a global of another type
         auto* loc = var_to_location[name];
         loc->typeRefs = refs;
-
-        scope--;
+        return;
     }
 }
 
@@ -628,10 +863,17 @@ int VariableTracker::get_var_type_refs(const std::string &var) {
 
 }
 
-void VariableTracker::set_alias(const std::string& alias, const std::string& var) {
-    std::string alias_name = std::to_string(scope_level) + "-" + alias;
-    std::string var_name = std::to_string(scope_level) + "-" + var;
-    aliases[alias_name] = var_name;
+void VariableTracker::set_aliases(const std::vector<std::string>& names, const std::vector<std::string>& vars) {
+    // a variable can be from a scope further out, like a global, or be an alias itself, like an inlined parameter
+    std::vector<std::string> var_names;
+    for (const std::string& var : vars) {
+        int scope = scope_level;
+        while (scope > 0 && var_to_location.find(get_varname(var, scope)) == var_to_location.end()) scope--;
+        var_names.push_back(get_varname(var, scope));
+    }
+    for (int i = 0; i < names.size(); i++) {
+        aliases[std::to_string(scope_level) + "-" + names[i]] = var_names[i];
+    }
 }
 void VariableTracker::remove_alias(const std::string &alias) {
     std::string alias_name = std::to_string(scope_level) + "-" + alias;
@@ -658,9 +900,200 @@ FunctionToken *VariableTracker::get_inline_function(const std::string &name) {
     return inline_functions[name];
 }
 
+const std::map<std::string, FunctionToken*>& VariableTracker::get_inline_functions() {
+    return inline_functions;
+}
+
 bool VariableTracker::in_inline(){
     return in_inline_func;
 }
 void VariableTracker::set_in_inline(bool in) {
     in_inline_func = in;
 }
+
+bool VariableTracker::is_global(const std::string &var) {
+    return scope_level == 0 || var_to_location.find(get_varname(var)) == var_to_location.end();
+}
+
+void VariableTracker::add_induction_pointer(const std::string &array, const std::string &counter, const std::string &pointer) {
+    induction_pointers.push_back({get_varname(array), get_varname(counter), pointer, 0, scope_level});
+}
+
+void VariableTracker::remove_induction_pointers(const std::string &counter) {
+    std::string name = get_varname(counter);
+    for (int i = 0; i < induction_pointers.size(); i++) {
+        if (induction_pointers[i].counter != name) continue;
+        induction_pointers.erase(induction_pointers.begin() + i);
+        i--;
+    }
+}
+
+bool VariableTracker::get_induction_pointer(const std::string &array, const std::string &counter, InductionPointer *result) {
+    std::string array_name = get_varname(array);
+    std::string counter_name = get_varname(counter);
+    for (const InductionPointer& p : induction_pointers) {
+        if (p.scope != scope_level || p.array != array_name || p.counter != counter_name) continue;
+        *result = p;
+        return true;
+    }
+    return false;
+}
+
+void VariableTracker::advance_induction_pointers(const std::string &counter, int step) {
+    std::string name = get_varname(counter);
+    for (InductionPointer& p : induction_pointers) {
+        if (p.counter == name) p.lag += step;
+    }
+}
+
+void VariableTracker::update_induction_pointers(const std::string &counter) {
+    std::string name = get_varname(counter);
+    for (InductionPointer& p : induction_pointers) {
+        if (p.counter != name || p.lag == 0) continue;
+        uint8_t reg = getReg(p.pointer);
+        mipsBuilder->addInstruction(new InstrAddi(reg, reg, (int16_t) p.lag), "");
+        p.lag = 0;
+    }
+}
+
+void VariableTracker::set_global_effects(const std::string &function, const GlobalEffects &effects) {
+    global_effects[function] = effects;
+}
+
+void VariableTracker::add_program_function(const std::string &function) {
+    program_functions.insert(function);
+}
+
+bool VariableTracker::defines_function(const std::string &function) {
+    return program_functions.find(function) != program_functions.end();
+}
+
+bool VariableTracker::get_global_effects(const std::string &function, GlobalEffects *result) {
+    if (global_effects.find(function) == global_effects.end()) return false;
+    *result = global_effects[function];
+    return true;
+}
+
+void VariableTracker::promote_globals(const std::string &function) {
+    if (global_effects.find(function) == global_effects.end()) return;
+    function_effects = &global_effects[function];
+    for (const std::string& global : function_effects->promoted) {
+        // a parameter with the same name hides it
+        if (var_to_location.find(get_varname(global)) != var_to_location.end()) continue;
+        if (var_to_location.find(get_varname(global, 0)) == var_to_location.end()) continue;
+        getReg(global, false);
+    }
+}
+
+void VariableTracker::keep_constant(int32_t value) {
+    std::string var = "<const " + std::to_string(value) + ">";
+    uint8_t reg = add_variable(var);
+    load_constant(reg, value, mipsBuilder);
+    VarLocation* loc = var_to_location[get_varname(var)];
+    loc->is_constant = true;
+    loc->constant = value;
+    kept_constants[value] = var;
+}
+
+void VariableTracker::pool_constant(int32_t value) {
+    pooled_constants.insert(value);
+    if (constant_pool.find(value) != constant_pool.end()) return;
+    constant_pool[value] = mem_offset++;
+    if (data_image) {
+        set_static_word(constant_pool[value], value);
+        return;
+    }
+
+    // built in $2 before the program starts, which nothing is using yet
+    MipsBuilder init;
+    load_constant(2, value, &init);
+    init.addInstruction(new InstrSw(2, 0, (int16_t) constant_pool[value]), "");
+    std::vector<Instruction*> instructions = init.getInstructions();
+    for (auto it = instructions.rbegin(); it != instructions.rend(); it++) {
+        mipsBuilder->prependInstruction(*it);
+    }
+}
+
+bool VariableTracker::get_kept_constant(int32_t value, std::string *var) {
+    if (kept_constants.find(value) == kept_constants.end()) return false;
+    *var = kept_constants[value];
+    return true;
+}
+
+int VariableTracker::get_pool_address(int32_t value) {
+    if (pooled_constants.find(value) == pooled_constants.end()) return -1;
+    return constant_pool[value];
+}
+
+int VariableTracker::add_jump_table(const std::vector<std::string>& labels) {
+    int address = mem_offset;
+    mem_offset += (int) labels.size();
+    if (data_image) {
+        for (int i = 0; i < labels.size(); i++) mipsBuilder->addDataLabel(address + i, labels[i]);
+        return address;
+    }
+    // built in $2 before the program starts, like the constant pool
+    for (int i = 0; i < labels.size(); i++) {
+        jump_table_init.push_back(new InstrLa(2, labels[i]));
+        jump_table_init.push_back(new InstrSw(2, 0, (int16_t) (address + i)));
+    }
+    return address;
+}
+
+void VariableTracker::add_static_variable(const std::string &var, int32_t value) {
+    std::string name = get_varname(var);
+    if (var_to_location.find(name) != var_to_location.end()) {
+        throw std::runtime_error("Variable " + var + " already in use");
+    }
+    auto* loc = new VarLocation();
+    loc->in_global_mem = true;
+    loc->global_mem = mem_offset++;
+    var_to_location[name] = loc;
+    set_static_word((int) loc->global_mem, value);
+}
+
+void VariableTracker::set_static_word(int address, int32_t value) {
+    static_data[address] = value;
+}
+
+std::vector<int32_t> VariableTracker::get_static_data() {
+    for (auto& [address, value] : mipsBuilder->getDataLabelWords()) static_data[address] = value;
+    if (static_data.empty()) return {};
+    std::vector<int32_t> data(static_data.rbegin()->first + 1, 0);
+    for (auto& [address, value] : static_data) data[address] = value;
+    return data;
+}
+
+bool VariableTracker::at_top_level() {
+    return scope_level == 0;
+}
+
+void VariableTracker::set_data_image(bool enabled) {
+    data_image = enabled;
+}
+
+bool VariableTracker::has_data_image() {
+    return data_image;
+}
+
+void VariableTracker::set_size_first(bool enabled) {
+    size_first = enabled;
+}
+
+bool VariableTracker::is_size_first() {
+    return size_first;
+}
+
+int VariableTracker::reserve_memory(int size) {
+    int address = mem_offset;
+    mem_offset += size;
+    return address;
+}
+
+void VariableTracker::init_jump_tables() {
+    if (in_frame) return;
+    for (auto it = jump_table_init.rbegin(); it != jump_table_init.rend(); it++) {
+        mipsBuilder->prependInstruction(*it);
+    }
+    jump_table_init.clear();
+}
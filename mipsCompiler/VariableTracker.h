@@ -8,6 +8,7 @@
 #include "../parsing/tokenTypes.h"
 #include "MipsBuilder.h"
 #include <vector>
+#include <set>
 #include <stdexcept>
 
 
@@ -64,14 +65,20 @@ struct VarLocation{
 
     uint8_t reg_save;
 
-    uint32_t save_location;
+    int32_t save_location;
     bool must_load;
+    // the register has been assigned to since it was loaded from or stored to global memory
+    bool dirty;
 
     TokenValue type;
     int typeRefs;
 
     int tag;
 
+    // constants are built again instead of being stored
+    bool is_constant;
+    int32_t constant;
+
     VarLocation(){
         reg = 0;
         in_reg = false;
@@ -82,12 +89,43 @@ struct VarLocation{
         stack_save = 0;
         in_stack_save = false;
         must_load = false;
+        dirty = true;
         type = TokenValue::NONE;
         typeRefs = 0;
         tag = 0;
+        is_constant = false;
+        constant = 0;
     }
 };
 
+/// A pointer a loop keeps at &array[counter - lag], so array[counter + c] can be accessed at c + lag from it.
+/// Names are resolved in the scope the loop is in.
+struct InductionPointer{
+    std::string array;
+    std::string counter;
+    std::string pointer;
+    int lag;
+    int scope;
+};
+
+/// Where the current function's return address can be found.
+/// Claiming it is in fewer places than it really is is always safe.
+struct ReturnAddressState{
+    bool in_reg;    // $31 still holds it
+    bool in_stack;  // it has been saved in the first word of the frame
+};
+
+/// What a function may do to global variables
+struct GlobalEffects{
+    // everything the function can reach, through the calls it makes too
+    std::set<std::string> used;
+    std::set<std::string> changed;
+    // the globals its own body and inline calls may assign to. the rest never have to be stored back
+    std::set<std::string> changed_here;
+    // loaded into registers on entry and kept there until the function returns
+    std::vector<std::string> promoted;
+};
+
 class VariableTracker {
 private:
     MipsBuilder* mipsBuilder;
@@ -99,11 +137,54 @@ private:
     std::map<std::string, std::string> aliases;
 
     std::map<std::string, FunctionToken*> inline_functions;
+    // functions with a body in the program, which the runtime and builtins of the same name don't replace
+    std::set<std::string> program_functions;
+
+    std::vector<InductionPointer> induction_pointers;
+
+    // functions missing from here may use and change any global
+    std::map<std::string, GlobalEffects> global_effects;
+    // the function being compiled, if its effects are known
+    GlobalEffects* function_effects = nullptr;
+    // globals sent back to memory and constants let go of for a call, to be loaded into the same registers after it
+    std::map<std::string, VarLocation*> var_to_reload;
+
+    // large constants the function being compiled keeps in registers, and the ones it loads from the pool
+    std::map<int32_t, std::string> kept_constants;
+    std::set<int32_t> pooled_constants;
+    // where each constant in the pool is in memory
+    std::map<int32_t, int> constant_pool;
+    // stores filling in the switch jump tables, waiting to go at the start of the program
+    std::vector<Instruction*> jump_table_init;
+    // words of global memory that have a value before the program starts, if the program is loaded with them
+    std::map<int, int32_t> static_data;
+    bool data_image = false;
+    bool size_first = false;
 
     int mem_offset = 0;
     int stack_offset = 0;
     int stack_save_offset = 0;
 
+    // words of the current function's frame used to save registers across calls.
+    // they sit directly below the return address and are reserved once in the function's prologue
+    int frame_size = 0;
+    bool in_frame = false;
+    // the rest of the frame sits below the save area, from the stack pointer up: arguments past the fourth for the
+    // calls the function makes, a word for each local whose address is taken, then the arrays of the blocks being
+    // compiled. the words below the save area are counted in stack_offset from the start
+    int frame_call_args = 0;
+    int frame_next_slot = 0;
+    int frame_slots_end = 0;
+    int frame_array_top = 0;
+    // words each function compiled so far reserves in its prologue
+    std::map<std::string, int> function_frames;
+
+    // $31 is only saved on paths that make a call, and only reloaded when returning
+    ReturnAddressState return_address = {true, false};
+
+    // identifiers that may still be used after the statement being compiled, innermost last
+    std::vector<std::set<std::string>> live_vars;
+
     int scope_level = 0;
 
     int tag_level = 0;
@@ -122,6 +203,7 @@ private:
     void store_var_in_memory(const std::string& var);
     std::string get_varname(const std::string& var, int scope=-1);
     void remove_free_reg(int reg);
+    bool live_across_call(const std::string& name);
 
 public:
     explicit VariableTracker(MipsBuilder* builder){
@@ -140,7 +222,8 @@ public:
     /// Gets the register of a variable, loads it from memory into a register, or adds if it doesn't exist
     uint8_t getReg(const std::string &var, bool modify = true);
 
-    /// Allocates a constant amount amount of memory in the stack or heap for an array at compile time
+    /// Allocates a constant amount amount of memory in the stack or heap for an array at compile time.
+    /// Returns a negative or zero address in global memory, or one more than its offset from the stack pointer
     int set_array(const std::string& var, int size);
 
     /// Sets the type of a variable
@@ -168,14 +251,102 @@ public:
     /// Renames a variable
     void renameVar(const std::string& oldVar, const std::string& newVar);
 
-    /// Stores all current working variables in the stack (to use before a function call)
-    void store_current_regs_in_stack();
+    /// Stores the working variables that are still live in the stack (to use before a function call).
+    /// Globals the callee may use go back to their place in memory instead
+    void store_current_regs_in_stack(const std::string& callee = "");
 
-    /// Restores all working variables from the stack (to use after a function call)
+    /// Restores the saved working variables from the stack (to use after a function call)
     void restore_regs_from_stack();
 
-    void add_stack_offset(int offset);
-    void reduce_stack_offset(int offset);
+    /// Marks identifiers as possibly used after the statement currently being compiled
+    void push_live(const std::set<std::string>& names);
+    void pop_live();
+    /// Returns if a variable may be used after the statement being compiled. Anything at the top level may be
+    bool used_later(const std::string& var);
+
+    /// Number of words the current function needs to reserve in its prologue for saved registers
+    int get_frame_size();
+    int get_stack_offset();
+
+    /// Saves $31 in the frame if it isn't already (to use before code that may make calls)
+    void save_return_address();
+    /// Loads $31 back from the frame if a call has overwritten it (to use before returning)
+    void restore_return_address();
+    ReturnAddressState get_return_address_state();
+    void set_return_address_state(ReturnAddressState state);
+
+    /// Stores global variables held in registers back into memory, if the function may have changed them
+    void store_globals();
+    /// Notes that a variable's register was assigned to (to use after compiling the assignment).
+    /// A global whose address is taken is stored right away, so a pointer always finds its value in memory
+    void mark_assigned(const std::string& var);
+
+    void set_global_effects(const std::string& function, const GlobalEffects& effects);
+    /// Notes that the program has its own version of a function, so calls to it can't be done another way
+    void add_program_function(const std::string& function);
+    bool defines_function(const std::string& function);
+    /// Returns false if the function may use and change any global
+    bool get_global_effects(const std::string& function, GlobalEffects* result);
+    /// Loads the globals a function keeps in registers (to use on entry, after its parameters are added)
+    void promote_globals(const std::string& function);
+
+    /// Builds a constant in a register and keeps it there until the function ends. If the register is needed,
+    /// or a call overwrites it, the constant is built again instead of being stored
+    void keep_constant(int32_t value);
+    /// Makes the function being compiled load a constant from the pool. The first time a constant is pooled, it's
+    /// put in the data image, or without one the program is made to store it there before anything else runs,
+    /// so this has to come before the function's instructions are counted on
+    void pool_constant(int32_t value);
+    /// Finds the variable a kept constant is in
+    bool get_kept_constant(int32_t value, std::string* var);
+    /// Address of a pooled constant in memory, or -1 if the function builds it where it's used
+    int get_pool_address(int32_t value);
+
+    /// Sets aside a word of memory for each label of a switch's jump table, and returns where the table starts.
+    /// The labels' addresses go in the data image, or without one the program stores them there before anything
+    /// else runs, once init_jump_tables is called
+    int add_jump_table(const std::vector<std::string>& labels);
+    /// Sets aside words of global memory that no variable has, and returns where they start
+    int reserve_memory(int size);
+    /// Adds a global variable that's in memory with value before the program starts, instead of being set by it
+    void add_static_variable(const std::string& var, int32_t value);
+    /// Gives a word of global memory a value before the program starts
+    void set_static_word(int address, int32_t value);
+    /// The data image: the value of each word of global memory from address 0 when the program starts,
+    /// up to the last one that has one. Words that weren't given one are 0.
+    /// Jump tables hold the addresses of their labels, so this goes after the labels are linked
+    std::vector<int32_t> get_static_data();
+    /// Returns if what's being compiled is outside of every function
+    bool at_top_level();
+    /// Whether the program will be loaded with the data image, so globals can start out with their values there.
+    /// Otherwise the program sets every one of them itself
+    void set_data_image(bool enabled);
+    bool has_data_image();
+
+    /// Whether code should be kept small even when a bigger version would be faster, like at -Os
+    void set_size_first(bool enabled);
+    bool is_size_first();
+
+    /// Puts the stores for the jump tables added so far at the start of the program. This moves every instruction,
+    /// so it does nothing while a function is being compiled, which counts on where its own are until it's done
+    void init_jump_tables();
+
+    /// Sets aside the words below the save area of the function being compiled, as worked out by plan_frame.
+    /// To use on entry, before anything is stored in the frame
+    void set_frame_layout(int call_args, int address_slots, int array_words);
+    /// Where the next array goes in the frame. Arrays added after a mark are let go of by releasing it
+    int mark_frame();
+    void release_frame(int mark);
+
+    /// Records the words a function reserves in its prologue, once it's compiled
+    void set_function_frame(const std::string& function, int words);
+    /// Words a compiled function reserves in its prologue, or 0 if it has no frame
+    int get_function_frame(const std::string& function);
+
+    /// Makes room at the stack pointer for the arguments past the fourth of a call, and gives it back after.
+    /// Functions already have room for them in their frame
+    void reserve_call_args(int count);
+    void release_call_args(int count);
 
     /// Increases the scope. Clears register frequency tracking.
     void incScope(bool is_inline = false);
@@ -191,11 +362,28 @@ public:
     /// If positive (on stack), subtract 1
     int get_mem_addr(const std::string& var);
 
-    void set_alias(const std::string& alias, const std::string& var);
+    /// Makes each alias another name for the variable at the same index, in the current scope.
+    /// The variables are all found before any alias is made, so one can have the name of another's alias
+    void set_aliases(const std::vector<std::string>& names, const std::vector<std::string>& vars);
     void remove_alias(const std::string& alias);
 
     void add_inline_function(const std::string& name, FunctionToken* function);
     FunctionToken* get_inline_function(const std::string& name);
+    const std::map<std::string, FunctionToken*>& get_inline_functions();
+
+    /// Returns if a variable is global, rather than local to the function being compiled
+    bool is_global(const std::string& var);
+
+    /// Makes array[counter + c] use the variable pointer, which must hold &array[counter], until the counter's
+    /// pointers are removed
+    void add_induction_pointer(const std::string& array, const std::string& counter, const std::string& pointer);
+    void remove_induction_pointers(const std::string& counter);
+    /// Finds the pointer that follows array[counter]. Inline function bodies called in the loop never see it
+    bool get_induction_pointer(const std::string& array, const std::string& counter, InductionPointer* result);
+    /// Records that the counter moved by step while its pointers stayed where they were
+    void advance_induction_pointers(const std::string& counter, int step);
+    /// Catches the counter's pointers up to it
+    void update_induction_pointers(const std::string& counter);
 };
 
 #endif //I2C2_VARIABLETRACKER_H
@@ -0,0 +1,349 @@
+#include "astAnalysis.h"
+#include <cctype>
+#include <cstdint>
+#include <algorithm>
+
+void for_each_token(Token* token, const std::function<void(Token*)>& fn){
+    if (token == nullptr) return;
+    fn(token);
+
+    if (token->type == TYPE_GROUP){
+        for (Token* t : ((GroupToken*) token)->expressions) for_each_token(t, fn);
+        return;
+    }
+    if (token->type == TYPE_VALUE){
+        if (token->val_type == ARRAY){
+            for (Token* t : ((ArrayInitializationToken*) token)->values) for_each_token(t, fn);
+        }
+        return;
+    }
+    if (token->type == TYPE_OPERATOR){
+        if (token->val_type == IDENTIFIER){
+            auto* def = (DefinitionToken*) token;
+            for_each_token(def->value, fn);
+            for (Token* t : def->dimensions) for_each_token(t, fn);
+        }
+        else if (token->val_type == FUNCTION){
+            for (Token* t : ((FunctionCallToken*) token)->arguments) for_each_token(t, fn);
+        }
+        else {
+            auto* op = (BinaryOpToken*) token;
+            for_each_token(op->left, fn);
+            for_each_token(op->right, fn);
+        }
+        return;
+    }
+    if (token->type != TYPE_KEYWORD) return;
+
+    switch (token->val_type) {
+        case IF: {
+            auto* if_statement = (IfElseToken*) token;
+            for_each_token(if_statement->condition, fn);
+            for (Token* t : if_statement->elseIfConditions) for_each_token(t, fn);
+            for_each_token(if_statement->ifBody, fn);
+            for (GroupToken* body : if_statement->elseIfBodies) for_each_token(body, fn);
+            for_each_token(if_statement->elseBody, fn);
+            break;
+        }
+        case FOR: {
+            auto* for_statement = (ForToken*) token;
+            for_each_token(for_statement->init, fn);
+            for_each_token(for_statement->condition, fn);
+            for_each_token(for_statement->increment, fn);
+            for_each_token(for_statement->body, fn);
+            break;
+        }
+        case WHILE: {
+            auto* while_statement = (WhileToken*) token;
+            for_each_token(while_statement->condition, fn);
+            for_each_token(while_statement->body, fn);
+            break;
+        }
+        case SWITCH: {
+            auto* switch_statement = (SwitchToken*) token;
+            for_each_token(switch_statement->value, fn);
+            for_each_token(switch_statement->body, fn);
+            break;
+        }
+        case RETURN:
+            for_each_token(((ReturnToken*) token)->value, fn);
+            break;
+        default:
+            break;
+    }
+}
+
+void collect_asm_identifiers(const std::string& code, std::set<std::string>& ids, bool addresses){
+    if (code.find("$return") != std::string::npos) ids.insert("return");
+
+    // variables are referenced as (var), possibly inside an offset like 4096((var))
+    for (int i = 0; i < code.size(); i++){
+        if (code.at(i) != '(' || (!addresses && i > 0 && code.at(i - 1) == '(')) continue;
+        std::string name;
+        int j = i + 1;
+        while (j < code.size() && (isalnum(code.at(j)) || code.at(j) == '_')){
+            name += code.at(j);
+            j++;
+        }
+        if (!name.empty() && j < code.size() && code.at(j) == ')') ids.insert(name);
+    }
+}
+
+void collect_identifiers(Token* token, std::set<std::string>& ids){
+    for_each_token(token, [&ids](Token* t){
+        if (t->type == TYPE_IDENTIFIER) ids.insert(t->lexeme);
+        else if (t->type == TYPE_OPERATOR && t->val_type == IDENTIFIER) ids.insert(((DefinitionToken*) t)->name);
+        else if (t->type == TYPE_KEYWORD && t->val_type == ASM) collect_asm_identifiers(((AsmToken*) t)->asmCode, ids);
+    });
+}
+
+void collect_identifiers(const std::vector<Token*>& tokens, int start, std::set<std::string>& ids){
+    for (int i = start; i < tokens.size(); i++){
+        collect_identifiers(tokens[i], ids);
+    }
+}
+
+bool is_assignment(TokenValue op){
+    return op == EQ || op == ADD_EQ || op == MINUS_EQ || op == MULT_EQ || op == DIV_EQ || op == MOD_EQ ||
+           op == BIN_AND_EQ || op == BIN_OR_EQ || op == XOR_EQ || op == LSHIFT_EQ || op == RSHIFT_EQ;
+}
+
+bool is_named(Token* token, const std::string& name){
+    return token != nullptr && token->type == TYPE_IDENTIFIER && token->lexeme == name;
+}
+
+bool is_number(Token* token){
+    return token != nullptr && token->type == TYPE_VALUE && token->val_type == NUMBER_INT;
+}
+
+// step of an increment like i += c, i -= c, i = i + c or i = i - c, or 0
+int64_t counter_step(Token* increment, const std::string& name){
+    if (increment == nullptr || increment->type != TYPE_OPERATOR) return 0;
+    auto* op = (BinaryOpToken*) increment;
+    if (!is_named(op->left, name)) return 0;
+    if ((op->val_type == ADD_EQ || op->val_type == MINUS_EQ) && is_number(op->right)){
+        int64_t step = std::stoll(op->right->lexeme);
+        return op->val_type == ADD_EQ ? step : -step;
+    }
+    if (op->val_type != EQ || op->right == nullptr || op->right->type != TYPE_OPERATOR) return 0;
+    auto* value = (BinaryOpToken*) op->right;
+    if ((value->val_type != ADD && value->val_type != MINUS) || !is_named(value->left, name) || !is_number(value->right)) return 0;
+    int64_t step = std::stoll(value->right->lexeme);
+    return value->val_type == ADD ? step : -step;
+}
+
+bool may_change(Token* token, const std::string& name, const std::map<std::string, FunctionToken*>* functions,
+                std::set<std::string>& following){
+    bool changed = false;
+    for_each_token(token, [&](Token* t){
+        if (t->type == TYPE_OPERATOR && t->val_type == IDENTIFIER){
+            if (((DefinitionToken*) t)->name == name) changed = true;
+        }
+        else if (t->type == TYPE_OPERATOR && t->val_type == FUNCTION){
+            // inline functions can assign to their arguments
+            auto* call = (FunctionCallToken*) t;
+            if (!call->is_inline) return;
+            FunctionToken* function = nullptr;
+            if (functions != nullptr && functions->find(call->lexeme) != functions->end())
+                function = functions->at(call->lexeme);
+            for (int i = 0; i < call->arguments.size(); i++){
+                if (!is_named(call->arguments[i], name)) continue;
+                // without the function, or if it calls itself, any parameter may be assigned to
+                if (function == nullptr || i >= function->parameters.size() || !following.insert(call->lexeme).second){
+                    changed = true;
+                    continue;
+                }
+                if (may_change(function->body, function->parameters[i]->name, functions, following)) changed = true;
+                following.erase(call->lexeme);
+            }
+        }
+        else if (t->type == TYPE_OPERATOR){
+            auto* op = (BinaryOpToken*) t;
+            if ((is_assignment(op->val_type) || op->val_type == REF) && (is_named(op->left, name) || is_named(op->right, name)))
+                changed = true;
+        }
+        else if (t->type == TYPE_KEYWORD && t->val_type == ASM){
+            std::set<std::string> ids;
+            collect_asm_identifiers(((AsmToken*) t)->asmCode, ids, false);
+            if (ids.find(name) != ids.end()) changed = true;
+        }
+    });
+    return changed;
+}
+
+bool may_change(Token* token, const std::string& name, const std::map<std::string, FunctionToken*>* functions){
+    std::set<std::string> following;
+    return may_change(token, name, functions, following);
+}
+
+int constant_trip_count(ForToken* loop){
+    // int i = a
+    if (loop->init == nullptr || loop->init->type != TYPE_OPERATOR || loop->init->val_type != IDENTIFIER) return -1;
+    auto* def = (DefinitionToken*) loop->init;
+    if (def->valueType != INT || def->refCount != 0 || !def->dimensions.empty() || !is_number(def->value)) return -1;
+    std::string name = def->name;
+    int64_t start = std::stoll(def->value->lexeme);
+
+    // i < b
+    if (loop->condition == nullptr || loop->condition->type != TYPE_OPERATOR) return -1;
+    auto* condition = (BinaryOpToken*) loop->condition;
+    TokenValue cmp = condition->val_type;
+    if (cmp != LT && cmp != LTE && cmp != GT && cmp != GTE && cmp != NOT_EQ) return -1;
+    if (!is_named(condition->left, name) || !is_number(condition->right)) return -1;
+    int64_t end = std::stoll(condition->right->lexeme);
+
+    int64_t step = counter_step(loop->increment, name);
+    if (step == 0) return -1;
+
+    // nothing else may write i, alias it or shadow it, and copies of the body can't make arrays
+    if (may_change(loop->body, name)) return -1;
+    bool arrays = false;
+    for_each_token(loop->body, [&](Token* t){
+        if (t->type == TYPE_OPERATOR && t->val_type == IDENTIFIER && !((DefinitionToken*) t)->dimensions.empty())
+            arrays = true;
+    });
+    if (arrays) return -1;
+
+    if (cmp == LTE) end++;
+    if (cmp == GTE) end--;
+    int64_t trips;
+    if (cmp == LT || cmp == LTE){
+        if (step < 0 && start < end) return -1;
+        trips = start < end ? (end - start + step - 1) / step : 0;
+    }
+    else if (cmp == GT || cmp == GTE){
+        if (step > 0 && start > end) return -1;
+        trips = start > end ? (start - end - step - 1) / -step : 0;
+    }
+    else {
+        if ((end - start) % step != 0 || (end - start) / step < 0) return -1;
+        trips = (end - start) / step;
+    }
+
+    // i has to stay an int the whole way
+    int64_t last = start + trips * step;
+    if (trips > INT32_MAX || last > INT32_MAX || last < INT32_MIN) return -1;
+    return (int) trips;
+}
+
+// the counter and constant of an index like i, i + c, c + i or i - c, or false
+bool split_index(Token* index, std::string* counter, int64_t* offset){
+    *offset = 0;
+    if (index->type == TYPE_OPERATOR && (index->val_type == ADD || index->val_type == MINUS)){
+        auto* sum = (BinaryOpToken*) index;
+        if (is_number(sum->right)){
+            *offset = std::stoll(sum->right->lexeme);
+            if (index->val_type == MINUS) *offset = -*offset;
+            index = sum->left;
+        }
+        else if (index->val_type == ADD && is_number(sum->left)){
+            *offset = std::stoll(sum->left->lexeme);
+            index = sum->right;
+        }
+    }
+    if (index->type != TYPE_IDENTIFIER || *offset >= 1024 || *offset <= -1024) return false;
+    *counter = index->lexeme;
+    return true;
+}
+
+InductionVariable find_induction_variable(ForToken* loop){
+    InductionVariable iv = {"", 0, {}, true};
+    if (loop->init == nullptr || loop->init->type != TYPE_OPERATOR || loop->init->val_type != IDENTIFIER) return iv;
+    auto* def = (DefinitionToken*) loop->init;
+    if (def->valueType != INT || def->refCount != 0 || !def->dimensions.empty()) return iv;
+    std::string name = def->name;
+
+    int64_t step = counter_step(loop->increment, name);
+    if (step == 0 || step >= 1024 || step <= -1024 || may_change(loop->body, name)) return iv;
+
+    // the counter's own identifier tokens that are array indices
+    std::set<Token*> index_uses;
+    std::set<std::string> arrays;
+    std::set<std::string> other_arrays;
+    for_each_token(loop->body, [&](Token* t){
+        if (t->type != TYPE_OPERATOR || t->val_type != ARRAY) return;
+        auto* access = (BinaryOpToken*) t;
+        if (access->left == nullptr || access->left->type != TYPE_IDENTIFIER) return;
+        std::string counter;
+        int64_t offset;
+        if (split_index(access->right, &counter, &offset) && counter == name){
+            arrays.insert(access->left->lexeme);
+            Token* index = access->right;
+            if (index->type == TYPE_OPERATOR) index = is_named(((BinaryOpToken*) index)->left, name) ?
+                    ((BinaryOpToken*) index)->left : ((BinaryOpToken*) index)->right;
+            index_uses.insert(index);
+        }
+    });
+
+    for (const std::string& array : arrays){
+        if (!may_change(loop->body, array)) iv.arrays.push_back(array);
+    }
+    if (iv.arrays.empty()) return iv;
+
+    // any other use of the counter keeps it around
+    for_each_token(loop->body, [&](Token* t){
+        if (is_named(t, name) && index_uses.find(t) == index_uses.end()) iv.only_indexes = false;
+    });
+    for (const std::string& array : arrays){
+        if (std::find(iv.arrays.begin(), iv.arrays.end(), array) == iv.arrays.end()) iv.only_indexes = false;
+    }
+
+    iv.counter = name;
+    iv.step = (int) step;
+    return iv;
+}
+
+bool find_memory_loop(ForToken* loop, MemoryLoop* result){
+    // int i = 0
+    if (loop->init == nullptr || loop->init->type != TYPE_OPERATOR || loop->init->val_type != IDENTIFIER) return false;
+    auto* def = (DefinitionToken*) loop->init;
+    if (def->valueType != INT || def->refCount != 0 || !def->dimensions.empty() || !is_number(def->value) ||
+        std::stoll(def->value->lexeme) != 0) return false;
+    std::string name = def->name;
+    if (counter_step(loop->increment, name) != 1) return false;
+
+    // i < n
+    if (loop->condition == nullptr || loop->condition->type != TYPE_OPERATOR || loop->condition->val_type != LT) return false;
+    auto* condition = (BinaryOpToken*) loop->condition;
+    Token* count = condition->right;
+    if (!is_named(condition->left, name) || count == nullptr) return false;
+    if (!is_number(count) && (count->type != TYPE_IDENTIFIER || count->lexeme == name)) return false;
+
+    // dst[i] = src[i] or dst[i] = value
+    if (loop->body == nullptr || loop->body->expressions.size() != 1) return false;
+    Token* statement = loop->body->expressions[0];
+    if (statement->type != TYPE_OPERATOR || statement->val_type != EQ) return false;
+    auto* assign = (BinaryOpToken*) statement;
+    auto* store = (BinaryOpToken*) assign->left;
+    if (store == nullptr || store->type != TYPE_OPERATOR || store->val_type != ARRAY) return false;
+    if (store->left == nullptr || store->left->type != TYPE_IDENTIFIER || !is_named(store->right, name)) return false;
+    std::string dst = store->left->lexeme;
+    if (dst == name || (!is_number(count) && count->lexeme == dst)) return false;
+
+    Token* value = assign->right;
+    std::string src;
+    if (value != nullptr && value->type == TYPE_OPERATOR && value->val_type == ARRAY){
+        auto* load = (BinaryOpToken*) value;
+        if (load->left == nullptr || load->left->type != TYPE_IDENTIFIER || !is_named(load->right, name)) return false;
+        src = load->left->lexeme;
+        if (src == name) return false;
+        value = nullptr;
+    }
+    else {
+        bool literal = value != nullptr && value->type == TYPE_VALUE && (value->val_type == NUMBER_INT || value->val_type == NUMBER_FLOAT);
+        bool variable = value != nullptr && value->type == TYPE_IDENTIFIER && value->lexeme != name && value->lexeme != dst;
+        if (!literal && !variable) return false;
+    }
+
+    *result = {name, dst, src, value, count};
+    return true;
+}
+
+int same_value_run(const std::vector<Token*>& values, int start){
+    Token* first = values[start];
+    if (first->type != TYPE_VALUE || (first->val_type != NUMBER_INT && first->val_type != NUMBER_FLOAT)) return 1;
+    int end = start + 1;
+    while (end < values.size() && values[end]->type == TYPE_VALUE && values[end]->val_type == first->val_type &&
+           values[end]->lexeme == first->lexeme) end++;
+    return end - start;
+}
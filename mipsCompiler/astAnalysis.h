@@ -0,0 +1,71 @@
+#ifndef I2C2_ASTANALYSIS_H
+#define I2C2_ASTANALYSIS_H
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../parsing/tokenTypes.h"
+
+/// Calls fn on a token and every token in its parse tree, parents first.
+/// Function definitions are visited but not entered.
+void for_each_token(Token* token, const std::function<void(Token*)>& fn);
+
+/// Adds the name of every variable read or written in a token's parse tree to ids.
+/// Variables used in __asm__ blocks through (var) are included.
+void collect_identifiers(Token* token, std::set<std::string>& ids);
+
+/// Adds the variables an asm block names as (var) to ids, and "return" if it uses $return. addresses is whether to
+/// include the ones only used as the address of a load or store, like 4096((var)), which the asm can't assign to
+void collect_asm_identifiers(const std::string& code, std::set<std::string>& ids, bool addresses = true);
+
+/// Returns if an operator assigns to its left side, like = or +=
+bool is_assignment(TokenValue op);
+
+/// Collects the identifiers of every token from index start onwards
+void collect_identifiers(const std::vector<Token*>& tokens, int start, std::set<std::string>& ids);
+
+/// Number of times a for loop runs, if it's like for (int i = a; i < b; i += c) with number literals and
+/// the body never changes i. -1 if it can't be known at compile time.
+/// Bodies that define arrays also give -1, since they can't be copied.
+int constant_trip_count(ForToken* loop);
+
+/// Returns if a token's parse tree may assign to a variable, take its address, define another one with the
+/// same name or pass it to an inline function. Given the program's functions, an inline call only counts if
+/// the function may change the parameter it's passed as.
+/// asm that only loads or stores through the variable's address, like 4096((var)), doesn't change it.
+bool may_change(Token* token, const std::string& name, const std::map<std::string, FunctionToken*>* functions = nullptr);
+
+/// A for loop counter that's defined in the init, moves by a constant step and isn't changed by the body,
+/// and the arrays the body indexes with it (like a[i] or a[i + 2]) that it doesn't change
+struct InductionVariable{
+    std::string counter;
+    int step;
+    std::vector<std::string> arrays;
+    // the body only uses the counter to index those arrays
+    bool only_indexes;
+};
+
+/// The loop's induction variable. counter is empty if there's none or it doesn't index any arrays
+InductionVariable find_induction_variable(ForToken* loop);
+
+/// A for loop like for (int i = 0; i < n; i += 1) whose body is only dst[i] = src[i] or dst[i] = value,
+/// where n is a number or a variable, and neither n nor value is changed by the loop
+struct MemoryLoop{
+    std::string counter;
+    std::string dst;
+    // the array copied from, or empty when the loop fills dst with value
+    std::string src;
+    Token* value;
+    Token* count;
+};
+
+/// Returns if a for loop only copies one array into another or fills one, and what it does
+bool find_memory_loop(ForToken* loop, MemoryLoop* result);
+
+/// Number of values from start onwards in an array initializer that are the same number
+int same_value_run(const std::vector<Token*>& values, int start);
+
+#endif //I2C2_ASTANALYSIS_H
@@ -0,0 +1,104 @@
+#include "constantPool.h"
+#include "astAnalysis.h"
+#include "operationsCompiler.h"
+#include "strengthReduction.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+struct ConstantUses{
+    std::map<int32_t, int> uses;
+    int calls = 0;
+    int variables = 0;
+};
+
+// adds the constants in token that take more than one instruction to build, and its calls and variables.
+// each counts weight times, and more in loops
+void count_constants(Token* token, int weight, VariableTracker* varTracker, ConstantUses& result){
+    std::map<Token*, int> depth;
+    // multiplying or dividing by a constant turns it into shifts, or builds it on the spot
+    std::set<Token*> reduced;
+    for_each_token(token, [&](Token* t){
+        if (t->type == TYPE_OPERATOR){
+            TokenValue op = t->val_type;
+            if (op == MULT || op == MULT_EQ || op == DIV || op == DIV_EQ || op == MOD || op == MOD_EQ)
+                reduced.insert(((BinaryOpToken*) t)->right);
+            return;
+        }
+        if (t->type != TYPE_KEYWORD) return;
+        std::vector<Token*> inside;
+        if (t->val_type == FOR){
+            auto* loop = (ForToken*) t;
+            inside = {loop->condition, loop->increment, loop->body};
+        }
+        else if (t->val_type == WHILE){
+            auto* loop = (WhileToken*) t;
+            inside = {loop->condition, loop->body};
+        }
+        for (Token* part : inside){
+            for_each_token(part, [&](Token* c){ depth[c]++; });
+        }
+    });
+
+    for_each_token(token, [&](Token* t){
+        int w = weight;
+        for (int i = 0; i < depth[t] && i < 3; i++) w *= CONSTANT_LOOP_WEIGHT;
+
+        if (t->type == TYPE_VALUE && (t->val_type == NUMBER_INT || t->val_type == NUMBER_FLOAT) &&
+            reduced.find(t) == reduced.end()){
+            int32_t value = parse_number(t);
+            if (load_constant_cost(value) > 1) result.uses[value] += w;
+        }
+        if (t->type == TYPE_OPERATOR && t->val_type == IDENTIFIER) result.variables++;
+        if (t->type == TYPE_OPERATOR && t->val_type == FUNCTION){
+            auto* call = (FunctionCallToken*) t;
+            if (call->is_inline) count_constants(varTracker->get_inline_function(call->lexeme)->body, w, varTracker, result);
+            else result.calls += w;
+        }
+    });
+}
+
+void plan_constants(FunctionToken* function, VariableTracker* varTracker){
+    ConstantUses found;
+    count_constants(function->body, 1, varTracker, found);
+    if (found.uses.empty()) return;
+
+    int free_regs = 20 - found.variables - (int) function->parameters.size();
+    GlobalEffects effects;
+    if (varTracker->get_global_effects(function->name, &effects)) free_regs -= (int) effects.promoted.size();
+
+    // the constants used most get registers first
+    std::vector<std::pair<int32_t, int>> order(found.uses.begin(), found.uses.end());
+    std::stable_sort(order.begin(), order.end(), [](const std::pair<int32_t, int>& a, const std::pair<int32_t, int>& b){
+        return a.second > b.second;
+    });
+    for (const auto& [value, uses] : order){
+        int cost = load_constant_cost(value);
+        int build = uses * cost;
+        int keep = cost * (1 + found.calls);
+        // filling in the pool happens once, but counts against a function that may only run once too
+        int pool = uses * CONSTANT_POOL_LOAD_COST + cost + 1;
+        if (keep < build && keep <= pool && free_regs > CONSTANT_FREE_REGS){
+            varTracker->keep_constant(value);
+            free_regs--;
+        }
+        else if (pool < build) varTracker->pool_constant(value);
+    }
+}
+
+std::string compile_constant(int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    std::string varname = varTracker->add_temp_variable();
+    uint8_t reg = varTracker->getReg(varname);
+
+    std::string kept;
+    if (varTracker->get_kept_constant(value, &kept)){
+        mipsBuilder->addInstruction(new InstrAdd(reg, 0, varTracker->getReg(kept, false)), "");
+        return varname;
+    }
+    int address = varTracker->get_pool_address(value);
+    if (address >= 0) mipsBuilder->addInstruction(new InstrLw(reg, 0, (int16_t) address), "");
+    else load_constant(reg, value, mipsBuilder);
+    return varname;
+}
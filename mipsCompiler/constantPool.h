@@ -0,0 +1,35 @@
+#ifndef I2C2_CONSTANTPOOL_H
+#define I2C2_CONSTANTPOOL_H
+
+#include <cstdint>
+#include <string>
+
+#include "../parsing/tokenTypes.h"
+#include "MipsBuilder.h"
+#include "VariableTracker.h"
+
+// cycles a use of a pooled constant takes: the lw, and the stall before its value is ready
+#ifndef CONSTANT_POOL_LOAD_COST
+#define CONSTANT_POOL_LOAD_COST 2
+#endif
+
+// constants are only kept in registers while the function's variables leave this many of the 20 free
+#ifndef CONSTANT_FREE_REGS
+#define CONSTANT_FREE_REGS 8
+#endif
+
+// how many times more a use in a loop is counted, per loop around it
+#ifndef CONSTANT_LOOP_WEIGHT
+#define CONSTANT_LOOP_WEIGHT 8
+#endif
+
+/// Decides where each constant too big for an addi comes from in a function and the inline functions it calls:
+/// built at every use, built once on entry and kept in a register, or loaded with one lw from a pool in memory
+/// that the program fills in when it starts. Uses are weighted by the loops around them, and a kept constant is
+/// built again after every call. To use on entry, after the function's globals are promoted.
+void plan_constants(FunctionToken* function, VariableTracker* varTracker);
+
+/// Compiles a number into a new temporary variable, from wherever plan_constants put it
+std::string compile_constant(int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
+#endif //I2C2_CONSTANTPOOL_H
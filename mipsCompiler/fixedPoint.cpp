@@ -0,0 +1,69 @@
+#include "fixedPoint.h"
+
+#include <string>
+
+void emit_fixed_div(uint8_t rd, uint8_t ra, uint8_t rb, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    std::string num = varTracker->add_temp_variable();
+    std::string den = varTracker->add_temp_variable();
+    std::string scale = varTracker->add_temp_variable();
+    std::string recip = varTracker->add_temp_variable();
+    std::string err = varTracker->add_temp_variable();
+    uint8_t n = varTracker->getReg(num);
+    uint8_t d = varTracker->getReg(den);
+    uint8_t s = varTracker->getReg(scale);
+    uint8_t r = varTracker->getReg(recip);
+    uint8_t e = varTracker->getReg(err);
+
+    // the divisor has to be positive, so a negative one flips both signs
+    std::string positive = mipsBuilder->genUnnamedLabel();
+    std::string negative = mipsBuilder->genUnnamedLabel();
+    mipsBuilder->addInstruction(new InstrAdd(n, ra, 0), "");
+    mipsBuilder->addInstruction(new InstrAdd(d, rb, 0), "");
+    mipsBuilder->addInstruction(new InstrBlt(0, d, positive), "");
+    mipsBuilder->addInstruction(new InstrBne(d, 0, negative), "");
+    mipsBuilder->addInstruction(new InstrAddi(d, 0, 1), "");
+    mipsBuilder->addInstruction(new InstrJ(positive), "");
+    mipsBuilder->addInstruction(new InstrSub(n, 0, n), negative);
+    mipsBuilder->addInstruction(new InstrSub(d, 0, d), "");
+
+    // halve or double d until it's in [0.5, 1). scale goes the same way from 1.0, and ends up as 1 / (rb / d)
+    std::string shrink = mipsBuilder->genUnnamedLabel();
+    std::string shrink_test = mipsBuilder->genUnnamedLabel();
+    std::string grow = mipsBuilder->genUnnamedLabel();
+    std::string grow_test = mipsBuilder->genUnnamedLabel();
+    mipsBuilder->addInstruction(new InstrAddi(s, 0, 1), positive);
+    mipsBuilder->addInstruction(new InstrSll(s, s, 16), "");
+    mipsBuilder->addInstruction(new InstrAddi(1, 0, 65535), "");
+    mipsBuilder->addInstruction(new InstrJ(shrink_test), "");
+    mipsBuilder->addInstruction(new InstrSra(d, d, 1), shrink);
+    mipsBuilder->addInstruction(new InstrSra(s, s, 1), "");
+    mipsBuilder->addInstruction(new InstrBlt(1, d, shrink), shrink_test);
+    mipsBuilder->addInstruction(new InstrAddi(1, 0, 32768), "");
+    mipsBuilder->addInstruction(new InstrJ(grow_test), "");
+    mipsBuilder->addInstruction(new InstrSll(d, d, 1), grow);
+    mipsBuilder->addInstruction(new InstrSll(s, s, 1), "");
+    mipsBuilder->addInstruction(new InstrBlt(d, 1, grow), grow_test);
+
+    // 3 - 2d is within 1/8 of 1/d on [0.5, 1). $1 holds 2.0 from here on
+    mipsBuilder->addInstruction(new InstrAddi(1, 0, 2), "");
+    mipsBuilder->addInstruction(new InstrSll(1, 1, 16), "");
+    mipsBuilder->addInstruction(new InstrSub(r, 1, d), "");
+    mipsBuilder->addInstruction(new InstrSub(r, r, d), "");
+    mipsBuilder->addInstruction(new InstrSra(e, 1, 1), "");
+    mipsBuilder->addInstruction(new InstrAdd(r, r, e), "");
+    // r = r * (2 - d * r)
+    for (int i = 0; i < FIXED_DIV_STEPS; i++){
+        mipsBuilder->addInstruction(new InstrHMul(e, d, r), "");
+        mipsBuilder->addInstruction(new InstrSub(e, 1, e), "");
+        mipsBuilder->addInstruction(new InstrHMul(r, r, e), "");
+    }
+
+    mipsBuilder->addInstruction(new InstrHMul(rd, n, r), "");
+    mipsBuilder->addInstruction(new InstrHMul(rd, rd, s), "");
+
+    varTracker->removeVar(num);
+    varTracker->removeVar(den);
+    varTracker->removeVar(scale);
+    varTracker->removeVar(recip);
+    varTracker->removeVar(err);
+}
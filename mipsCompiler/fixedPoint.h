@@ -0,0 +1,20 @@
+#ifndef I2C2_FIXEDPOINT_H
+#define I2C2_FIXEDPOINT_H
+
+#include <cstdint>
+
+#include "MipsBuilder.h"
+#include "VariableTracker.h"
+
+// newton-raphson steps after the first guess at a reciprocal. each one squares the error, from 1/8 at the start
+#ifndef FIXED_DIV_STEPS
+#define FIXED_DIV_STEPS 3
+#endif
+
+/// rd = ra / rb for 16.16 fixed point values, without a div. rb is scaled into [0.5, 1), where newton-raphson
+/// finds its reciprocal with hmuls, and the quotient is ra times that, scaled back.
+/// Good to about 2^-15 of the result, for |ra| below 16384. rb = 0 divides by the smallest fixed point value instead.
+/// rd can be ra or rb. Uses $1.
+void emit_fixed_div(uint8_t rd, uint8_t ra, uint8_t rb, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
+#endif //I2C2_FIXEDPOINT_H
@@ -0,0 +1,147 @@
+#include "globalPromotion.h"
+#include "astAnalysis.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+// what a function's body does itself, along with the bodies of the inline functions it calls
+struct BodyGlobals{
+    std::set<std::string> used;
+    std::set<std::string> changed;
+    std::map<std::string, int> uses;
+    std::set<std::string> calls;
+    // asm or a function with no body, which could do anything
+    bool unknown = false;
+};
+
+void add_body_globals(FunctionToken* function, const std::set<std::string>& globals,
+                      std::map<std::string, FunctionToken*>& functions, std::set<std::string>& seen, BodyGlobals& result){
+    if (!seen.insert(function->name).second) return;
+    if (function->body == nullptr){
+        result.unknown = true;
+        return;
+    }
+
+    std::set<std::string> locals;
+    for (DefinitionToken* param : function->parameters) locals.insert(param->name);
+    std::vector<FunctionToken*> inline_calls;
+    for_each_token(function->body, [&](Token* t){
+        if (t->type == TYPE_OPERATOR && t->val_type == IDENTIFIER) locals.insert(((DefinitionToken*) t)->name);
+        if (t->type == TYPE_KEYWORD && t->val_type == ASM) result.unknown = true;
+        if (t->type == TYPE_OPERATOR && t->val_type == FUNCTION){
+            auto* call = (FunctionCallToken*) t;
+            if (!call->is_inline) result.calls.insert(call->lexeme);
+            else if (functions.find(call->lexeme) == functions.end()) result.unknown = true;
+            else inline_calls.push_back(functions[call->lexeme]);
+        }
+    });
+
+    std::set<std::string> ids;
+    collect_identifiers(function->body, ids);
+    for (const std::string& id : ids){
+        if (globals.find(id) == globals.end() || locals.find(id) != locals.end()) continue;
+        result.used.insert(id);
+        if (may_change(function->body, id)) result.changed.insert(id);
+    }
+    // only reads count. a global that's only assigned to gets a register at the first assignment, with no load
+    std::set<Token*> assigned;
+    for_each_token(function->body, [&](Token* t){
+        if (t->type == TYPE_OPERATOR && t->val_type == EQ) assigned.insert(((BinaryOpToken*) t)->left);
+        if (t->type == TYPE_IDENTIFIER && assigned.find(t) == assigned.end() && result.used.find(t->lexeme) != result.used.end())
+            result.uses[t->lexeme]++;
+    });
+
+    for (FunctionToken* callee : inline_calls) add_body_globals(callee, globals, functions, seen, result);
+}
+
+ProgramGlobals analyze_globals(const std::vector<Token*>& ast){
+    ProgramGlobals program;
+    std::map<std::string, FunctionToken*> functions;
+    std::set<std::string>& globals = program.globals;
+    std::set<std::string>& escaped = program.escaped;
+
+    auto find_escapes = [&](Token* token){
+        for_each_token(token, [&](Token* t){
+            if ((t->type == TYPE_OPERATOR && t->val_type == REF) || (t->type == TYPE_KEYWORD && t->val_type == ASM))
+                collect_identifiers(t, escaped);
+        });
+    };
+    for (Token* token : ast){
+        if (token->type == TYPE_KEYWORD && token->val_type == FUNCTION){
+            auto* function = (FunctionToken*) token;
+            functions[function->name] = function;
+            if (function->body != nullptr) find_escapes(function->body);
+            continue;
+        }
+        find_escapes(token);
+        for_each_token(token, [&](Token* t){
+            if (t->type == TYPE_OPERATOR && t->val_type == IDENTIFIER && ((DefinitionToken*) t)->dimensions.empty())
+                globals.insert(((DefinitionToken*) t)->name);
+        });
+    }
+
+    std::map<std::string, BodyGlobals> bodies;
+    std::map<std::string, GlobalEffects> effects;
+    std::set<std::string> unknown;
+    for (auto& [name, function] : functions){
+        std::set<std::string> seen;
+        add_body_globals(function, globals, functions, seen, bodies[name]);
+        program.changed_here[name] = bodies[name].changed;
+        if (bodies[name].unknown) unknown.insert(name);
+        effects[name].used = bodies[name].used;
+        effects[name].changed = bodies[name].changed;
+    }
+
+    // anything a callee can do, its callers can too. recursion goes around until nothing new turns up
+    bool grew = true;
+    while (grew){
+        grew = false;
+        for (auto& [name, body] : bodies){
+            if (unknown.find(name) != unknown.end()) continue;
+            for (const std::string& callee : body.calls){
+                // the runtime only touches the heap
+                if (functions.find(callee) == functions.end() && is_runtime_function(callee)) continue;
+                if (functions.find(callee) == functions.end() || unknown.find(callee) != unknown.end()){
+                    unknown.insert(name);
+                    grew = true;
+                    break;
+                }
+                size_t before = effects[name].used.size() + effects[name].changed.size();
+                effects[name].used.insert(effects[callee].used.begin(), effects[callee].used.end());
+                effects[name].changed.insert(effects[callee].changed.begin(), effects[callee].changed.end());
+                if (effects[name].used.size() + effects[name].changed.size() != before) grew = true;
+            }
+        }
+    }
+
+    for (auto& [name, body] : bodies){
+        for (const std::string& callee : body.calls){
+            if (functions.find(callee) == functions.end() && is_runtime_function(callee))
+                program.effects[callee] = GlobalEffects();
+        }
+    }
+    for (auto& [name, body] : bodies){
+        if (unknown.find(name) != unknown.end()) continue;
+        GlobalEffects& result = effects[name];
+        result.changed_here = body.changed;
+        for (const std::string& global : body.used){
+            if (escaped.find(global) == escaped.end() && body.uses[global] > 0) result.promoted.push_back(global);
+        }
+        std::stable_sort(result.promoted.begin(), result.promoted.end(), [&](const std::string& a, const std::string& b){
+            return body.uses[a] > body.uses[b];
+        });
+        if (result.promoted.size() > GLOBAL_PROMOTE_MAX) result.promoted.resize(GLOBAL_PROMOTE_MAX);
+        program.effects[name] = result;
+    }
+    return program;
+}
+
+void find_global_effects(const std::vector<Token*>& ast, VariableTracker* varTracker){
+    for (Token* token : ast){
+        if (token->type == TYPE_KEYWORD && token->val_type == FUNCTION && ((FunctionToken*) token)->body != nullptr)
+            varTracker->add_program_function(((FunctionToken*) token)->name);
+    }
+    for (const auto& [name, effects] : analyze_globals(ast).effects) varTracker->set_global_effects(name, effects);
+}
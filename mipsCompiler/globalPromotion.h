@@ -0,0 +1,39 @@
+#ifndef I2C2_GLOBALPROMOTION_H
+#define I2C2_GLOBALPROMOTION_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../parsing/tokenTypes.h"
+#include "VariableTracker.h"
+
+// at most this many globals are kept in registers through a function, the ones it uses most
+#ifndef GLOBAL_PROMOTE_MAX
+#define GLOBAL_PROMOTE_MAX 8
+#endif
+
+/// The program's scalar globals and what each function does to them
+struct ProgramGlobals{
+    std::set<std::string> globals;
+    // reached without their name, because their address is taken or asm names them
+    std::set<std::string> escaped;
+    // what find_global_effects gives the tracker. functions that can do anything aren't in it
+    std::map<std::string, GlobalEffects> effects;
+    // the globals each function's own body and inline calls may assign to, including the ones that can do anything
+    std::map<std::string, std::set<std::string>> changed_here;
+};
+
+/// The analysis find_global_effects registers with the tracker, for the ast as it is now
+ProgramGlobals analyze_globals(const std::vector<Token*>& ast);
+
+/// Works out which globals each function uses and changes, following its calls through the call graph, and registers
+/// it with the tracker. A function's own scalar globals are promoted: loaded once on entry and kept in registers until it
+/// returns, unless their address is taken or asm names them. Functions that run asm, or that can reach one that does or
+/// has no body, get nothing, and calls to them are treated as using and changing every global.
+/// The tracker is also told which functions have a body, so a builtin never stands in for one the program defines.
+/// Runs on the output of sort_ast, after auto_inline.
+void find_global_effects(const std::vector<Token*>& ast, VariableTracker* varTracker);
+
+#endif //I2C2_GLOBALPROMOTION_H
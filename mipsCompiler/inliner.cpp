@@ -0,0 +1,265 @@
+#include "inliner.h"
+#include "astAnalysis.h"
+#include "MipsCompiler.h"
+#include "globalPromotion.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+struct CallSite{
+    FunctionCallToken* call;
+    FunctionToken* caller;  // nullptr outside functions
+    int loop_depth;
+};
+
+bool is_call(Token* token){
+    return token->type == TYPE_OPERATOR && token->val_type == FUNCTION;
+}
+
+// adds the calls in token to sites, with how many loops in token are around them
+void find_call_sites(Token* token, FunctionToken* caller, std::vector<CallSite>& sites){
+    std::map<Token*, int> depth;
+    for_each_token(token, [&](Token* t){
+        if (t->type != TYPE_KEYWORD) return;
+        std::vector<Token*> inside;
+        if (t->val_type == FOR){
+            auto* loop = (ForToken*) t;
+            inside = {loop->condition, loop->increment, loop->body};
+        }
+        else if (t->val_type == WHILE){
+            auto* loop = (WhileToken*) t;
+            inside = {loop->condition, loop->body};
+        }
+        for (Token* part : inside){
+            for_each_token(part, [&](Token* c){ if (is_call(c)) depth[c]++; });
+        }
+    });
+    for_each_token(token, [&](Token* t){
+        if (is_call(t)) sites.push_back({(FunctionCallToken*) t, caller, depth[t]});
+    });
+}
+
+// names defined in a token's parse tree, and the parameters if it's a function
+std::set<std::string> local_names(FunctionToken* function){
+    std::set<std::string> names;
+    for (DefinitionToken* param : function->parameters) names.insert(param->name);
+    for_each_token(function->body, [&](Token* t){
+        if (t->type == TYPE_OPERATOR && t->val_type == IDENTIFIER) names.insert(((DefinitionToken*) t)->name);
+    });
+    return names;
+}
+
+bool reaches(const std::string& from, const std::string& to, std::map<std::string, std::set<std::string>>& calls,
+             std::set<std::string>& seen){
+    if (!seen.insert(from).second) return false;
+    for (const std::string& callee : calls[from]){
+        if (callee == to || reaches(callee, to, calls, seen)) return true;
+    }
+    return false;
+}
+
+// why a function can never be inlined, or empty if it can be
+std::string cannot_inline(FunctionToken* function, const std::map<std::string, FunctionToken*>& functions,
+                          std::map<std::string, std::set<std::string>>& calls){
+    if (function->body == nullptr) return "no body";
+    if (function->name == "main") return "main";
+    std::set<std::string> seen;
+    if (reaches(function->name, function->name, calls, seen)) return "recursive";
+
+    std::string reason;
+    for_each_token(function->body, [&](Token* t){
+        if (!reason.empty()) return;
+        // asm may use any register, or define labels that can't be copied
+        if (t->type == TYPE_KEYWORD && t->val_type == ASM) reason = "hand written asm";
+        // the copy would move the stack pointer without moving it back
+        if (t->type == TYPE_OPERATOR && t->val_type == IDENTIFIER && !((DefinitionToken*) t)->dimensions.empty())
+            reason = "defines an array";
+        if (t->type == TYPE_OPERATOR && t->val_type == REF) reason = "takes an address";
+    });
+    if (!reason.empty()) return reason;
+
+    // inlined parameters are other names for the arguments, so they can't be assigned to
+    for (DefinitionToken* param : function->parameters){
+        if (may_change(function->body, param->name, &functions)) return "assigns to " + param->name;
+    }
+    return "";
+}
+
+// why an inlined copy of callee can't change the globals it does at this call, or empty if it can. the copy only
+// changes the registers a function keeps its globals in, so in a function, every global the copies inlined into it
+// change has to stay promoted. outside functions, globals that a pointer or asm can reach are left to calls
+std::string changes_unkept_global(std::vector<Token*>& ast, const CallSite& site, FunctionToken* callee,
+                                  std::set<std::string>& changed, const std::set<std::string>& inlined_changes){
+    ProgramGlobals program = analyze_globals(ast);
+    changed = program.changed_here[callee->name];
+    for (const std::string& global : changed){
+        if (program.escaped.find(global) != program.escaped.end()) return "changes " + global + ", which a pointer can reach";
+    }
+    if (site.caller == nullptr || changed.empty()) return "";
+
+    site.call->is_inline = true;
+    ProgramGlobals after = analyze_globals(ast);
+    site.call->is_inline = false;
+    const std::string& caller = site.caller->name;
+    std::set<std::string> promoted;
+    if (after.effects.find(caller) != after.effects.end())
+        promoted.insert(after.effects[caller].promoted.begin(), after.effects[caller].promoted.end());
+    for (const std::string& global : changed){
+        if (promoted.find(global) == promoted.end()) return "changes " + global + ", which " + caller + " wouldn't keep in a register";
+    }
+    for (const std::string& global : inlined_changes){
+        if (promoted.find(global) == promoted.end()) return "would push " + global + " out of " + caller + "'s registers";
+    }
+    return "";
+}
+
+bool calls_inline(FunctionToken* function){
+    bool found = false;
+    for_each_token(function->body, [&](Token* t){
+        if (is_call(t) && ((FunctionCallToken*) t)->is_inline) found = true;
+    });
+    return found;
+}
+
+std::vector<InlineDecision> auto_inline(std::vector<Token*>& ast, VariableTracker* varTracker){
+    std::map<std::string, FunctionToken*> functions;
+    std::vector<CallSite> sites;
+    std::vector<Token*> top_level;
+    std::string asm_code;
+
+    for (Token* token : ast){
+        if (token->type == TYPE_KEYWORD && token->val_type == FUNCTION){
+            auto* function = (FunctionToken*) token;
+            functions[function->name] = function;
+            if (function->is_inline) varTracker->add_inline_function(function->name, function);
+        }
+        else top_level.push_back(token);
+    }
+
+    std::map<std::string, std::set<std::string>> calls;
+    for (auto& [name, function] : functions){
+        if (function->body == nullptr) continue;
+        find_call_sites(function->body, function, sites);
+        for_each_token(function->body, [&](Token* t){
+            if (is_call(t)) calls[name].insert(t->lexeme);
+            if (t->type == TYPE_KEYWORD && t->val_type == ASM) asm_code += ((AsmToken*) t)->asmCode;
+        });
+    }
+    for (Token* token : top_level){
+        find_call_sites(token, nullptr, sites);
+        for_each_token(token, [&](Token* t){
+            if (t->type == TYPE_KEYWORD && t->val_type == ASM) asm_code += ((AsmToken*) t)->asmCode;
+        });
+    }
+    int program_size = estimate_program_size(ast, varTracker);
+
+    // calls already inline aren't up to the inliner. calls from inline functions would be copied along with them
+    std::vector<CallSite> considered;
+    std::map<std::string, int> call_count;
+    for (const CallSite& site : sites){
+        if (site.call->is_inline || functions.find(site.call->lexeme) == functions.end()) continue;
+        if (site.caller != nullptr && site.caller->is_inline) continue;
+        considered.push_back(site);
+        call_count[site.call->lexeme]++;
+    }
+
+    std::map<std::string, int> sizes;
+    for (const auto& [name, count] : call_count){
+        if (functions[name]->body != nullptr) sizes[name] = estimate_size(functions[name]->body, varTracker);
+    }
+
+    // the calls run most often get the imem first, then the smallest functions
+    std::vector<int> order;
+    for (int i = 0; i < considered.size(); i++) order.push_back(i);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b){
+        if (considered[a].loop_depth != considered[b].loop_depth) return considered[a].loop_depth > considered[b].loop_depth;
+        return sizes[considered[a].call->lexeme] < sizes[considered[b].call->lexeme];
+    });
+
+    std::vector<InlineDecision> decisions(considered.size());
+    // inline code is compiled a scope deeper than where it's called, and the tracker only goes two deep,
+    // so functions with calls inlined into them aren't inlined anywhere, and the other way around
+    std::set<std::string> with_inlined_calls;
+    std::map<std::string, int> inlined_calls;
+    // the globals changed by the copies inlined into each function
+    std::map<std::string, std::set<std::string>> inlined_changes;
+    int growth = 0;
+    for (int i : order){
+        const CallSite& site = considered[i];
+        FunctionToken* callee = functions[site.call->lexeme];
+        std::string caller = site.caller == nullptr ? "" : site.caller->name;
+        int size = sizes[callee->name];
+        InlineDecision& decision = decisions[i];
+        decision = {caller, callee->name, site.call->line, site.loop_depth, size, false, ""};
+
+        decision.reason = cannot_inline(callee, functions, calls);
+        if (!decision.reason.empty()) continue;
+        if (with_inlined_calls.find(callee->name) != with_inlined_calls.end() ||
+            (site.caller != nullptr && calls_inline(callee))){
+            decision.reason = "has calls inlined into it";
+            continue;
+        }
+        if (inlined_calls.find(caller) != inlined_calls.end()){
+            decision.reason = "caller is inlined";
+            continue;
+        }
+
+        // an argument the body changes through its own name would change the parameter too
+        for (Token* arg : site.call->arguments){
+            if (arg->type == TYPE_IDENTIFIER && may_change(callee->body, arg->lexeme, &functions))
+                decision.reason = "changes " + arg->lexeme + ", which is passed to it";
+        }
+        if (site.caller != nullptr){
+            // the copied body would find the caller's variables before the globals it means
+            std::set<std::string> used;
+            collect_identifiers(callee->body, used);
+            std::set<std::string> own = local_names(callee);
+            std::set<std::string> caller_names = local_names(site.caller);
+            for (const std::string& name : used){
+                if (own.find(name) == own.end() && caller_names.find(name) != caller_names.end()) decision.reason = "uses " + name + " from the caller";
+            }
+        }
+        if (!decision.reason.empty()) continue;
+
+        int count = call_count[callee->name];
+        if (size > INLINE_MAX_SIZE){
+            decision.reason = "too big";
+            continue;
+        }
+        if (size <= INLINE_CALL_COST) decision.reason = "no bigger than a call";
+        else if (count == 1) decision.reason = "only call";
+        else if (site.loop_depth > 0 && size <= INLINE_CALL_COST + INLINE_LOOP_BONUS * site.loop_depth) decision.reason = "in a loop";
+        else {
+            decision.reason = "too big for " + std::to_string(count) + " calls";
+            continue;
+        }
+
+        // the only call moves the function's body instead of copying it
+        int extra = count == 1 ? -INLINE_CALL_COST : size - INLINE_CALL_COST;
+        if (program_size + growth + extra > INLINE_IMEM_BUDGET){
+            decision.reason = "out of imem";
+            continue;
+        }
+        std::set<std::string> changed;
+        std::string unkept = changes_unkept_global(ast, site, callee, changed, inlined_changes[caller]);
+        if (!unkept.empty()){
+            decision.reason = unkept;
+            continue;
+        }
+        growth += extra;
+        decision.inlined = true;
+        site.call->is_inline = true;
+        inlined_calls[callee->name]++;
+        if (site.caller != nullptr) with_inlined_calls.insert(caller);
+        inlined_changes[caller].insert(changed.begin(), changed.end());
+    }
+
+    for (const auto& [name, count] : inlined_calls){
+        FunctionToken* function = functions[name];
+        varTracker->add_inline_function(name, function);
+        // asm could still jal to it
+        if (count == call_count[name] && asm_code.find(name) == std::string::npos) function->is_inline = true;
+    }
+    return decisions;
+}
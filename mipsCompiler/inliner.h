@@ -0,0 +1,47 @@
+#ifndef I2C2_INLINER_H
+#define I2C2_INLINER_H
+
+#include <string>
+#include <vector>
+
+#include "../parsing/tokenTypes.h"
+#include "VariableTracker.h"
+
+// instructions a call takes besides the function's body: the jal and jr, moving arguments and saving $31
+#ifndef INLINE_CALL_COST
+#define INLINE_CALL_COST 6
+#endif
+
+// functions bigger than this are never inlined. calls in loops are inlined for up to INLINE_LOOP_BONUS more
+// instructions than the call would take per level of loops around them
+#ifndef INLINE_MAX_SIZE
+#define INLINE_MAX_SIZE 48
+#endif
+
+#ifndef INLINE_LOOP_BONUS
+#define INLINE_LOOP_BONUS 12
+#endif
+
+// inlining stops once the program would grow past this much of the 4096 word imem
+#ifndef INLINE_IMEM_BUDGET
+#define INLINE_IMEM_BUDGET 2048
+#endif
+
+/// What the inliner did with one call
+struct InlineDecision{
+    std::string caller;     // empty for calls outside functions
+    std::string callee;
+    int line;
+    int loop_depth;
+    int size;
+    bool inlined;
+    std::string reason;
+};
+
+/// Marks calls to small functions to be compiled inline, weighing the function's size against how many calls there are,
+/// how many loops they are in and how much imem is left. Functions with every call inlined aren't compiled on their own.
+/// Runs on the output of sort_ast, and registers the functions with inlined calls with the tracker.
+/// Returns a decision for every call to a function that isn't already inline, in the order they appear.
+std::vector<InlineDecision> auto_inline(std::vector<Token*>& ast, VariableTracker* varTracker);
+
+#endif //I2C2_INLINER_H
@@ -0,0 +1,211 @@
+#include "memoryBudget.h"
+#include "astAnalysis.h"
+#include "MipsCompiler.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+
+struct CallGraph{
+    std::map<std::string, FunctionToken*> functions;
+    std::map<std::string, FunctionToken*> inline_functions;
+    // the functions with a body that each one may call
+    std::map<std::string, std::set<std::string>> calls;
+    // from #pragma max_recursion
+    std::map<std::string, int> max_recursion;
+};
+
+// calls to functions the program defines. an inline function's calls are made from wherever it's compiled into.
+// extra_args is the most arguments past the fourth a call passes, which go on the stack outside of any frame.
+// jumps are calls that reuse the frame of the function they're in, which aren't counted
+void collect_calls(Token* body, CallGraph& graph, std::set<std::string>& inlined, std::set<std::string>& result,
+                   int* extra_args, const std::set<Token*>& jumps = {}){
+    for_each_token(body, [&](Token* t){
+        if (t->type != TYPE_OPERATOR || t->val_type != FUNCTION || jumps.find(t) != jumps.end()) return;
+        auto* call = (FunctionCallToken*) t;
+        if (call->is_inline){
+            auto it = graph.inline_functions.find(call->lexeme);
+            if (it != graph.inline_functions.end() && inlined.insert(call->lexeme).second)
+                collect_calls(it->second->body, graph, inlined, result, extra_args, jumps);
+            return;
+        }
+        *extra_args = std::max(*extra_args, (int) call->arguments.size() - 4);
+        if (graph.functions.find(call->lexeme) != graph.functions.end()) result.insert(call->lexeme);
+    });
+}
+
+void read_pragma(Token* pragma, CallGraph& graph){
+    std::istringstream words(pragma->lexeme);
+    std::string kind;
+    words >> kind;
+    // like other compilers, pragmas meant for something else are left alone
+    if (kind != "max_recursion") return;
+
+    std::string function;
+    int times = 0;
+    std::string rest;
+    if (!(words >> function >> times) || times < 1 || (words >> rest))
+        throw std::runtime_error("Expected #pragma max_recursion <function> <times> at line " + std::to_string(pragma->line));
+    graph.max_recursion[function] = times;
+}
+
+struct Components{
+    std::map<std::string, int> index;
+    std::map<std::string, int> low;
+    std::vector<std::string> stack;
+    std::set<std::string> on_stack;
+    // strongly connected components of the call graph, each one after every component it calls
+    std::vector<std::vector<std::string>> found;
+};
+
+void strong_connect(const std::string& function, CallGraph& graph, Components& c){
+    c.index[function] = c.low[function] = (int) c.index.size();
+    c.stack.push_back(function);
+    c.on_stack.insert(function);
+    for (const std::string& callee : graph.calls[function]){
+        if (c.index.find(callee) == c.index.end()){
+            strong_connect(callee, graph, c);
+            c.low[function] = std::min(c.low[function], c.low[callee]);
+        }
+        else if (c.on_stack.find(callee) != c.on_stack.end()){
+            c.low[function] = std::min(c.low[function], c.index[callee]);
+        }
+    }
+    if (c.low[function] != c.index[function]) return;
+
+    std::vector<std::string> component;
+    std::string member;
+    do {
+        member = c.stack.back();
+        c.stack.pop_back();
+        c.on_stack.erase(member);
+        component.push_back(member);
+    } while (member != function);
+    c.found.push_back(component);
+}
+
+std::string show_chain(const std::vector<std::string>& chain){
+    std::string result;
+    for (const std::string& name : chain) result += (result.empty() ? "" : " > ") + name;
+    return result;
+}
+
+MemoryBudget analyze_memory_budget(const std::vector<Token*>& ast, VariableTracker* varTracker){
+    MemoryBudget budget;
+    CallGraph graph;
+    for (Token* token : ast){
+        if (token->type == TYPE_KEYWORD && token->val_type == PRAGMA) read_pragma(token, graph);
+        if (token->type != TYPE_KEYWORD || token->val_type != FUNCTION) continue;
+        auto* function = (FunctionToken*) token;
+        if (function->body == nullptr) continue;
+        if (function->is_inline) graph.inline_functions[function->name] = function;
+        else graph.functions[function->name] = function;
+    }
+
+    for (const auto& [name, function] : graph.functions){
+        // a call to itself that's returned is a jump back to the start, so the function never runs twice at once
+        std::set<Token*> jumps;
+        for_each_token(function->body, [&](Token* t){
+            if (t->type != TYPE_KEYWORD || t->val_type != RETURN || !returns_by_jump(function, (ReturnToken*) t)) return;
+            Token* value = ((ReturnToken*) t)->value;
+            if (value->lexeme == name) jumps.insert(value);
+        });
+        std::set<std::string> inlined;
+        int extra_args = 0;
+        collect_calls(function->body, graph, inlined, graph.calls[name], &extra_args, jumps);
+        for_each_token(function->body, [&](Token* t){
+            if (t->type == TYPE_KEYWORD && t->val_type == ASM && ((AsmToken*) t)->asmCode.find("jal") != std::string::npos)
+                budget.warnings.push_back("asm in " + name + " makes calls the stack depth doesn't count");
+        });
+    }
+    for (const auto& [name, times] : graph.max_recursion){
+        if (graph.functions.find(name) == graph.functions.end())
+            budget.warnings.push_back("#pragma max_recursion names " + name + ", which isn't a function");
+    }
+
+    Components components;
+    for (const auto& [name, function] : graph.functions){
+        if (components.index.find(name) == components.index.end()) strong_connect(name, graph, components);
+    }
+
+    std::map<std::string, int> depth;
+    std::map<std::string, std::vector<std::string>> deepest;
+    for (const std::vector<std::string>& component : components.found){
+        std::set<std::string> members(component.begin(), component.end());
+        const std::string& first = component.front();
+        bool recursive = component.size() > 1 || graph.calls[first].count(first) > 0;
+
+        // each function in a cycle may be running as many times at once as the cycle goes around
+        int times = 1;
+        if (recursive){
+            times = 0;
+            for (const std::string& member : component){
+                if (graph.max_recursion.find(member) != graph.max_recursion.end())
+                    times = std::max(times, graph.max_recursion[member]);
+            }
+            if (times == 0){
+                std::string names;
+                for (const std::string& member : component) names += (names.empty() ? "" : ", ") + member;
+                budget.warnings.push_back("recursion through " + names + " has no #pragma max_recursion, so the stack "
+                                          "depth only counts it once");
+                times = 1;
+            }
+        }
+
+        int frames = 0;
+        for (const std::string& member : component) frames += varTracker->get_function_frame(member);
+
+        // the deepest call out of the cycle, from whichever function in it makes it
+        int below = 0;
+        std::string caller;
+        std::string callee;
+        for (const std::string& member : component){
+            for (const std::string& c : graph.calls[member]){
+                if (members.find(c) != members.end() || depth[c] < below || (!callee.empty() && depth[c] == below)) continue;
+                below = depth[c];
+                caller = member;
+                callee = c;
+            }
+        }
+
+        for (const std::string& member : component){
+            depth[member] = times * frames + below;
+            std::vector<std::string> chain = {recursive ? member + " x" + std::to_string(times) : member};
+            if (!callee.empty()){
+                if (caller != member) chain.push_back(caller);
+                chain.insert(chain.end(), deepest[callee].begin(), deepest[callee].end());
+            }
+            deepest[member] = chain;
+        }
+    }
+
+    for (Token* token : ast){
+        if (token->type == TYPE_KEYWORD && token->val_type == FUNCTION){
+            auto* function = (FunctionToken*) token;
+            if (graph.functions.find(function->name) == graph.functions.end() || function->is_inline) continue;
+            budget.functions.push_back({function->name, varTracker->get_function_frame(function->name),
+                                        depth[function->name], deepest[function->name]});
+        }
+    }
+
+    // the top level has no frame, but a call with more than four arguments still pushes the rest
+    budget.stack = 0;
+    int extra_args = 0;
+    for (Token* token : ast){
+        if (token->type == TYPE_KEYWORD && token->val_type == FUNCTION) continue;
+        std::set<std::string> inlined;
+        std::set<std::string> roots;
+        collect_calls(token, graph, inlined, roots, &extra_args);
+        for (const std::string& root : roots){
+            if (depth[root] <= budget.stack && !budget.deepest.empty()) continue;
+            budget.stack = depth[root];
+            budget.deepest = deepest[root];
+        }
+    }
+    budget.stack += extra_args;
+
+    budget.globals = varTracker->get_mem_offset();
+    budget.free_words = DMEM_WORDS - 1 - budget.globals - budget.stack;
+    return budget;
+}
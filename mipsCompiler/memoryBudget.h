@@ -0,0 +1,57 @@
+#ifndef I2C2_MEMORYBUDGET_H
+#define I2C2_MEMORYBUDGET_H
+
+#include <string>
+#include <vector>
+
+#include "../parsing/tokenTypes.h"
+#include "VariableTracker.h"
+
+// words of dmem. $29 starts at the last one and the stack grows down towards the globals and the heap
+#ifndef DMEM_WORDS
+#define DMEM_WORDS 2048
+#endif
+
+struct FunctionStack{
+    std::string name;
+    // words the function's own frame takes
+    int frame;
+    // most words of stack in use from when it's called until it returns
+    int depth;
+    // the chain of calls that reaches that depth, starting with itself
+    std::vector<std::string> deepest;
+};
+
+struct MemoryBudget{
+    std::vector<FunctionStack> functions;
+    // most words of stack the program can use, and the calls from the top level that get there
+    int stack;
+    std::vector<std::string> deepest;
+    // words from the bottom of dmem taken by globals, the constant pool, jump tables and the runtime
+    int globals;
+    // words between the globals and the deepest the stack goes, which is what the heap gets.
+    // negative if the stack can run into the globals
+    int free_words;
+    std::vector<std::string> warnings;
+};
+
+/*
+ Works out the most stack the program can use from the frame each function was given and the calls it can make.
+ Calls through inline functions count as calls from the function they're compiled into, and every call counts,
+ even ones that end up as a jump at the end of the function.
+
+ A function that can call itself, through others or not, needs to say how deep that goes:
+
+     #pragma max_recursion fib 12
+
+ means fib is never running more than 12 times at once. Each function it calls back through is counted that many times
+ too. Recursion without a bound is counted once, with a warning.
+ */
+
+/// Checks how much of dmem the program can use. To use after the program and the runtime are compiled
+MemoryBudget analyze_memory_budget(const std::vector<Token*>& ast, VariableTracker* varTracker);
+
+/// A chain of calls as "main > fib x12 > helper"
+std::string show_chain(const std::vector<std::string>& chain);
+
+#endif //I2C2_MEMORYBUDGET_H
@@ -4,6 +4,14 @@
 
 #include "operationsCompiler.h"
 #include "MipsCompiler.h"
+#include "strengthReduction.h"
+#include "fixedPoint.h"
+#include "astAnalysis.h"
+#include "constantPool.h"
+#include "runtime.h"
+
+#include <cmath>
+#include <cstdlib>
 
 #ifndef SP
 #define SP 29
@@ -31,10 +39,8 @@ int32_t parse_number(Token* token){
         return stoi(token->lexeme);
     }
     if (token->val_type == NUMBER_FLOAT){
-        float val = stof(token->lexeme);
-        int int_part = (int) val;
-        int float_part = (int) ((val - int_part) * 65536);
-        return (int_part << 16) | float_part;
+        // to the nearest 1/65536
+        return (int32_t) std::lround(std::stod(token->lexeme) * 65536);
     }
     throw std::runtime_error("Expected number at " + token->toString());
 }
@@ -113,27 +119,57 @@ TokenValue get_result_type(std::string& var1, std::string& var2, VariableTracker
     return TokenValue::INT;
 }
 
+// floats are 16.16 fixed point values, pointers to them are ints
+bool is_fixed_point(const std::string& var, VariableTracker* varTracker){
+    return varTracker->get_var_type(var) == TokenValue::FLOAT && varTracker->get_var_type_refs(var) == 0;
+}
+
+// a literal's value converted to a float if fixed or an int if not, for the other side of an op
+int32_t parse_number_as(Token* token, bool fixed){
+    int32_t value = parse_number(token);
+    if (fixed && token->val_type == NUMBER_INT) return (int32_t) ((uint32_t) value << 16);
+    if (!fixed && token->val_type == NUMBER_FLOAT) return value >> 16;
+    return value;
+}
+
+void load_constant(uint8_t reg, int32_t value, MipsBuilder* mipsBuilder){
+    if (value < 65536 && value > -65536) {
+        mipsBuilder->addInstruction(new InstrAddi(reg, 0, value), "");
+        return;
+    }
+    // load upper then lower
+    int16_t upper = (int16_t) (value >> 16);
+    int32_t lower = (value & 0x0000FFFF);
+    mipsBuilder->addInstruction(new InstrAddi(reg, 0, upper), "");
+    mipsBuilder->addInstruction(new InstrSll(reg, reg, 16), "");
+    if ((int16_t) lower < 0){
+        int16_t lower_m1 = (lower >> 1) & 0x7FFF;
+        mipsBuilder->addInstruction(new InstrAddi(1, 0, lower_m1), "");
+        mipsBuilder->addInstruction(new InstrSll(1, 1, 1), "");
+        mipsBuilder->addInstruction(new InstrAddi(1, 1, lower%2), "");
+        mipsBuilder->addInstruction(new InstrOr(reg, reg, 1), "");
+    }
+    else mipsBuilder->addInstruction(new InstrAddi(reg, reg, (int16_t) lower), "");
+}
+
 //region binary ops
 
 // parses an add operation. Returns the register of the final result
 std::string comp_add(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     auto* addOp = (BinaryOpToken*) token;
     std::string left = compile_op("", addOp->left, mipsBuilder, varTracker);
+    bool fixed = is_fixed_point(left, varTracker);
 
-    // use addi
-    if (addOp->right->type == TYPE_VALUE){
+    // use addi. an int plus a float literal is a float, so the int is converted below instead
+    if (addOp->right->type == TYPE_VALUE &&
+        (fixed || addOp->right->val_type != NUMBER_FLOAT || varTracker->get_var_type_refs(left) > 0)){
         std::string result = varTracker->add_temp_variable();
         uint8_t reg_result = varTracker->getReg(result);
-        int32_t imm = parse_number(addOp->right);
-        if(varTracker->get_var_type(left) == TokenValue::FLOAT || addOp->right->val_type == NUMBER_FLOAT){
-            varTracker->set_var_type(result, TokenValue::FLOAT);
-        }
-        else {
-            varTracker->set_var_type(result, TokenValue::INT);
-        }
+        int32_t imm = parse_number_as(addOp->right, fixed);
+        varTracker->set_var_type(result, fixed ? TokenValue::FLOAT : TokenValue::INT);
 
-        if (imm > 65536){
-            std::string value = compile_op("", addOp->right, mipsBuilder, varTracker);
+        if (imm >= 65536 || imm <= -65536){
+            std::string value = compile_constant(imm, mipsBuilder, varTracker);
             uint8_t reg_value = varTracker->getReg(value);
             uint8_t reg_a = varTracker->getReg(left);
             mipsBuilder->addInstruction(new InstrAdd(reg_result, reg_a, reg_value), "");
@@ -142,7 +178,7 @@ std::string comp_add(Token* token, MipsBuilder* mipsBuilder, VariableTracker* va
         }
         else {
             uint8_t reg_a = varTracker->getReg(left);
-            mipsBuilder->addInstruction(new InstrAddi(reg_result, reg_a, (int16_t) imm), "");
+            mipsBuilder->addInstruction(new InstrAddi(reg_result, reg_a, imm), "");
         }
 
         if (addOp->left->val_type != TokenValue::IDENTIFIER)
@@ -159,6 +195,7 @@ std::string comp_add(Token* token, MipsBuilder* mipsBuilder, VariableTracker* va
 
     uint8_t reg_a = varTracker->getReg(left);
     uint8_t reg_b = varTracker->getReg(right);
+    fixed = is_fixed_point(left, varTracker) || is_fixed_point(right, varTracker);
     if (addOp->left->val_type != TokenValue::IDENTIFIER)
         varTracker->removeVar(left);
     if (addOp->right->val_type != TokenValue::IDENTIFIER)
@@ -175,9 +212,7 @@ std::string comp_add(Token* token, MipsBuilder* mipsBuilder, VariableTracker* va
     uint8_t reg_result = varTracker->getReg(result);
     mipsBuilder->addInstruction(new InstrAdd(reg_result, reg_a, reg_b), "");
 
-    if (left_type == TokenValue::FLOAT || right_type == TokenValue::FLOAT)
-        varTracker->set_var_type(result, TokenValue::FLOAT);
-    else varTracker->set_var_type(result, TokenValue::INT);
+    varTracker->set_var_type(result, fixed ? TokenValue::FLOAT : TokenValue::INT);
 
     return result;
 }
@@ -189,14 +224,15 @@ std::string comp_add_eq(Token* token, MipsBuilder* mipsBuilder, VariableTracker*
     // use addi
     if (addEqOp->right->type == TYPE_VALUE){
         uint8_t reg_a = varTracker->getReg(left);
-        auto imm = parse_number(addEqOp->right);
-        if (imm >= 65536 || imm < -65536){
-            std::string right = compile_op("", addEqOp->right, mipsBuilder, varTracker);
+        auto imm = parse_number_as(addEqOp->right, is_fixed_point(left, varTracker));
+        if (imm >= 65536 || imm <= -65536){
+            std::string right = compile_constant(imm, mipsBuilder, varTracker);
             uint8_t reg_b = varTracker->getReg(right);
             mipsBuilder->addInstruction(new InstrAdd(reg_a, reg_a, reg_b), "");
+            varTracker->removeVar(right);
         }
         else {
-            mipsBuilder->addInstruction(new InstrAddi(reg_a, reg_a, (int16_t) imm), "");
+            mipsBuilder->addInstruction(new InstrAddi(reg_a, reg_a, imm), "");
         }
 
         return left;
@@ -220,11 +256,8 @@ std::string comp_add_eq(Token* token, MipsBuilder* mipsBuilder, VariableTracker*
     return left;
 }
 
-RTypeVals comp_bin_op(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker, bool match_types=false){
-    auto* op = (BinaryOpToken*) token;
-    std::string left = compile_op("", op->left, mipsBuilder, varTracker);
-    std::string right = compile_op("", op->right, mipsBuilder, varTracker);
-
+// registers for an R-type op on two compiled values. is_eq writes the result back into left
+RTypeVals bin_op_vals(std::string left, std::string right, bool is_eq, MipsBuilder* mipsBuilder, VariableTracker* varTracker, bool match_types){
     if (match_types){
         MatchTypeResults results = match_num_types(left, right, varTracker, mipsBuilder);
         left = results.left;
@@ -236,8 +269,12 @@ RTypeVals comp_bin_op(Token* token, MipsBuilder* mipsBuilder, VariableTracker* v
     varTracker->removeIfTemp(left);
     varTracker->removeIfTemp(right);
 
-    std::string result = varTracker->add_temp_variable();
-    uint8_t reg_result = varTracker->getReg(result);
+    std::string result = left;
+    uint8_t reg_result = reg_a;
+    if (!is_eq){
+        result = varTracker->add_temp_variable();
+        reg_result = varTracker->getReg(result);
+    }
 
     TokenValue resultType = varTracker->get_var_type(left);
     if (match_types) resultType = get_result_type(left, right, varTracker);
@@ -251,32 +288,72 @@ RTypeVals comp_bin_op(Token* token, MipsBuilder* mipsBuilder, VariableTracker* v
     };
 }
 
+RTypeVals comp_bin_op(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker, bool match_types=false){
+    auto* op = (BinaryOpToken*) token;
+    std::string left = compile_op("", op->left, mipsBuilder, varTracker);
+    std::string right = compile_op("", op->right, mipsBuilder, varTracker);
+    return bin_op_vals(left, right, false, mipsBuilder, varTracker, match_types);
+}
+
 RTypeVals comp_bin_op_eq(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker, bool match_types=false){
     auto* op = (BinaryOpToken*) token;
     std::string left = compile_op("", op->left, mipsBuilder, varTracker);
     std::string right = compile_op("", op->right, mipsBuilder, varTracker);
+    return bin_op_vals(left, right, true, mipsBuilder, varTracker, match_types);
+}
 
-    if (match_types) {
-        MatchTypeResults results = match_num_types(left, right, varTracker, mipsBuilder);
-        left = results.left;
-        right = results.right;
+bool is_int_literal(Token* token){
+    return token->type == TokenType::TYPE_VALUE && token->val_type == NUMBER_INT;
+}
+
+bool is_unrolled_memory_size(Token* size){
+    return is_int_literal(size) && std::stoll(size->lexeme) <= MEMORY_UNROLL_WORDS;
+}
+
+bool is_memory_intrinsic(FunctionCallToken* call, VariableTracker* varTracker){
+    if (call->is_inline || call->arguments.size() != 3 || (call->lexeme != "memcpy" && call->lexeme != "memset")) return false;
+    if (varTracker->defines_function(call->lexeme)) return false;
+    return is_unrolled_memory_size(call->arguments[2]);
+}
+
+typedef void (*ConstantLowering)(uint8_t rd, uint8_t rs, int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
+// compiles an int op with a literal on the right (or either side if commutative) using lower, which avoids the multdiv unit.
+// keeps_scale is if lower works on a float too, which scales the same way an int does when multiplied or divided.
+// returns false with both sides compiled into left and right if the op isn't one of those
+bool comp_op_with_constant(bool is_eq, bool commutative, bool keeps_scale, Token* token, ConstantLowering lower, std::string* result_tag,
+                           std::string* left, std::string* right, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    auto* op = (BinaryOpToken*) token;
+    bool constant_left = commutative && !is_eq && is_int_literal(op->left) && !is_int_literal(op->right);
+    if (!constant_left && !is_int_literal(op->right)){
+        *left = compile_op("", op->left, mipsBuilder, varTracker);
+        *right = compile_op("", op->right, mipsBuilder, varTracker);
+        return false;
     }
 
-    uint8_t reg_a = varTracker->getReg(left);
-    uint8_t reg_b = varTracker->getReg(right);
-    varTracker->removeIfTemp(left);
-    varTracker->removeIfTemp(right);
+    Token* var_token = constant_left ? op->right : op->left;
+    Token* constant = constant_left ? op->left : op->right;
+    std::string var = compile_op("", var_token, mipsBuilder, varTracker);
+    bool fixed = is_fixed_point(var, varTracker);
+    if (fixed && !keeps_scale){
+        *left = var;
+        *right = compile_op("", constant, mipsBuilder, varTracker);
+        return false;
+    }
 
-    TokenValue resultType = varTracker->get_var_type(left);
-    if (match_types) resultType = get_result_type(left, right, varTracker);
+    uint8_t reg_var = varTracker->getReg(var);
+    std::string result = var;
+    uint8_t reg_result = reg_var;
+    if (!is_eq){
+        result = varTracker->add_temp_variable();
+        reg_result = varTracker->getReg(result);
+    }
+    lower(reg_result, reg_var, parse_number(constant), mipsBuilder, varTracker);
+    if (!is_eq) varTracker->removeIfTemp(var);
+    varTracker->set_var_type(result, fixed ? TokenValue::FLOAT : TokenValue::INT);
 
-    return {
-            reg_a,
-            reg_a,
-            reg_b,
-            left,
-            resultType
-    };
+    *result_tag = result;
+    return true;
 }
 
 std::string comp_minus_or_minus_eq(bool is_eq, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
@@ -289,19 +366,71 @@ std::string comp_minus_or_minus_eq(bool is_eq, Token* token, MipsBuilder* mipsBu
 }
 
 std::string comp_mult_or_mult_eq(bool is_eq, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
-    RTypeVals vals = is_eq ?
-                     comp_bin_op_eq(token, mipsBuilder, varTracker, true) :
-                     comp_bin_op(token, mipsBuilder, varTracker, true);
-    mipsBuilder->addInstruction(new InstrMul(vals.rd, vals.rs, vals.rt), "");
-    varTracker->set_var_type(vals.resultTag, vals.resultType);
+    std::string result, left, right;
+    if (comp_op_with_constant(is_eq, true, true, token, emit_mult_by_constant, &result, &left, &right, mipsBuilder, varTracker))
+        return result;
+    bool fixed_left = is_fixed_point(left, varTracker);
+    bool fixed_right = is_fixed_point(right, varTracker);
+    RTypeVals vals = bin_op_vals(left, right, is_eq, mipsBuilder, varTracker, false);
+    // two fixed point values multiply to 16 fraction bits too many, which hmul drops. a float times an int is already right
+    if (fixed_left && fixed_right) mipsBuilder->addInstruction(new InstrHMul(vals.rd, vals.rs, vals.rt), "");
+    else mipsBuilder->addInstruction(new InstrMul(vals.rd, vals.rs, vals.rt), "");
+
+    TokenValue type = fixed_left || fixed_right ? TokenValue::FLOAT : TokenValue::INT;
+    if (is_eq && !fixed_left && fixed_right){
+        // an int times a float put back in the int
+        mipsBuilder->addInstruction(new InstrSra(vals.rd, vals.rd, 16), "");
+        type = TokenValue::INT;
+    }
+    varTracker->set_var_type(vals.resultTag, type);
     return vals.resultTag;
 }
 
 std::string comp_div_or_div_eq(bool is_eq, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
-    RTypeVals vals = is_eq ?
-                     comp_bin_op_eq(token, mipsBuilder, varTracker, true) :
-                     comp_bin_op(token, mipsBuilder, varTracker, true);
-    mipsBuilder->addInstruction(new InstrDiv(vals.rd, vals.rs, vals.rt), "");
+    std::string result, left, right;
+    if (comp_op_with_constant(is_eq, false, true, token, emit_div_by_constant, &result, &left, &right, mipsBuilder, varTracker))
+        return result;
+    bool fixed_left = is_fixed_point(left, varTracker);
+    if (!is_fixed_point(right, varTracker)){
+        // dividing by an int is the same for a float and an int
+        RTypeVals vals = bin_op_vals(left, right, is_eq, mipsBuilder, varTracker, false);
+        mipsBuilder->addInstruction(new InstrDiv(vals.rd, vals.rs, vals.rt), "");
+        varTracker->set_var_type(vals.resultTag, fixed_left ? TokenValue::FLOAT : TokenValue::INT);
+        return vals.resultTag;
+    }
+
+    uint8_t reg_left = varTracker->getReg(left);
+    uint8_t reg_right = varTracker->getReg(right);
+    std::string dividend = left;
+    if (!fixed_left){
+        dividend = varTracker->add_temp_variable();
+        mipsBuilder->addInstruction(new InstrSll(varTracker->getReg(dividend), reg_left, 16), "");
+    }
+    result = is_eq && fixed_left ? left : varTracker->add_temp_variable();
+    uint8_t reg_result = varTracker->getReg(result);
+    emit_fixed_div(reg_result, varTracker->getReg(dividend), reg_right, mipsBuilder, varTracker);
+    varTracker->set_var_type(result, TokenValue::FLOAT);
+    if (dividend != left) varTracker->removeVar(dividend);
+    varTracker->removeIfTemp(right);
+    if (is_eq && !fixed_left){
+        // an int divided by a float put back in the int
+        mipsBuilder->addInstruction(new InstrSra(reg_left, reg_result, 16), "");
+        varTracker->removeVar(result);
+        return left;
+    }
+    if (result != left) varTracker->removeIfTemp(left);
+    return result;
+}
+
+std::string comp_mod_or_mod_eq(bool is_eq, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    std::string result, left, right;
+    if (comp_op_with_constant(is_eq, false, false, token, emit_mod_by_constant, &result, &left, &right, mipsBuilder, varTracker))
+        return result;
+    RTypeVals vals = bin_op_vals(left, right, is_eq, mipsBuilder, varTracker, true);
+    // a % b = a - (a / b) * b
+    mipsBuilder->addInstruction(new InstrDiv(1, vals.rs, vals.rt), "");
+    mipsBuilder->addInstruction(new InstrMul(1, 1, vals.rt), "");
+    mipsBuilder->addInstruction(new InstrSub(vals.rd, vals.rs, 1), "");
     varTracker->set_var_type(vals.resultTag, vals.resultType);
     return vals.resultTag;
 }
@@ -375,167 +504,38 @@ std::string comp_sra_or_sra_eq(bool is_eq, Token* token, MipsBuilder* mipsBuilde
     return result;
 }
 
-std::string comp_lt(const std::string& break_to, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
-    if (!break_to.empty()){
-        RTypeVals vals = comp_bin_op_eq(token, mipsBuilder, varTracker, true);
-        mipsBuilder->addInstruction(new InstrBlt(vals.rs, vals.rt, break_to), "");
-        varTracker->set_var_type(vals.resultTag, TokenValue::INT);
-        return vals.resultTag;
-    }
-
+std::string comp_lt(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     RTypeVals vals = comp_bin_op(token, mipsBuilder, varTracker, true);
-    /*
-     if not breaking, then use blt to set register to 1 if true, 0 if false
-     (pseudo) lt $reg, $r_a, $r_b =
-     ble $r_a, $r_b, label_true
-     addi $reg, $0, 0
-     j label_end
-     label_true:
-     addi $reg, $0, 1
-     label_end: noop, this can be filtered out later in an optimizing step
-    */
     mipsBuilder->addInstruction(new InstrSlt(vals.rd, vals.rs, vals.rt), "");
     varTracker->set_var_type(vals.resultTag, TokenValue::INT);
     return vals.resultTag;
 }
 
-std::string comp_lte(const std::string& break_to, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
-    // a <= b is the same as a < b or a = b
-
-    if (!break_to.empty()){
-        RTypeVals vals = comp_bin_op_eq(token, mipsBuilder, varTracker, true);
-        // if breaking to something, simply break
-        // (pseudo) blte $r_a, $r_b, label
-        // blt $r_a, $r_b, label
-        // bne $r_a, $r_b, no_jump
-        // j label
-        // no_jump: nop
-        std::string label_no_jump = mipsBuilder->genUnnamedLabel();
-        mipsBuilder->addInstruction(new InstrBlt(vals.rs, vals.rt, break_to), "");
-        mipsBuilder->addInstruction(new InstrBne(vals.rs, vals.rt, label_no_jump), "");
-        mipsBuilder->addInstruction(new InstrJ(break_to), "");
-        mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_no_jump);
-        varTracker->set_var_type(vals.resultTag, TokenValue::INT);
-        return vals.resultTag;
-    }
+std::string comp_lte(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    // a <= b is the same as b >= a
     RTypeVals vals = comp_bin_op(token, mipsBuilder, varTracker, true);
-    /*
-     if not breaking, then use blt to set register to 1 if true, 0 if false
-     (pseudo) lte $reg, $r_a, $r_b =
-     blt $r_a, $r_b, label_true
-     bne $r_a, $r_b, label_false
-     addi $reg, $0, 1
-     j label_end
-     label_false: addi $reg, $0, 0
-     j label_end
-     label_true:
-     addi $reg, $0, 1
-     label_end: noop, this can be filtered out later in an optimizing step
-    */
-    std::string label_true = mipsBuilder->genUnnamedLabel();
-    std::string label_false = mipsBuilder->genUnnamedLabel();
-    std::string label_end = mipsBuilder->genUnnamedLabel();
-    mipsBuilder->addInstruction(new InstrBlt(vals.rs, vals.rt, label_true), "");
-    mipsBuilder->addInstruction(new InstrBne(vals.rs, vals.rt, label_false), "");
-    mipsBuilder->addInstruction(new InstrAddi(vals.rd, 0, 1), "");
-    mipsBuilder->addInstruction(new InstrJ(label_end), "");
-    mipsBuilder->addInstruction(new InstrAddi(vals.rd, 0, 0), label_false);
-    mipsBuilder->addInstruction(new InstrJ(label_end), "");
-    mipsBuilder->addInstruction(new InstrAddi(vals.rd, 0, 1), label_true);
-    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_end); // noop
+    mipsBuilder->addInstruction(new InstrSge(vals.rd, vals.rt, vals.rs), "");
     varTracker->set_var_type(vals.resultTag, TokenValue::INT);
     return vals.resultTag;
 }
 
-std::string comp_gt(const std::string& break_to, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
-    // a > b is the same as !(a <= b) = !(a < b) && !(a == b)
-
-    if (!break_to.empty()){
-        RTypeVals vals = comp_bin_op_eq(token, mipsBuilder, varTracker, true);
-        // break if not < and not =
-        /*
-         (pseudo) bgt $reg_a, reg_b, label
-         blt $reg_a, $reg_b, label_no_jump
-         bne $reg_a, $reg_b, label
-         label_no_jump: nop
-         */
-        std::string temp_var = varTracker->add_temp_variable();
-        uint8_t reg_temp = varTracker->getReg(temp_var);
-        mipsBuilder->addInstruction(new InstrSgt(reg_temp, vals.rs, vals.rt), "");
-        mipsBuilder->addInstruction(new InstrBne(reg_temp, 0, break_to), "");
-        varTracker->removeVar(temp_var);
-        varTracker->set_var_type(vals.resultTag, TokenValue::INT);
-        return vals.resultTag;
-    }
+std::string comp_gt(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     RTypeVals vals = comp_bin_op(token, mipsBuilder, varTracker, true);
-    /*
-     if not breaking, then use blt to set register to 1 if true, 0 if false
-     (pseudo) gt $reg, $r_a, $r_b =
-     blt $r_a, $r_b, label_false
-     bne $r_a, $r_b, label_true
-     label_false: addi $reg, $0, 0
-     j label_end
-     label_true: addi $reg, $0, 1
-     label_end: noop, this can be filtered out later in an optimizing step
-    */
     mipsBuilder->addInstruction(new InstrSgt(vals.rd, vals.rs, vals.rt), "");
     varTracker->set_var_type(vals.resultTag, TokenValue::INT);
     return vals.resultTag;
 }
 
-std::string comp_gte(const std::string& break_to, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
-    // a >= b is the same as !(a < b)
-
-    if (!break_to.empty()){
-        RTypeVals vals = comp_bin_op_eq(token, mipsBuilder, varTracker, true);
-        // break if equal, or break if not a < b
-        // (pseudo) bgte $reg_a, reg_b, label
-        // bne $reg_a, $reg_b, label_stage_2
-        // j label
-        // label_stage_2: blt $reg_a, $reg_b, label_no_jump
-        // j label
-        // label_no_jump: nop
-        std::string temp_var = varTracker->add_temp_variable();
-        uint8_t reg_temp = varTracker->getReg(temp_var);
-        mipsBuilder->addInstruction(new InstrSge(reg_temp, vals.rs, vals.rt), "");
-        mipsBuilder->addInstruction(new InstrBne(reg_temp, 0, break_to), "");
-        varTracker->removeVar(temp_var);
-        varTracker->set_var_type(vals.resultTag, TokenValue::INT);
-        return vals.resultTag;
-    }
+std::string comp_gte(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     RTypeVals vals = comp_bin_op(token, mipsBuilder, varTracker, true);
-    /*
-     if not breaking, then use blt to set register to 1 if true, 0 if false
-     (pseudo) gte $reg, $r_a, $r_b =
-     blt $r_a, $r_b, label_false
-     addi $reg, $0, 1
-     j label_end
-     label_false: addi $reg, $0, 0
-     label_end: noop, this can be filtered out later in an optimizing step
-    */
     mipsBuilder->addInstruction(new InstrSge(vals.rd, vals.rs, vals.rt), "");
     varTracker->set_var_type(vals.resultTag, TokenValue::INT);
     return vals.resultTag;
 }
 
-std::string comp_eq_eq(const std::string& break_to, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+std::string comp_eq_eq(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     RTypeVals vals = comp_bin_op(token, mipsBuilder, varTracker, true);
-
-    if (!break_to.empty()){
-        // break if equal
-        // (pseudo) beq $reg_a, reg_b, label
-        // bne $reg_a, $reg_b, label_no_jump
-        // j label
-        // label_no_jump: nop
-        std::string label_no_jump = mipsBuilder->genUnnamedLabel();
-        mipsBuilder->addInstruction(new InstrBne(vals.rs, vals.rt, label_no_jump), "");
-        mipsBuilder->addInstruction(new InstrJ(break_to), "");
-        mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_no_jump);
-        varTracker->set_var_type(vals.resultTag, TokenValue::INT);
-        return vals.resultTag;
-    }
     /*
-     if not breaking, then use blt to set register to 1 if true, 0 if false
      (pseudo) seteq $reg, $reg_a, $reg_b
      bne $r_a, $r_b, label_false
      addi $reg, $0, 1
@@ -554,21 +554,13 @@ std::string comp_eq_eq(const std::string& break_to, Token* token, MipsBuilder* m
     return vals.resultTag;
 }
 
-std::string comp_not_eq(const std::string& break_to, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+std::string comp_not_eq(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     RTypeVals vals = comp_bin_op(token, mipsBuilder, varTracker, true);
-
-    if (!break_to.empty()){
-        // literally just a bne
-        mipsBuilder->addInstruction(new InstrBne(vals.rs, vals.rt, break_to), "");
-        varTracker->set_var_type(vals.resultTag, TokenValue::INT);
-        return vals.resultTag;
-    }
     /*
-     if not breaking, then use blt to set register to 1 if true, 0 if false
      bne $reg_a, $reg_b, label_true
      addi $reg, $0, 0
      j label_end
-     label_true: addi $reg, $0, 0
+     label_true: addi $reg, $0, 1
      label_end: nop
     */
     std::string label_true = mipsBuilder->genUnnamedLabel();
@@ -582,7 +574,16 @@ std::string comp_not_eq(const std::string& break_to, Token* token, MipsBuilder*
     return vals.resultTag;
 }
 
-std::string compile_array_set(Token* token, Token* value, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+// where arr[index] is: a register and the offset from it. Constant indices and index +- constant go in the offset,
+// and loops that step through the array keep a pointer at the element instead of adding the index every time.
+// temp is set if the register was made just for this access
+struct ArrayAddress{
+    uint8_t reg;
+    int16_t offset;
+    std::string temp;
+};
+
+ArrayAddress compile_array_address(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     auto* addr = (BinaryOpToken*) token;
 
     auto* var_tok = (Token*) addr->left;
@@ -592,39 +593,53 @@ std::string compile_array_set(Token* token, Token* value, MipsBuilder* mipsBuild
 
     std::string var = var_tok->lexeme;
 
-    bool use_right_num = false;
-    int right_num;
-
     if (addr->right->val_type == NUMBER_INT){
-        use_right_num = true;
-        right_num = stoi(addr->right->lexeme);
+        return {varTracker->getReg(var), (int16_t) stoi(addr->right->lexeme), ""};
     }
 
-    std::string value_str = compile_op("", value, mipsBuilder, varTracker);
-    std::string index;
-    if (!use_right_num) {
-        index = compile_op("", addr->right, mipsBuilder, varTracker);
+    Token* index_tok = addr->right;
+    int offset = 0;
+    if (index_tok->type == TYPE_OPERATOR && (index_tok->val_type == ADD || index_tok->val_type == MINUS)){
+        auto* sum = (BinaryOpToken*) index_tok;
+        if (is_int_literal(sum->right) && abs(stoi(sum->right->lexeme)) < 32768){
+            offset = index_tok->val_type == ADD ? stoi(sum->right->lexeme) : -stoi(sum->right->lexeme);
+            index_tok = sum->left;
+        }
+        else if (index_tok->val_type == ADD && is_int_literal(sum->left) && abs(stoi(sum->left->lexeme)) < 32768){
+            offset = stoi(sum->left->lexeme);
+            index_tok = sum->right;
+        }
     }
-    if (!index.empty() && varTracker->get_var_type(index) != TokenValue::INT)
+
+    InductionPointer pointer;
+    if (index_tok->type == TYPE_IDENTIFIER && varTracker->get_induction_pointer(var, index_tok->lexeme, &pointer) &&
+        offset + pointer.lag < 32768 && offset + pointer.lag >= -32768){
+        return {varTracker->getReg(pointer.pointer), (int16_t) (offset + pointer.lag), ""};
+    }
+
+    std::string index = compile_op("", index_tok, mipsBuilder, varTracker);
+    if (varTracker->get_var_type(index) == TokenValue::FLOAT)
         throw std::runtime_error("Array index must be an integer at " + addr->right->toString());
 
+    // the index may be a variable, which can't be overwritten
+    std::string temp = index.find("<temp") != std::string::npos ? index : varTracker->add_temp_variable();
+    uint8_t reg_temp = varTracker->getReg(temp);
+    uint8_t reg_index = varTracker->getReg(index);
     uint8_t mem = varTracker->getReg(var);
-    uint8_t value_reg = varTracker->getReg(value_str);
-
-    varTracker->removeIfTemp(value_str);
+    mipsBuilder->addInstruction(new InstrAdd(reg_temp, reg_index, mem), "");
+    varTracker->removeIfTemp(var);
+    return {reg_temp, (int16_t) offset, temp};
+}
 
-    if (use_right_num){
-        mipsBuilder->addInstruction(new InstrSw(value_reg, mem, (int16_t) right_num), "");
-    }
-    else {
-        uint8_t offset_reg = varTracker->getReg(index);
-        mipsBuilder->addInstruction(new InstrAdd(offset_reg, offset_reg, mem), "");
-        mipsBuilder->addInstruction(new InstrSw(value_reg, offset_reg, 0), "");
+std::string compile_array_set(Token* token, Token* value, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    std::string value_str = compile_op("", value, mipsBuilder, varTracker);
+    ArrayAddress address = compile_array_address(token, mipsBuilder, varTracker);
 
-        varTracker->removeIfTemp(index);
-    }
+    uint8_t value_reg = varTracker->getReg(value_str);
+    varTracker->removeIfTemp(value_str);
 
-    varTracker->removeIfTemp(var);
+    mipsBuilder->addInstruction(new InstrSw(value_reg, address.reg, address.offset), "");
+    if (!address.temp.empty()) varTracker->removeVar(address.temp);
 
     return value_str;
 
@@ -659,9 +674,9 @@ std::string comp_eq(Token* token, MipsBuilder* mipsBuilder, VariableTracker* var
 
     if (op->right->type == TYPE_VALUE){
         uint8_t reg_a = varTracker->getReg(left);
-        auto imm = parse_number(op->right);
-        if (imm > 65536 || imm <= -65536){
-            std::string value = compile_op("", op->right, mipsBuilder, varTracker);
+        auto imm = parse_number_as(op->right, is_fixed_point(left, varTracker));
+        if (imm >= 65536 || imm <= -65536){
+            std::string value = compile_constant(imm, mipsBuilder, varTracker);
             uint8_t reg_value = varTracker->getReg(value);
             mipsBuilder->addInstruction(new InstrAdd(reg_a, 0, reg_value), "");
 
@@ -669,7 +684,7 @@ std::string comp_eq(Token* token, MipsBuilder* mipsBuilder, VariableTracker* var
         }
         else {
             // use addi
-            mipsBuilder->addInstruction(new InstrAddi(reg_a, 0, (int16_t) imm), "");
+            mipsBuilder->addInstruction(new InstrAddi(reg_a, 0, imm), "");
         }
         return left;
     }
@@ -744,27 +759,13 @@ std::string comp_deref(Token* token, MipsBuilder* mipsBuilder, VariableTracker*
     return temp_var;
 }
 
-std::string comp_not(const std::string& break_to, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+std::string comp_not(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     auto* op = (BinaryOpToken*) token;
     Token* value = op->right;
     std::string right_label = compile_op("", value, mipsBuilder, varTracker);
     uint8_t reg = varTracker->getReg(right_label);
 
-    if (!break_to.empty()){
-        // break if not equal
-        // (pseudo) bne $reg_a, reg_b, label
-        // beq $reg_a, $reg_b, label_no_jump
-        // j label
-        // label_no_jump: nop
-        std::string label_no_jump = mipsBuilder->genUnnamedLabel();
-        mipsBuilder->addInstruction(new InstrBne(reg, 0, label_no_jump), "");
-        mipsBuilder->addInstruction(new InstrJ(break_to), "");
-        mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_no_jump);
-        varTracker->set_var_type(right_label, TokenValue::INT);
-        return right_label;
-    }
     /*
-     if not breaking, then use blt to set register to 1 if true, 0 if false
      (pseudo) setne $reg, $reg_a, $reg_b
      beq $r_a, $r_b, label_false
      addi $reg, $0, 1
@@ -788,6 +789,200 @@ std::string comp_not(const std::string& break_to, Token* token, MipsBuilder* mip
     return result_tag;
 }
 
+TokenValue inverse_comparison(TokenValue op){
+    switch (op) {
+        case LT: return GTE;
+        case LTE: return GT;
+        case GT: return LTE;
+        case GTE: return LT;
+        case EQ_EQ: return NOT_EQ;
+        case NOT_EQ: return EQ_EQ;
+        default: return NONE;
+    }
+}
+
+// a op b is the same as b mirrored a
+TokenValue mirrored_comparison(TokenValue op){
+    switch (op) {
+        case LT: return GT;
+        case LTE: return GTE;
+        case GT: return LT;
+        case GTE: return LTE;
+        default: return op;
+    }
+}
+
+/*
+ Jumps to label if the comparison is jump_if. Looking for the opposite just flips the comparison,
+ and operands are swapped so that almost everything is a single blt or bne:
+ a < b:  blt $a, $b, label
+ a > b:  blt $b, $a, label
+ a != b: bne $a, $b, label
+ a <= c and a >= c, for an int literal c, are a < c + 1 and c - 1 < a. Otherwise:
+ a <= b: sge $temp, $b, $a / bne $temp, $0, label
+ a >= b: sge $temp, $a, $b / bne $temp, $0, label
+ a == b: bne $a, $b, no_jump / j label / no_jump: noop
+*/
+void comp_compare_branch(bool jump_if, const std::string& label, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    auto* compare = (BinaryOpToken*) token;
+    TokenValue op = jump_if ? compare->val_type : inverse_comparison(compare->val_type);
+
+    // literals go on the right, where they can be moved by 1. they can't do anything, so it's fine to compile them second
+    Token* left_tok = compare->left;
+    Token* right_tok = compare->right;
+    if (is_int_literal(left_tok) && !is_int_literal(right_tok)){
+        std::swap(left_tok, right_tok);
+        op = mirrored_comparison(op);
+    }
+
+    std::string left = compile_op("", left_tok, mipsBuilder, varTracker);
+    std::string right;
+    if ((op == LTE || op == GTE) && is_int_literal(right_tok) && varTracker->get_var_type(left) != TokenValue::FLOAT){
+        int64_t moved = (int64_t) parse_number(right_tok) + (op == LTE ? 1 : -1);
+        if (moved >= INT32_MIN && moved <= INT32_MAX){
+            right = varTracker->add_temp_variable();
+            varTracker->set_var_type(right, TokenValue::INT);
+            load_constant(varTracker->getReg(right), (int32_t) moved, mipsBuilder);
+            op = op == LTE ? LT : GT;
+        }
+    }
+    if (right.empty()) right = compile_op("", right_tok, mipsBuilder, varTracker);
+
+    RTypeVals vals = bin_op_vals(left, right, true, mipsBuilder, varTracker, true);
+    if (op == LT) mipsBuilder->addInstruction(new InstrBlt(vals.rs, vals.rt, label), "");
+    else if (op == GT) mipsBuilder->addInstruction(new InstrBlt(vals.rt, vals.rs, label), "");
+    else if (op == NOT_EQ) mipsBuilder->addInstruction(new InstrBne(vals.rs, vals.rt, label), "");
+    else if (op == EQ_EQ){
+        std::string label_no_jump = mipsBuilder->genUnnamedLabel();
+        mipsBuilder->addInstruction(new InstrBne(vals.rs, vals.rt, label_no_jump), "");
+        mipsBuilder->addInstruction(new InstrJ(label), "");
+        mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_no_jump);
+    }
+    else {
+        std::string temp = varTracker->add_temp_variable();
+        uint8_t reg_temp = varTracker->getReg(temp);
+        if (op == LTE) mipsBuilder->addInstruction(new InstrSge(reg_temp, vals.rt, vals.rs), "");
+        else mipsBuilder->addInstruction(new InstrSge(reg_temp, vals.rs, vals.rt), "");
+        mipsBuilder->addInstruction(new InstrBne(reg_temp, 0, label), "");
+        varTracker->removeVar(temp);
+    }
+}
+
+// the right side of && and || only runs some of the time, so whatever it would load into a register or
+// save on the stack is done before branching past it. then everything is in the same place either way
+ReturnAddressState start_conditional(Token* token, VariableTracker* varTracker){
+    for_each_token(token, [varTracker](Token* t){
+        if (t->type == TYPE_IDENTIFIER && varTracker->var_exists(t->lexeme)) varTracker->getReg(t->lexeme, false);
+    });
+    if (contains_call(token, varTracker)) varTracker->save_return_address();
+    return varTracker->get_return_address_state();
+}
+
+void end_conditional(ReturnAddressState skipped, VariableTracker* varTracker){
+    ReturnAddressState state = varTracker->get_return_address_state();
+    varTracker->set_return_address_state({state.in_reg && skipped.in_reg, state.in_stack && skipped.in_stack});
+}
+
+void compile_branch(bool jump_if, const std::string& label, Token* condition, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    TokenValue op = condition->type == TYPE_OPERATOR ? condition->val_type : NONE;
+
+    if (op == AND || op == OR){
+        auto* logical = (BinaryOpToken*) condition;
+        ReturnAddressState skipped = start_conditional(logical->right, varTracker);
+        if ((op == OR) == jump_if){
+            // either side is enough to jump
+            compile_branch(jump_if, label, logical->left, mipsBuilder, varTracker);
+            compile_branch(jump_if, label, logical->right, mipsBuilder, varTracker);
+        }
+        else {
+            // both sides are needed, so if the left one says no the right one is skipped
+            std::string label_skip = mipsBuilder->genUnnamedLabel();
+            compile_branch(!jump_if, label_skip, logical->left, mipsBuilder, varTracker);
+            compile_branch(jump_if, label, logical->right, mipsBuilder, varTracker);
+            mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_skip);
+        }
+        end_conditional(skipped, varTracker);
+        return;
+    }
+    if (op == NOT){
+        compile_branch(!jump_if, label, ((BinaryOpToken*) condition)->right, mipsBuilder, varTracker);
+        return;
+    }
+    if (inverse_comparison(op) != NONE){
+        comp_compare_branch(jump_if, label, condition, mipsBuilder, varTracker);
+        return;
+    }
+
+    if (is_int_literal(condition)){
+        // always goes the same way
+        if ((parse_number(condition) != 0) == jump_if) mipsBuilder->addInstruction(new InstrJ(label), "");
+        return;
+    }
+
+    std::string v = compile_op("", condition, mipsBuilder, varTracker);
+    uint8_t reg = varTracker->getReg(v);
+    if (jump_if){
+        mipsBuilder->addInstruction(new InstrBne(reg, 0, label), "");
+        return;
+    }
+    // there's no beq
+    std::string label_no_jump = mipsBuilder->genUnnamedLabel();
+    mipsBuilder->addInstruction(new InstrBne(reg, 0, label_no_jump), "");
+    mipsBuilder->addInstruction(new InstrJ(label), "");
+    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_no_jump);
+}
+
+// a comparison that's a single slt, sgt or sge, and can't do anything but set its result
+bool is_flag_comparison(Token* token){
+    if (token->type != TYPE_OPERATOR || (token->val_type != LT && token->val_type != GT && token->val_type != GTE))
+        return false;
+    auto* compare = (BinaryOpToken*) token;
+    for (Token* side : {compare->left, compare->right}){
+        if (side->type != TYPE_IDENTIFIER && side->type != TYPE_VALUE) return false;
+    }
+    return true;
+}
+
+std::string comp_logical(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    auto* op = (BinaryOpToken*) token;
+    bool is_and = op->val_type == AND;
+
+    // two comparisons that set 0 or 1 are cheaper to combine than to branch around
+    if (is_flag_comparison(op->left) && is_flag_comparison(op->right)){
+        std::string left = compile_op("", op->left, mipsBuilder, varTracker);
+        std::string right = compile_op("", op->right, mipsBuilder, varTracker);
+        std::string result = varTracker->add_temp_variable();
+        uint8_t reg_result = varTracker->getReg(result);
+        uint8_t reg_left = varTracker->getReg(left);
+        uint8_t reg_right = varTracker->getReg(right);
+        if (is_and) mipsBuilder->addInstruction(new InstrAnd(reg_result, reg_left, reg_right), "");
+        else mipsBuilder->addInstruction(new InstrOr(reg_result, reg_left, reg_right), "");
+        varTracker->removeIfTemp(left);
+        varTracker->removeIfTemp(right);
+        varTracker->set_var_type(result, TokenValue::INT);
+        return result;
+    }
+
+    /*
+     a && b:
+     addi $reg, $0, 0
+     [jump to label_end if a is 0]
+     [jump to label_end if b is 0]
+     addi $reg, $0, 1
+     label_end: noop
+     a || b is the same with 0 and 1 swapped, jumping if a or b isn't 0
+    */
+    std::string result = varTracker->add_temp_variable();
+    uint8_t reg_result = varTracker->getReg(result);
+    std::string label_end = mipsBuilder->genUnnamedLabel();
+    mipsBuilder->addInstruction(new InstrAddi(reg_result, 0, is_and ? 0 : 1), "");
+    compile_branch(!is_and, label_end, token, mipsBuilder, varTracker);
+    mipsBuilder->addInstruction(new InstrAddi(reg_result, 0, is_and ? 1 : 0), "");
+    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), label_end); // noop
+    varTracker->set_var_type(result, TokenValue::INT);
+    return result;
+}
+
 //endregion
 
 void compile_instructions(BreakScope* breakScope, const std::vector<Token*>& tokens, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
@@ -795,28 +990,31 @@ void compile_instructions(BreakScope* breakScope, const std::vector<Token*>& tok
 std::string compile_inline_function_call(FunctionCallToken* call, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     FunctionToken* func = varTracker->get_inline_function(call->lexeme);
 
-    std::vector<std::string> args;
-    std::map<std::string, std::string> saved_vars;
-
-    for (int i = 0; i < call->arguments.size(); i++){
-        Token* arg = call->arguments[i];
-        DefinitionToken* arg_name_tok = call->arg_names[i];
+    // every argument is worked out before the parameters get their names, since an argument can use a caller's
+    // variable with the same name as a parameter
+    std::vector<std::string> results;
+    for (Token* arg : call->arguments){
         std::string result = compile_op("", arg, mipsBuilder, varTracker);
         varTracker->getReg(result);
-        std::string arg_name = arg_name_tok->name;
-
-        if (varTracker->var_exists(arg_name)){
-            std::string new_name = varTracker->add_temp_variable();
-            uint8_t cur_reg = varTracker->getReg(arg_name);
-            uint8_t reg_new_name = varTracker->getReg(new_name);
-            mipsBuilder->addInstruction(new InstrAdd(reg_new_name, 0, cur_reg), "");
-            saved_vars[arg_name] = new_name;
-            arg_name = new_name;
-        }
+        results.push_back(result);
+    }
 
-        varTracker->set_alias(arg_name, result);
-        args.push_back(arg_name);
+    // the body finds its parameters before the caller's variables with the same names. a parameter the body may
+    // assign to gets a copy of its argument, so the caller's variable keeps its value
+    std::vector<std::string> args;
+    for (int i = 0; i < call->arguments.size(); i++){
+        args.push_back(call->arg_names[i]->name);
+        if (!may_change(func->body, args[i], &varTracker->get_inline_functions())) continue;
+        std::string copy = varTracker->add_temp_variable();
+        uint8_t reg_arg = varTracker->getReg(results[i]);
+        uint8_t reg_copy = varTracker->getReg(copy);
+        mipsBuilder->addInstruction(new InstrAdd(reg_copy, 0, reg_arg), "");
+        varTracker->set_var_type(copy, varTracker->get_var_type(results[i]));
+        varTracker->set_var_type_refs(copy, varTracker->get_var_type_refs(results[i]));
+        varTracker->removeIfTemp(results[i]);
+        results[i] = copy;
     }
+    varTracker->set_aliases(args, results);
     // compile rest
 
     std::string endLabel = mipsBuilder->genUnnamedLabel();
@@ -826,6 +1024,8 @@ std::string compile_inline_function_call(FunctionCallToken* call, MipsBuilder* m
 
     BreakScope breakScope;
     breakScope.returnLabel = endLabel;
+    // returns convert their value to the function's type, like they do in a function that's called
+    breakScope.returnType = func->refCount == 0 ? func->returnType : TokenValue::INT;
     compile_instructions(&breakScope, func->body->expressions, mipsBuilder, varTracker);
 
     int retvar = -1;
@@ -851,63 +1051,93 @@ std::string compile_inline_function_call(FunctionCallToken* call, MipsBuilder* m
             uint8_t reg = varTracker->getReg(result);
             mipsBuilder->addInstruction(new InstrAdd(reg, 0, 2), "");
         }
+        varTracker->set_var_type(result, call->returnType);
+        varTracker->set_var_type_refs(result, call->returnTypeRefs);
     }
 
     for (const std::string& arg : args){
         varTracker->removeIfTemp(arg);
         varTracker->remove_alias(arg);
     }
-    for (const auto& pair : saved_vars){
-        varTracker->renameVar(pair.second, pair.first);
-    }
 
     return result;
 }
 
-std::string compile_function_call(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
-    auto* call = (FunctionCallToken*) token;
-
-    if (call->is_inline){
-        return compile_inline_function_call(call, mipsBuilder, varTracker);
-    }
-
+std::vector<std::string> compile_call_arguments(FunctionCallToken* call, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     std::vector<std::string> args;
-    std::vector<int> arg_regs;
 
     for (Token* arg : call->arguments){
         std::string name = compile_op("", arg, mipsBuilder, varTracker);
         args.push_back(name);
     }
 
-    // save current registers in scope
+    for (int i = 0; i < args.size() && i < 4; i++){
+        varTracker->reserve_reg(4 + i);
+        mipsBuilder->addInstruction(new InstrAdd(4 + i, 0, varTracker->getReg(args[i])), "");
+        varTracker->removeIfTemp(args[i]);
+    }
+    return args;
+}
+
+// calls a runtime function with variables already compiled as its arguments, which all fit in $4-$7
+void compile_runtime_call(const std::string& name, const std::vector<std::string>& args, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    for (int i = 0; i < args.size(); i++){
+        varTracker->reserve_reg(4 + i);
+        mipsBuilder->addInstruction(new InstrAdd(4 + i, 0, varTracker->getReg(args[i])), "");
+        varTracker->removeIfTemp(args[i]);
+    }
+    varTracker->store_current_regs_in_stack(name);
+    mipsBuilder->addInstruction(new InstrJal(name), "");
+    varTracker->restore_regs_from_stack();
+}
 
-    if (!args.empty()){
-        varTracker->reserve_reg(4);
-        mipsBuilder->addInstruction(new InstrAdd(4, 0, varTracker->getReg(args[0])), "");
-        varTracker->removeIfTemp(args[0]);
+void compile_memory_intrinsic(const std::string& dst, const std::string& src, const std::string& value, Token* size,
+                              MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    bool copy = !src.empty();
+    if (!is_unrolled_memory_size(size)){
+        std::string words = compile_op("", size, mipsBuilder, varTracker);
+        compile_runtime_call(copy ? "memcpy" : "memset", {dst, copy ? src : value, words}, mipsBuilder, varTracker);
+        return;
     }
-    if (args.size() >= 2){
-        varTracker->reserve_reg(5);
-        mipsBuilder->addInstruction(new InstrAdd(5, 0, varTracker->getReg(args[1])), "");
-        varTracker->removeIfTemp(args[1]);
+
+    int words = (int) std::stoll(size->lexeme);
+    std::string temp = copy ? varTracker->add_temp_variable() : value;
+    for (int i = 0; i < words; i++){
+        if (copy){
+            uint8_t reg_temp = varTracker->getReg(temp);
+            mipsBuilder->addInstruction(new InstrLw(reg_temp, varTracker->getReg(src), (int16_t) i), "");
+        }
+        mipsBuilder->addInstruction(new InstrSw(varTracker->getReg(temp), varTracker->getReg(dst), (int16_t) i), "");
     }
-    if (args.size() >= 3){
-        varTracker->reserve_reg(6);
-        mipsBuilder->addInstruction(new InstrAdd(6, 0, varTracker->getReg(args[2])), "");
-        varTracker->removeIfTemp(args[2]);
+    if (copy) varTracker->removeVar(temp);
+    varTracker->removeIfTemp(dst);
+    varTracker->removeIfTemp(copy ? src : value);
+}
+
+std::string compile_function_call(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    auto* call = (FunctionCallToken*) token;
+
+    if (call->is_inline){
+        return compile_inline_function_call(call, mipsBuilder, varTracker);
     }
-    if (args.size() >= 4){
-        varTracker->reserve_reg(7);
-        mipsBuilder->addInstruction(new InstrAdd(7, 0, varTracker->getReg(args[3])), "");
-        varTracker->removeIfTemp(args[3]);
+
+    // done in place unless the program has its own memcpy or memset, which is always called
+    if (is_memory_intrinsic(call, varTracker)){
+        std::string dst = compile_op("", call->arguments[0], mipsBuilder, varTracker);
+        std::string second = compile_op("", call->arguments[1], mipsBuilder, varTracker);
+        bool copy = call->lexeme == "memcpy";
+        compile_memory_intrinsic(dst, copy ? second : "", copy ? "" : second, call->arguments[2], mipsBuilder, varTracker);
+        return "";
     }
 
-    varTracker->store_current_regs_in_stack();
+    std::vector<std::string> args = compile_call_arguments(call, mipsBuilder, varTracker);
+
+    varTracker->store_current_regs_in_stack(call->lexeme);
 
     if (args.size() > 4){
         // load arguments into stack pointer
         int num_args_left = args.size() - 4;
-        varTracker->add_stack_offset(num_args_left);
+        varTracker->reserve_call_args(num_args_left);
         for (int i = 4; i < args.size(); i++){
             mipsBuilder->addInstruction(new InstrSw(varTracker->getReg(args[i]), SP, i - 4), "");
             varTracker->removeIfTemp(args[i]);
@@ -920,7 +1150,7 @@ std::string compile_function_call(Token* token, MipsBuilder* mipsBuilder, Variab
     // bring stack back from arguments
     if (args.size() > 4){
         int num_args_left = args.size() - 4;
-        varTracker->reduce_stack_offset(num_args_left);
+        varTracker->release_call_args(num_args_left);
     }
 
     // restore registers
@@ -948,39 +1178,12 @@ std::string compile_array_access(Token* token, MipsBuilder* mipsBuilder, Variabl
 
     if (refCount == 0) throw std::runtime_error("Variable not array at " + addr->left->toString());
 
-    auto* var_tok = (Token*) addr->left;
-    if (var_tok->val_type == NUMBER_INT) throw std::runtime_error("Cannot dereference a number at " + var_tok->toString());
-    if (var_tok->val_type == FUNCTION) throw std::runtime_error("Cannot dereference a function at " + var_tok->toString());
-    if (var_tok->val_type != IDENTIFIER) throw std::runtime_error("Cannot dereference a non-variable at " + var_tok->toString());
-
-    std::string var = var_tok->lexeme;
-
-    bool use_right_num = false;
-    int right_num;
-
-    if (addr->right->val_type == NUMBER_INT){
-        use_right_num = true;
-        right_num = stoi(addr->right->lexeme);
-    }
-
-    std::string index;
-    if (!use_right_num) {
-        index = compile_op("", addr->right, mipsBuilder, varTracker);
-    }
-
-    int mem_reg = varTracker->getReg(var);
+    ArrayAddress address = compile_array_address(token, mipsBuilder, varTracker);
 
     std::string result = varTracker->add_temp_variable();
     uint8_t reg_result = varTracker->getReg(result);
-
-    if (use_right_num){
-        mipsBuilder->addInstruction(new InstrLw(reg_result, mem_reg, (int16_t) right_num), "");
-    }
-    else {
-        uint8_t offset_reg = varTracker->getReg(index);
-        mipsBuilder->addInstruction(new InstrAdd(offset_reg, offset_reg, mem_reg), "");
-        mipsBuilder->addInstruction(new InstrLw(reg_result, offset_reg, 0), "");
-    }
+    mipsBuilder->addInstruction(new InstrLw(reg_result, address.reg, address.offset), "");
+    if (!address.temp.empty()) varTracker->removeVar(address.temp);
 
     varTracker->set_var_type(result, val_type);
     varTracker->set_var_type_refs(result, refCount - 1);
@@ -988,6 +1191,79 @@ std::string compile_array_access(Token* token, MipsBuilder* mipsBuilder, Variabl
     return result;
 }
 
+// an operator that isn't a call or a condition being jumped on
+std::string compile_operator(Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    switch (token->val_type) {
+        case TokenValue::ADD:
+            return comp_add(token, mipsBuilder, varTracker);
+        case TokenValue::ADD_EQ:
+            return comp_add_eq(token, mipsBuilder, varTracker);
+        case TokenValue::MINUS:
+            return comp_minus_or_minus_eq(false, token, mipsBuilder, varTracker);
+        case TokenValue::MINUS_EQ:
+            return comp_minus_or_minus_eq(true, token, mipsBuilder, varTracker);
+        case TokenValue::MULT:
+            return comp_mult_or_mult_eq(false, token, mipsBuilder, varTracker);
+        case TokenValue::MULT_EQ:
+            return comp_mult_or_mult_eq(true, token, mipsBuilder, varTracker);
+        case TokenValue::DIV:
+            return comp_div_or_div_eq(false, token, mipsBuilder, varTracker);
+        case TokenValue::DIV_EQ:
+            return comp_div_or_div_eq(true, token, mipsBuilder, varTracker);
+        case TokenValue::MOD:
+            return comp_mod_or_mod_eq(false, token, mipsBuilder, varTracker);
+        case TokenValue::MOD_EQ:
+            return comp_mod_or_mod_eq(true, token, mipsBuilder, varTracker);
+        case TokenValue::BIN_AND:
+            return comp_bin_and_or_eq(false, token, mipsBuilder, varTracker);
+        case TokenValue::BIN_AND_EQ:
+            return comp_bin_and_or_eq(true, token, mipsBuilder, varTracker);
+        case TokenValue::BIN_OR:
+            return comp_bin_or_or_eq(false, token, mipsBuilder, varTracker);
+        case TokenValue::BIN_OR_EQ:
+            return comp_bin_or_or_eq(true, token, mipsBuilder, varTracker);
+        case TokenValue::XOR:
+            return comp_xor_or_eq(false, token, mipsBuilder, varTracker);
+        case TokenValue::XOR_EQ:
+            return comp_xor_or_eq(true, token, mipsBuilder, varTracker);
+        case TokenValue::LSHIFT:
+            return comp_sll_or_sll_eq(false, token, mipsBuilder, varTracker);
+        case TokenValue::LSHIFT_EQ:
+            return comp_sll_or_sll_eq(true, token, mipsBuilder, varTracker);
+        case TokenValue::RSHIFT:
+            return comp_sra_or_sra_eq(false, token, mipsBuilder, varTracker);
+        case TokenValue::RSHIFT_EQ:
+            return comp_sra_or_sra_eq(true, token, mipsBuilder, varTracker);
+        case TokenValue::LT:
+            return comp_lt(token, mipsBuilder, varTracker);
+        case TokenValue::LTE:
+            return comp_lte(token, mipsBuilder, varTracker);
+        case TokenValue::GT:
+            return comp_gt(token, mipsBuilder, varTracker);
+        case TokenValue::GTE:
+            return comp_gte(token, mipsBuilder, varTracker);
+        case TokenValue::EQ_EQ:
+            return comp_eq_eq(token, mipsBuilder, varTracker);
+        case TokenValue::NOT:
+            return comp_not(token, mipsBuilder, varTracker);
+        case TokenValue::NOT_EQ:
+            return comp_not_eq(token, mipsBuilder, varTracker);
+        case TokenValue::AND:
+        case TokenValue::OR:
+            return comp_logical(token, mipsBuilder, varTracker);
+        case TokenValue::EQ:
+            return comp_eq(token, mipsBuilder, varTracker);
+        case TokenValue::REF:
+            return comp_ref(token, mipsBuilder, varTracker);
+        case TokenValue::DEREF:
+            return comp_deref(token, mipsBuilder, varTracker);
+        case TokenValue::ARRAY:
+            return compile_array_access(token, mipsBuilder, varTracker);
+        default:
+            throw std::runtime_error("Invalid token value for compile_op");
+    }
+}
+
 std::string compile_op(const std::string& break_to, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
     if (token->type == TokenType::TYPE_OPERATOR){
 
@@ -995,93 +1271,22 @@ std::string compile_op(const std::string& break_to, Token* token, MipsBuilder* m
             return compile_function_call(token, mipsBuilder, varTracker);
         }
 
-        auto* op = (BinaryOpToken*) token;
-        switch (op->val_type) {
-            case TokenValue::ADD:
-                return comp_add(token, mipsBuilder, varTracker);
-            case TokenValue::ADD_EQ:
-                return comp_add_eq(token, mipsBuilder, varTracker);
-            case TokenValue::MINUS:
-                return comp_minus_or_minus_eq(false, token, mipsBuilder, varTracker);
-            case TokenValue::MINUS_EQ:
-                return comp_minus_or_minus_eq(true, token, mipsBuilder, varTracker);
-            case TokenValue::MULT:
-                return comp_mult_or_mult_eq(false, token, mipsBuilder, varTracker);
-            case TokenValue::MULT_EQ:
-                return comp_mult_or_mult_eq(true, token, mipsBuilder, varTracker);
-            case TokenValue::DIV:
-                return comp_div_or_div_eq(false, token, mipsBuilder, varTracker);
-            case TokenValue::DIV_EQ:
-                return comp_div_or_div_eq(true, token, mipsBuilder, varTracker);
-            case TokenValue::BIN_AND:
-                return comp_bin_and_or_eq(false, token, mipsBuilder, varTracker);
-            case TokenValue::BIN_AND_EQ:
-                return comp_bin_and_or_eq(true, token, mipsBuilder, varTracker);
-            case TokenValue::BIN_OR:
-                return comp_bin_or_or_eq(false, token, mipsBuilder, varTracker);
-            case TokenValue::BIN_OR_EQ:
-                return comp_bin_or_or_eq(true, token, mipsBuilder, varTracker);
-            case TokenValue::XOR:
-                return comp_xor_or_eq(false, token, mipsBuilder, varTracker);
-            case TokenValue::XOR_EQ:
-                return comp_xor_or_eq(true, token, mipsBuilder, varTracker);
-            case TokenValue::LSHIFT:
-                return comp_sll_or_sll_eq(false, token, mipsBuilder, varTracker);
-            case TokenValue::LSHIFT_EQ:
-                return comp_sll_or_sll_eq(true, token, mipsBuilder, varTracker);
-            case TokenValue::RSHIFT:
-                return comp_sra_or_sra_eq(false, token, mipsBuilder, varTracker);
-            case TokenValue::RSHIFT_EQ:
-                return comp_sra_or_sra_eq(true, token, mipsBuilder, varTracker);
-            case TokenValue::LT:
-                return comp_lt(break_to, token, mipsBuilder, varTracker);
-            case TokenValue::LTE:
-                return comp_lte(break_to, token, mipsBuilder, varTracker);
-            case TokenValue::GT:
-                return comp_gt(break_to, token, mipsBuilder, varTracker);
-            case TokenValue::GTE:
-                return comp_gte(break_to, token, mipsBuilder, varTracker);
-            case TokenValue::EQ_EQ:
-                return comp_eq_eq(break_to, token, mipsBuilder, varTracker);
-            case TokenValue::NOT:
-                return comp_not(break_to, token, mipsBuilder, varTracker);
-            case TokenValue::NOT_EQ:
-                return comp_not_eq(break_to, token, mipsBuilder, varTracker);
-            case TokenValue::EQ:
-                return comp_eq(token, mipsBuilder, varTracker);
-            case TokenValue::REF:
-                return comp_ref(token, mipsBuilder, varTracker);
-            case TokenValue::DEREF:
-                return comp_deref(token, mipsBuilder, varTracker);
-            case TokenValue::ARRAY:
-                return compile_array_access(token, mipsBuilder, varTracker);
-            default:
-                throw std::runtime_error("Invalid token value for compile_op");
+        // conditions being jumped on
+        if (!break_to.empty() && (inverse_comparison(token->val_type) != NONE || token->val_type == NOT ||
+                                  token->val_type == AND || token->val_type == OR)){
+            compile_branch(true, break_to, token, mipsBuilder, varTracker);
+            return "";
         }
+
+        std::string result = compile_operator(token, mipsBuilder, varTracker);
+        auto* op = (BinaryOpToken*) token;
+        // globals only go back to memory if their register was assigned to since it was loaded
+        if (is_assignment(op->val_type) && op->left->type == TYPE_IDENTIFIER) varTracker->mark_assigned(op->left->lexeme);
+        return result;
     }
     if (token->type == TokenType::TYPE_VALUE){
-        std::string varname = varTracker->add_temp_variable();
-        uint8_t reg = varTracker->getReg(varname);
+        std::string varname = compile_constant(parse_number(token), mipsBuilder, varTracker);
         varTracker->set_var_type(varname, token->val_type == NUMBER_INT ? TokenValue::INT : TokenValue::FLOAT);
-        int32_t value = parse_number(token);
-        if (value < 65536 && value > -65536) {
-            mipsBuilder->addInstruction(new InstrAddi(reg, 0, value), "");
-        }
-        else {
-            // load upper then lower
-            int16_t upper = (int16_t) (value >> 16);
-            int32_t lower = (value & 0x0000FFFF);
-            mipsBuilder->addInstruction(new InstrAddi(reg, 0, upper), "");
-            mipsBuilder->addInstruction(new InstrSll(reg, reg, 16), "");
-            if ((int16_t) lower < 0){
-                int16_t lower_m1 = (lower >> 1) & 0x7FFF;
-                mipsBuilder->addInstruction(new InstrAddi(1, 0, lower_m1), "");
-                mipsBuilder->addInstruction(new InstrSll(1, 1, 1), "");
-                mipsBuilder->addInstruction(new InstrAddi(1, 1, lower%2), "");
-                mipsBuilder->addInstruction(new InstrOr(reg, reg, 1), "");
-            }
-            else mipsBuilder->addInstruction(new InstrAddi(reg, reg, (int16_t) lower), "");
-        }
         return varname;
     }
     if (token->type == TokenType::TYPE_IDENTIFIER && token->val_type == TokenValue::IDENTIFIER){
@@ -24,6 +24,40 @@ MatchTypeResults match_num_types(std::string& var1, std::string& var2, VariableT
 
 std::string force_type(std::string& varHost, std::string& varFollow, VariableTracker* tracker, MipsBuilder* mipsBuilder);
 
+/// Value of a number literal. Floats are 16.16 fixed point
+int32_t parse_number(Token* token);
+
+/// Value of a number literal converted to a float if fixed or an int if not
+int32_t parse_number_as(Token* token, bool fixed);
+
+/// Puts a 32 bit constant in a register. Uses $1 for some values.
+void load_constant(uint8_t reg, int32_t value, MipsBuilder* mipsBuilder);
+
+/// Returns if a token is an int literal
+bool is_int_literal(Token* token);
+
 std::string compile_op(const std::string& break_to, Token* token, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
 
+/// Returns if memcpy or memset of this many words is done in place, without calling the runtime
+bool is_unrolled_memory_size(Token* size);
+
+/// Returns if a call is to memcpy or memset with a size small enough to be done in place, and the program doesn't
+/// define the function itself
+bool is_memory_intrinsic(FunctionCallToken* call, VariableTracker* varTracker);
+
+/// Copies size words from src to dst, one after the other, or sets them to value when src is empty.
+/// A size is_unrolled_memory_size takes is done with a store per word, and anything else calls the runtime,
+/// so a bigger one is only for when the program doesn't define the function itself.
+/// dst, src and value are variables already compiled, which are let go of if they're temporary
+void compile_memory_intrinsic(const std::string& dst, const std::string& src, const std::string& value, Token* size,
+                              MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
+/// Compiles a call's arguments and moves the first four into $4-$7. Returns all of their variables;
+/// the ones past the fourth still have to be passed on the stack.
+std::vector<std::string> compile_call_arguments(FunctionCallToken* call, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
+/// Jumps to label if the condition is true, or if it's false when jump_if is false, and falls through otherwise.
+/// The right side of && and || is only run if it decides where to go.
+void compile_branch(bool jump_if, const std::string& label, Token* condition, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
 #endif //I2C2_OPERATIONSCOMPILER_H
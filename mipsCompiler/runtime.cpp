@@ -0,0 +1,171 @@
+#include "runtime.h"
+
+#include <set>
+#include <vector>
+
+const std::set<std::string> HEAP_FUNCTIONS = {"malloc", "free", "arena_reset"};
+const std::set<std::string> MEMORY_FUNCTIONS = {"memcpy", "memset"};
+
+void declare_runtime(Scope* scope){
+    std::string declarations = "int* malloc(int size);"
+                               "void free(int* p);"
+                               "void arena_reset();"
+                               "void memcpy(int* dst, int* src, int size);"
+                               "void memset(int* dst, int value, int size);";
+    std::vector<Token*> tokens = tokenize(declarations);
+    TokenIterator iter(tokens);
+    parse(iter, scope);
+}
+
+bool is_runtime_function(const std::string& name){
+    return HEAP_FUNCTIONS.find(name) != HEAP_FUNCTIONS.end() || MEMORY_FUNCTIONS.find(name) != MEMORY_FUNCTIONS.end();
+}
+
+// heads is where the free lists start: the one for big blocks, then one for each size up to HEAP_SMALL_WORDS
+void emit_malloc(int heads, MipsBuilder* mipsBuilder){
+    std::string label_small = mipsBuilder->genUnnamedLabel();
+    std::string label_bump = mipsBuilder->genUnnamedLabel();
+    std::string label_reuse = mipsBuilder->genUnnamedLabel();
+    std::string label_big = mipsBuilder->genUnnamedLabel();
+    std::string label_check = mipsBuilder->genUnnamedLabel();
+    std::string label_fits = mipsBuilder->genUnnamedLabel();
+    std::string label_next = mipsBuilder->genUnnamedLabel();
+    std::string label_none = mipsBuilder->genUnnamedLabel();
+
+    mipsBuilder->addInstruction(new InstrAddi(1, 0, HEAP_SMALL_WORDS), "malloc");
+    mipsBuilder->addInstruction(new InstrBlt(1, 4, label_big), "");
+    mipsBuilder->addInstruction(new InstrBlt(0, 4, label_small), "");
+    mipsBuilder->addInstruction(new InstrAdd(2, 0, 0), label_none);
+    mipsBuilder->addInstruction(new InstrJr(31), "");
+
+    // the free list for the size, if it has a block
+    mipsBuilder->addInstruction(new InstrLw(2, 4, (int16_t) heads), label_small);
+    mipsBuilder->addInstruction(new InstrBne(2, 0, label_reuse), "");
+
+    // otherwise the block goes at the top of the heap
+    mipsBuilder->addInstruction(new InstrAddi(2, 28, 1), label_bump);
+    mipsBuilder->addInstruction(new InstrAdd(1, 2, 4), "");
+    mipsBuilder->addInstruction(new InstrBlt(29, 1, label_none), "");
+    mipsBuilder->addInstruction(new InstrSw(4, 28, 0), "");
+    mipsBuilder->addInstruction(new InstrAdd(28, 0, 1), "");
+    mipsBuilder->addInstruction(new InstrJr(31), "");
+
+    // a free block keeps the next one in its first word
+    mipsBuilder->addInstruction(new InstrLw(1, 2, 0), label_reuse);
+    mipsBuilder->addInstruction(new InstrSw(1, 4, (int16_t) heads), "");
+    mipsBuilder->addInstruction(new InstrJr(31), "");
+
+    // big blocks take the first free one with room. $5 is the word that points to the block being looked at
+    mipsBuilder->addInstruction(new InstrAddi(5, 0, (int16_t) heads), label_big);
+    mipsBuilder->addInstruction(new InstrLw(2, 5, 0), label_check);
+    mipsBuilder->addInstruction(new InstrBne(2, 0, label_fits), "");
+    mipsBuilder->addInstruction(new InstrJ(label_bump), "");
+    mipsBuilder->addInstruction(new InstrLw(1, 2, -1), label_fits);
+    mipsBuilder->addInstruction(new InstrBlt(1, 4, label_next), "");
+    mipsBuilder->addInstruction(new InstrLw(1, 2, 0), "");
+    mipsBuilder->addInstruction(new InstrSw(1, 5, 0), "");
+    mipsBuilder->addInstruction(new InstrJr(31), "");
+    mipsBuilder->addInstruction(new InstrAdd(5, 0, 2), label_next);
+    mipsBuilder->addInstruction(new InstrJ(label_check), "");
+}
+
+void emit_free(int heads, MipsBuilder* mipsBuilder){
+    std::string label_block = mipsBuilder->genUnnamedLabel();
+    std::string label_push = mipsBuilder->genUnnamedLabel();
+    std::string label_big = mipsBuilder->genUnnamedLabel();
+
+    mipsBuilder->addInstruction(new InstrBne(4, 0, label_block), "free");
+    mipsBuilder->addInstruction(new InstrJr(31), "");
+    mipsBuilder->addInstruction(new InstrLw(1, 4, -1), label_block);
+    mipsBuilder->addInstruction(new InstrAddi(2, 0, HEAP_SMALL_WORDS), "");
+    mipsBuilder->addInstruction(new InstrBlt(2, 1, label_big), "");
+    mipsBuilder->addInstruction(new InstrLw(2, 1, (int16_t) heads), label_push);
+    mipsBuilder->addInstruction(new InstrSw(2, 4, 0), "");
+    mipsBuilder->addInstruction(new InstrSw(4, 1, (int16_t) heads), "");
+    mipsBuilder->addInstruction(new InstrJr(31), "");
+    // big blocks all go on the first list
+    mipsBuilder->addInstruction(new InstrAdd(1, 0, 0), label_big);
+    mipsBuilder->addInstruction(new InstrJ(label_push), "");
+}
+
+void emit_arena_reset(int heads, int heap_start, MipsBuilder* mipsBuilder){
+    mipsBuilder->addInstruction(new InstrAddi(28, 0, (int16_t) heap_start), "arena_reset");
+    for (int i = 0; i <= HEAP_SMALL_WORDS; i++){
+        mipsBuilder->addInstruction(new InstrSw(0, 0, (int16_t) (heads + i)), "");
+    }
+    mipsBuilder->addInstruction(new InstrJr(31), "");
+}
+
+// memcpy and memset go four words at a time while they can, then one at a time. $4 is dst and $6 the words left
+void emit_memory_function(const std::string& name, MipsBuilder* mipsBuilder){
+    bool copy = name == "memcpy";
+    std::string label_four = mipsBuilder->genUnnamedLabel();
+    std::string label_left = mipsBuilder->genUnnamedLabel();
+    std::string label_one = mipsBuilder->genUnnamedLabel();
+
+    mipsBuilder->addInstruction(new InstrAddi(1, 0, 3), name);
+    mipsBuilder->addInstruction(new InstrBlt(1, 6, label_four), "");
+    mipsBuilder->addInstruction(new InstrBlt(0, 6, label_one), label_left);
+    mipsBuilder->addInstruction(new InstrJr(31), "");
+
+    if (copy){
+        mipsBuilder->addInstruction(new InstrLw(7, 5, 0), label_one);
+        mipsBuilder->addInstruction(new InstrAddi(5, 5, 1), "");
+        mipsBuilder->addInstruction(new InstrSw(7, 4, 0), "");
+    }
+    else mipsBuilder->addInstruction(new InstrSw(5, 4, 0), label_one);
+    mipsBuilder->addInstruction(new InstrAddi(4, 4, 1), "");
+    mipsBuilder->addInstruction(new InstrAddi(6, 6, -1), "");
+    mipsBuilder->addInstruction(new InstrJ(label_left), "");
+
+    // each word is stored before the next is loaded, so a copy between overlapping words does what a loop would
+    for (int i = 0; i < 4; i++){
+        std::string label = i == 0 ? label_four : "";
+        if (copy){
+            mipsBuilder->addInstruction(new InstrLw(7, 5, (int16_t) i), label);
+            mipsBuilder->addInstruction(new InstrSw(7, 4, (int16_t) i), "");
+        }
+        else mipsBuilder->addInstruction(new InstrSw(5, 4, (int16_t) i), label);
+    }
+    if (copy) mipsBuilder->addInstruction(new InstrAddi(5, 5, 4), "");
+    mipsBuilder->addInstruction(new InstrAddi(4, 4, 4), "");
+    mipsBuilder->addInstruction(new InstrAddi(6, 6, -4), "");
+    mipsBuilder->addInstruction(new InstrBlt(1, 6, label_four), "");
+    mipsBuilder->addInstruction(new InstrJ(label_left), "");
+}
+
+void link_runtime(MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    std::map<std::string, Instruction*> labels = mipsBuilder->getLabels();
+    std::set<std::string> called;
+    for (Instruction* instr : mipsBuilder->getInstructions()){
+        if (instr->type != I_JAL && instr->type != I_J) continue;
+        std::string target = instr->get_target();
+        if (is_runtime_function(target) && labels.find(target) == labels.end()) called.insert(target);
+    }
+    if (called.empty()) return;
+
+    // the runtime goes after everything else, where the program would otherwise end
+    std::string after_runtime = mipsBuilder->genUnnamedLabel();
+    mipsBuilder->addInstruction(new InstrJ(after_runtime), "");
+
+    for (const std::string& name : MEMORY_FUNCTIONS){
+        if (called.find(name) != called.end()) emit_memory_function(name, mipsBuilder);
+    }
+
+    bool heap = false;
+    for (const std::string& name : HEAP_FUNCTIONS) heap |= called.find(name) != called.end();
+    if (heap){
+        int heads = varTracker->reserve_memory(HEAP_SMALL_WORDS + 1);
+        // the free lists start out empty, in the data image or before anything else runs
+        for (int i = 0; i <= HEAP_SMALL_WORDS; i++){
+            if (varTracker->has_data_image()) varTracker->set_static_word(heads + i, 0);
+            else mipsBuilder->prependInstruction(new InstrSw(0, 0, (int16_t) (heads + i)));
+        }
+
+        if (called.find("malloc") != called.end()) emit_malloc(heads, mipsBuilder);
+        if (called.find("free") != called.end()) emit_free(heads, mipsBuilder);
+        if (called.find("arena_reset") != called.end()) emit_arena_reset(heads, varTracker->get_mem_offset(), mipsBuilder);
+    }
+
+    mipsBuilder->addInstruction(new InstrAdd(0, 0, 0), after_runtime);
+}
@@ -0,0 +1,44 @@
+#ifndef I2C2_RUNTIME_H
+#define I2C2_RUNTIME_H
+
+#include <string>
+
+#include "../parsing/parse.h"
+#include "MipsBuilder.h"
+#include "VariableTracker.h"
+
+// blocks of up to this many words each have a free list of their own. bigger ones share one
+#ifndef HEAP_SMALL_WORDS
+#define HEAP_SMALL_WORDS 16
+#endif
+
+// memcpy and memset of a size known at compile time, up to this many words, are done in place instead of calling these
+#ifndef MEMORY_UNROLL_WORDS
+#define MEMORY_UNROLL_WORDS 16
+#endif
+
+/*
+ The runtime is written in mips and added to a program only if it calls one of these without defining it:
+
+     int* malloc(int size);   // size words, or 0 if size isn't positive or the heap would reach the stack
+     void free(int* p);       // p from malloc, or 0
+     void arena_reset();      // frees every block at once, like starting over
+     void memcpy(int* dst, int* src, int size);   // copies size words, one after the other from the first
+     void memset(int* dst, int value, int size);  // sets size words to value
+
+ The heap starts at $28 and grows up towards the stack. Each block has a word before it that holds its size.
+ A freed block goes on the free list for its size, where the next malloc of that size finds it,
+ so a program that allocates the same few sizes over and over never runs out.
+ */
+
+/// Declares the runtime's functions, so programs can call them without declaring them first
+void declare_runtime(Scope* scope);
+
+/// Returns if a function is part of the runtime, which uses no globals
+bool is_runtime_function(const std::string& name);
+
+/// Adds the runtime functions the program calls but doesn't define, and sets aside the memory they use.
+/// Anything that sets aside memory after this ends up in the heap, so this goes last, before $28 is set
+void link_runtime(MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
+#endif //I2C2_RUNTIME_H
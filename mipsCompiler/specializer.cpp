@@ -0,0 +1,343 @@
+#include "specializer.h"
+#include "astAnalysis.h"
+#include "MipsCompiler.h"
+
+#include <algorithm>
+#include <set>
+
+Token* int_literal(int32_t value, int line){
+    return new Token(TYPE_VALUE, NUMBER_INT, std::to_string(value), line);
+}
+
+bool literal_value(Token* token, int32_t* value){
+    if (token == nullptr || token->type != TYPE_VALUE || token->val_type != NUMBER_INT) return false;
+    *value = (int32_t) std::stoll(token->lexeme);
+    return true;
+}
+
+// what an operation on int literals comes out to, the way the processor would compute it
+bool fold_constants(TokenValue op, int32_t a, int32_t b, int32_t* result){
+    auto wrap = [](int64_t v){ return (int32_t) (uint32_t) (uint64_t) v; };
+    switch (op) {
+        case ADD: *result = wrap((int64_t) a + b); return true;
+        case MINUS: *result = wrap((int64_t) a - b); return true;
+        case MULT: *result = wrap((int64_t) a * b); return true;
+        case DIV:
+            if (b == 0 || (a == INT32_MIN && b == -1)) return false;
+            *result = a / b;
+            return true;
+        case MOD:
+            if (b == 0 || (a == INT32_MIN && b == -1)) return false;
+            *result = a % b;
+            return true;
+        case BIN_AND: *result = a & b; return true;
+        case BIN_OR: *result = a | b; return true;
+        case XOR: *result = a ^ b; return true;
+        case LSHIFT:
+            if (b < 0 || b > 31) return false;
+            *result = (int32_t) ((uint32_t) a << b);
+            return true;
+        case RSHIFT:
+            if (b < 0 || b > 31) return false;
+            *result = a >> b;
+            return true;
+        case LT: *result = a < b; return true;
+        case LTE: *result = a <= b; return true;
+        case GT: *result = a > b; return true;
+        case GTE: *result = a >= b; return true;
+        case EQ_EQ: *result = a == b; return true;
+        case NOT_EQ: *result = a != b; return true;
+        case AND: *result = a && b; return true;
+        case OR: *result = a || b; return true;
+        default: return false;
+    }
+}
+
+Token* copy_with_constants(Token* token, const std::map<std::string, int32_t>& constants){
+    if (token == nullptr) return nullptr;
+    auto copy_all = [&](std::vector<Token*>& tokens){
+        for (Token*& t : tokens) t = copy_with_constants(t, constants);
+    };
+
+    if (token->type == TYPE_IDENTIFIER){
+        auto it = constants.find(token->lexeme);
+        if (it != constants.end()) return int_literal(it->second, token->line);
+        return new Token(*token);
+    }
+    if (token->type == TYPE_GROUP){
+        auto* copy = new GroupToken(*(GroupToken*) token);
+        copy_all(copy->expressions);
+        return copy;
+    }
+    if (token->type == TYPE_VALUE){
+        if (token->val_type != ARRAY) return new Token(*token);
+        auto* copy = new ArrayInitializationToken(*(ArrayInitializationToken*) token);
+        copy_all(copy->values);
+        return copy;
+    }
+    if (token->type == TYPE_OPERATOR){
+        if (token->val_type == IDENTIFIER){
+            auto* copy = new DefinitionToken(*(DefinitionToken*) token);
+            copy->value = copy_with_constants(copy->value, constants);
+            copy_all(copy->dimensions);
+            return copy;
+        }
+        if (token->val_type == FUNCTION){
+            auto* copy = new FunctionCallToken(*(FunctionCallToken*) token);
+            copy_all(copy->arguments);
+            return copy;
+        }
+        auto* copy = new BinaryOpToken(*(BinaryOpToken*) token);
+        copy->left = copy_with_constants(copy->left, constants);
+        copy->right = copy_with_constants(copy->right, constants);
+
+        int32_t a, b, result;
+        bool folded = false;
+        if (copy->left == nullptr && copy->val_type == NOT && literal_value(copy->right, &b)){
+            result = !b;
+            folded = true;
+        }
+        else if (literal_value(copy->left, &a) && literal_value(copy->right, &b)){
+            folded = fold_constants(copy->val_type, a, b, &result);
+        }
+        if (!folded) return copy;
+        Token* literal = int_literal(result, copy->line);
+        delete copy->left;
+        delete copy->right;
+        delete copy;
+        return literal;
+    }
+    if (token->type != TYPE_KEYWORD) return new Token(*token);
+
+    switch (token->val_type) {
+        case IF: {
+            auto* copy = new IfElseToken(*(IfElseToken*) token);
+            copy->condition = copy_with_constants(copy->condition, constants);
+            copy_all(copy->elseIfConditions);
+            copy->ifBody = (GroupToken*) copy_with_constants(copy->ifBody, constants);
+            for (GroupToken*& body : copy->elseIfBodies) body = (GroupToken*) copy_with_constants(body, constants);
+            copy->elseBody = (GroupToken*) copy_with_constants(copy->elseBody, constants);
+            return copy;
+        }
+        case FOR: {
+            auto* copy = new ForToken(*(ForToken*) token);
+            copy->init = copy_with_constants(copy->init, constants);
+            copy->condition = copy_with_constants(copy->condition, constants);
+            copy->increment = copy_with_constants(copy->increment, constants);
+            copy->body = (GroupToken*) copy_with_constants(copy->body, constants);
+            return copy;
+        }
+        case WHILE: {
+            auto* copy = new WhileToken(*(WhileToken*) token);
+            copy->condition = copy_with_constants(copy->condition, constants);
+            copy->body = (GroupToken*) copy_with_constants(copy->body, constants);
+            return copy;
+        }
+        case SWITCH: {
+            auto* copy = new SwitchToken(*(SwitchToken*) token);
+            copy->value = copy_with_constants(copy->value, constants);
+            copy->body = (GroupToken*) copy_with_constants(copy->body, constants);
+            return copy;
+        }
+        case RETURN: {
+            auto* copy = new ReturnToken(*(ReturnToken*) token);
+            copy->value = copy_with_constants(copy->value, constants);
+            return copy;
+        }
+        case ASM:
+            return new AsmToken(*(AsmToken*) token);
+        case FUNCTION:
+            // definitions aren't entered anywhere else either
+            return token;
+        default:
+            return new Token(*token);
+    }
+}
+
+// the calls that pass the same literals to a function
+struct ConstantSignature{
+    std::map<int, int32_t> constants;   // parameter index to value
+    std::vector<FunctionCallToken*> calls;
+};
+
+std::string clone_name(const std::string& function, const ConstantSignature& signature,
+                       const std::map<std::string, FunctionToken*>& functions){
+    std::string name = function;
+    for (const auto& [index, value] : signature.constants){
+        name += "_" + (value < 0 ? "m" + std::to_string(-(int64_t) value) : std::to_string(value));
+    }
+    while (functions.find(name) != functions.end()) name += "_";
+    return name;
+}
+
+// identifiers in the conditions of ifs and loops, and the values switches go on
+std::set<std::string> condition_identifiers(Token* body){
+    std::set<std::string> ids;
+    for_each_token(body, [&](Token* t){
+        if (t->type != TYPE_KEYWORD) return;
+        if (t->val_type == IF){
+            auto* if_statement = (IfElseToken*) t;
+            collect_identifiers(if_statement->condition, ids);
+            for (Token* condition : if_statement->elseIfConditions) collect_identifiers(condition, ids);
+        }
+        else if (t->val_type == FOR) collect_identifiers(((ForToken*) t)->condition, ids);
+        else if (t->val_type == WHILE) collect_identifiers(((WhileToken*) t)->condition, ids);
+        else if (t->val_type == SWITCH) collect_identifiers(((SwitchToken*) t)->value, ids);
+    });
+    return ids;
+}
+
+// a copy is worth it if it replaces the function, is shared by more than one call,
+// or fixes which way a branch or loop goes. otherwise it only saves an instruction or two per call
+bool pays_off(FunctionToken* function, const ConstantSignature& signature, int total_calls){
+    if (signature.calls.size() == total_calls || signature.calls.size() > 1) return true;
+    std::set<std::string> ids = condition_identifiers(function->body);
+    for (const auto& [index, value] : signature.constants){
+        if (ids.count(function->parameters[index]->name) > 0) return true;
+    }
+    return false;
+}
+
+// removable is every function that has been copied or is a copy. the ones with no calls left are taken out
+std::vector<Specialization> specialize_round(std::vector<Token*>& ast, std::set<std::string>& removable, VariableTracker* varTracker){
+    std::map<std::string, FunctionToken*> functions;
+    std::vector<Token*> code;
+    std::string asm_code;
+
+    for (Token* token : ast){
+        if (token->type == TYPE_KEYWORD && token->val_type == FUNCTION){
+            auto* function = (FunctionToken*) token;
+            functions[function->name] = function;
+            if (function->is_inline) varTracker->add_inline_function(function->name, function);
+            if (function->body != nullptr) code.push_back(function->body);
+        }
+        else code.push_back(token);
+    }
+    int program_size = estimate_program_size(ast, varTracker);
+
+    // the parameters each function reads and never changes
+    std::map<std::string, std::vector<bool>> replaceable;
+    for (const auto& [name, function] : functions){
+        if (function->is_inline || function->body == nullptr || name == "main") continue;
+        // copies of a function that calls itself would go on making more copies
+        bool recursive = false;
+        for_each_token(function->body, [&](Token* t){
+            if (t->type == TYPE_OPERATOR && t->val_type == FUNCTION && t->lexeme == name) recursive = true;
+        });
+        if (recursive) continue;
+        std::set<std::string> used;
+        collect_identifiers(function->body, used);
+        for (DefinitionToken* param : function->parameters){
+            replaceable[name].push_back(param->valueType == INT && param->refCount == 0 && used.count(param->name) > 0 &&
+                                        !may_change(function->body, param->name));
+        }
+    }
+
+    std::map<std::string, std::vector<ConstantSignature>> signatures;
+    std::map<std::string, int> total_calls;
+    for (Token* token : code){
+        for_each_token(token, [&](Token* t){
+            if (t->type == TYPE_KEYWORD && t->val_type == ASM) asm_code += ((AsmToken*) t)->asmCode;
+            if (t->type != TYPE_OPERATOR || t->val_type != FUNCTION) return;
+            auto* call = (FunctionCallToken*) t;
+            if (call->is_inline || replaceable.find(call->lexeme) == replaceable.end()) return;
+            total_calls[call->lexeme]++;
+
+            std::map<int, int32_t> constants;
+            const std::vector<bool>& can_replace = replaceable[call->lexeme];
+            for (int i = 0; i < call->arguments.size() && i < can_replace.size(); i++){
+                int32_t value;
+                if (can_replace[i] && literal_value(call->arguments[i], &value)) constants[i] = value;
+            }
+            if (constants.empty()) return;
+
+            std::vector<ConstantSignature>& same_function = signatures[call->lexeme];
+            auto it = std::find_if(same_function.begin(), same_function.end(), [&](const ConstantSignature& s){
+                return s.constants == constants;
+            });
+            if (it == same_function.end()) same_function.push_back({constants, {call}});
+            else it->calls.push_back(call);
+        });
+    }
+
+    std::vector<Specialization> made;
+    int growth = 0;
+    for (auto& [name, function_signatures] : signatures){
+        FunctionToken* function = functions[name];
+        int size = estimate_size(function->body, varTracker);
+        if (size > SPECIALIZE_MAX_SIZE) continue;
+
+        std::stable_sort(function_signatures.begin(), function_signatures.end(), [](const ConstantSignature& a, const ConstantSignature& b){
+            return a.calls.size() > b.calls.size();
+        });
+        for (int s = 0; s < function_signatures.size() && s < SPECIALIZE_MAX_CLONES; s++){
+            ConstantSignature& signature = function_signatures[s];
+            if (!pays_off(function, signature, total_calls[name])) continue;
+            if (program_size + growth + size > SPECIALIZE_IMEM_BUDGET) break;
+            growth += size;
+
+            std::map<std::string, int32_t> constants;
+            std::string described;
+            std::vector<DefinitionToken*> parameters;
+            for (int i = 0; i < function->parameters.size(); i++){
+                DefinitionToken* param = function->parameters[i];
+                if (signature.constants.find(i) == signature.constants.end()){
+                    parameters.push_back(param);
+                    continue;
+                }
+                constants[param->name] = signature.constants[i];
+                described += (described.empty() ? "" : ", ") + param->name + " = " + std::to_string(signature.constants[i]);
+            }
+
+            auto* clone = new FunctionToken(*function);
+            clone->name = clone_name(name, signature, functions);
+            clone->parameters = parameters;
+            clone->body = (GroupToken*) copy_with_constants(function->body, constants);
+            functions[clone->name] = clone;
+            ast.insert(std::find(ast.begin(), ast.end(), (Token*) function) + 1, clone);
+
+            for (FunctionCallToken* call : signature.calls){
+                call->lexeme = clone->name;
+                call->arg_names = parameters;
+                for (auto it = signature.constants.rbegin(); it != signature.constants.rend(); it++){
+                    call->arguments.erase(call->arguments.begin() + it->first);
+                }
+            }
+            removable.insert(name);
+            removable.insert(clone->name);
+            made.push_back({name, clone->name, (int) signature.calls.size(), described});
+        }
+    }
+
+    // a function with every call moved to its copies isn't needed, unless a copy or asm still calls it.
+    // neither is a copy whose calls were all in a function that was copied again
+    std::set<std::string> still_called;
+    for (Token* token : ast){
+        Token* body = token;
+        if (token->type == TYPE_KEYWORD && token->val_type == FUNCTION) body = ((FunctionToken*) token)->body;
+        for_each_token(body, [&](Token* t){
+            if (t->type == TYPE_OPERATOR && t->val_type == FUNCTION) still_called.insert(t->lexeme);
+        });
+    }
+    for (auto it = removable.begin(); it != removable.end();){
+        if (still_called.count(*it) > 0 || asm_code.find(*it) != std::string::npos){
+            it++;
+            continue;
+        }
+        ast.erase(std::find(ast.begin(), ast.end(), (Token*) functions[*it]));
+        it = removable.erase(it);
+    }
+    return made;
+}
+
+std::vector<Specialization> specialize_functions(std::vector<Token*>& ast, VariableTracker* varTracker){
+    // the calls in a copy can pass new constants along
+    std::vector<Specialization> made;
+    std::set<std::string> removable;
+    for (int round = 0; round < SPECIALIZE_ROUNDS; round++){
+        std::vector<Specialization> more = specialize_round(ast, removable, varTracker);
+        if (more.empty()) break;
+        made.insert(made.end(), more.begin(), more.end());
+    }
+    return made;
+}
@@ -0,0 +1,48 @@
+#ifndef I2C2_SPECIALIZER_H
+#define I2C2_SPECIALIZER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../parsing/tokenTypes.h"
+#include "VariableTracker.h"
+
+// functions bigger than this aren't copied, and at most SPECIALIZE_MAX_CLONES copies are made of each one
+#ifndef SPECIALIZE_MAX_SIZE
+#define SPECIALIZE_MAX_SIZE 64
+#endif
+
+#ifndef SPECIALIZE_MAX_CLONES
+#define SPECIALIZE_MAX_CLONES 4
+#endif
+
+// copies of copies are made this many times over, for the constants they pass on
+#ifndef SPECIALIZE_ROUNDS
+#define SPECIALIZE_ROUNDS 3
+#endif
+
+// copies stop once the program would grow past this much of the 4096 word imem
+#ifndef SPECIALIZE_IMEM_BUDGET
+#define SPECIALIZE_IMEM_BUDGET 2048
+#endif
+
+/// A copy of a function made for the calls that pass it the same constants
+struct Specialization{
+    std::string function;
+    std::string clone;
+    int calls;
+    std::string constants;  // like "pin = 4, level = 1"
+};
+
+/// Copies a parse tree. Identifiers named in constants become int literals, and operations on int literals are folded.
+Token* copy_with_constants(Token* token, const std::map<std::string, int32_t>& constants);
+
+/// Gives calls that pass int literals to a function their own copy of it, where the parameters they fix are literals,
+/// as long as the function reads them and never changes them. The calls that pass the same literals most often
+/// get copies first, and calls in the copies get their own copies too. Functions that call themselves aren't copied.
+/// A function left with no calls isn't compiled, unless asm may still jal to it.
+/// Runs on the output of sort_ast, before auto_inline.
+std::vector<Specialization> specialize_functions(std::vector<Token*>& ast, VariableTracker* varTracker);
+
+#endif //I2C2_SPECIALIZER_H
@@ -0,0 +1,88 @@
+#include "stackFrame.h"
+#include "astAnalysis.h"
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+struct FrameNeeds{
+    // the most arguments past the fourth a call passes
+    int call_args = 0;
+    // locals whose address is taken. each keeps its word until the function returns
+    int address_slots = 0;
+};
+
+// words an array definition takes, or 0 if it isn't one. lengths that aren't numbers are reported when it's compiled
+int array_length(Token* token){
+    if (token == nullptr || token->type != TYPE_OPERATOR || token->val_type != IDENTIFIER) return 0;
+    auto* def = (DefinitionToken*) token;
+    if (def->dimensions.empty()) return 0;
+    int length = 1;
+    for (Token* i : def->dimensions){
+        if (i->type != TYPE_VALUE || i->val_type != NUMBER_INT) return 0;
+        length *= std::stoi(i->lexeme);
+    }
+    return length;
+}
+
+// most words the arrays of a list of statements and the blocks inside it take at once.
+// compile_instructions gives back a list's words when it's done, so blocks next to each other share theirs
+int array_words(const std::vector<Token*>& statements, VariableTracker* varTracker){
+    int defined = 0;
+    int most = 0;
+    for (Token* statement : statements){
+        defined += array_length(statement);
+        // a for loop's init belongs to the list around it
+        if (statement->type == TYPE_KEYWORD && statement->val_type == FOR)
+            defined += array_length(((ForToken*) statement)->init);
+
+        // a block inside another is counted again on its own, which is never more than the one around it
+        int inner = 0;
+        for_each_token(statement, [&](Token* t){
+            if (t->type == TYPE_GROUP) inner = std::max(inner, array_words(((GroupToken*) t)->expressions, varTracker));
+            if (t->type == TYPE_OPERATOR && t->val_type == FUNCTION && ((FunctionCallToken*) t)->is_inline){
+                FunctionToken* callee = varTracker->get_inline_function(t->lexeme);
+                inner = std::max(inner, array_words(callee->body->expressions, varTracker));
+            }
+        });
+        most = std::max(most, defined + inner);
+    }
+    return most;
+}
+
+void count_frame_needs(GroupToken* body, const std::vector<DefinitionToken*>& parameters, VariableTracker* varTracker,
+                       FrameNeeds& result){
+    std::set<std::string> locals;
+    for (DefinitionToken* param : parameters) locals.insert(param->name);
+    std::set<std::string> taken;
+    for_each_token(body, [&](Token* t){
+        if (t->type != TYPE_OPERATOR) return;
+        if (t->val_type == IDENTIFIER) locals.insert(((DefinitionToken*) t)->name);
+        else if (t->val_type == REF){
+            Token* value = ((BinaryOpToken*) t)->right;
+            if (value != nullptr && value->val_type == IDENTIFIER) taken.insert(value->lexeme);
+        }
+        else if (t->val_type == FUNCTION){
+            auto* call = (FunctionCallToken*) t;
+            if (!call->is_inline){
+                result.call_args = std::max(result.call_args, (int) call->arguments.size() - 4);
+                return;
+            }
+            // every inline call is compiled into its own copy of the body, with its own variables
+            FunctionToken* callee = varTracker->get_inline_function(call->lexeme);
+            count_frame_needs(callee->body, callee->parameters, varTracker, result);
+        }
+    });
+    // a global's address is where it already is in memory
+    for (const std::string& name : taken){
+        if (locals.find(name) != locals.end()) result.address_slots++;
+    }
+}
+
+void plan_frame(FunctionToken* function, VariableTracker* varTracker){
+    FrameNeeds needs;
+    count_frame_needs(function->body, function->parameters, varTracker, needs);
+    int arrays = array_words(function->body->expressions, varTracker);
+    varTracker->set_frame_layout(needs.call_args, needs.address_slots, arrays);
+}
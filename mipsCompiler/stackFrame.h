@@ -0,0 +1,16 @@
+#ifndef I2C2_STACKFRAME_H
+#define I2C2_STACKFRAME_H
+
+#include "../parsing/tokenTypes.h"
+#include "VariableTracker.h"
+
+/// Works out how much of the stack a function needs before compiling it, and gives the tracker its layout.
+/// From the stack pointer up, the frame holds the arguments past the fourth of the calls it makes, a word for each
+/// local whose address is taken, and the arrays it defines. Blocks that can't run at the same time share the same
+/// words for their arrays, so that part only needs as much as the deepest set of blocks.
+/// Inline functions it calls count as if their body was written where they're called.
+/// The registers saved across calls go on top, so the whole frame is reserved and freed with one move of $29.
+/// To use on entry, after the function's parameters are added.
+void plan_frame(FunctionToken* function, VariableTracker* varTracker);
+
+#endif //I2C2_STACKFRAME_H
@@ -0,0 +1,236 @@
+#include "strengthReduction.h"
+#include "operationsCompiler.h"
+
+#include <algorithm>
+#include <vector>
+#include <utility>
+
+struct Reciprocal{
+    int32_t magic;
+    int shift;
+};
+
+// non-zero digits of value written with digits -1, 0, 1 (so runs of ones become two digits), highest first
+std::vector<std::pair<int, int>> signed_digits(int64_t value){
+    std::vector<std::pair<int, int>> digits;
+    for (int bit = 0; value != 0; bit++, value /= 2){
+        if (value % 2 == 0) continue;
+        int digit = value % 4 == 1 ? 1 : -1;
+        digits.insert(digits.begin(), {bit, digit});
+        value -= digit;
+    }
+    return digits;
+}
+
+int load_constant_cost(int32_t value){
+    if (value < 65536 && value > -65536) return 1;
+    return (int16_t) (value & 0xFFFF) < 0 ? 6 : 3;
+}
+
+bool is_power_of_2(int64_t value){
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+int floor_log2(int64_t value){
+    int k = 0;
+    while (value > 1){
+        value /= 2;
+        k++;
+    }
+    return k;
+}
+
+// magic number and shift so that n / d = (n * magic >> 32 (+ n if magic < 0)) >> shift, rounded towards 0.
+// from Hacker's Delight, section 10-4
+Reciprocal signed_reciprocal(int32_t d){
+    const uint32_t two31 = 0x80000000;
+    auto ad = (uint32_t) d;
+    uint32_t anc = two31 - 1 - two31 % ad;
+    int p = 31;
+    uint32_t q1 = two31 / anc;
+    uint32_t r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad;
+    uint32_t r2 = two31 - q2 * ad;
+    uint32_t delta;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc){
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad){
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    return {(int32_t) (q2 + 1), p - 32};
+}
+
+// hmul only returns bits 16-47 of the product, so the top half of n * magic is put together
+// from n * low and n * high with magic = high * 2^16 + low
+void split_magic(int32_t magic, int32_t* high, int32_t* low){
+    *low = (int16_t) (magic & 0xFFFF);
+    *high = (int32_t) (((int64_t) magic - *low) >> 16);
+}
+
+int mult_by_constant_cost(int32_t value){
+    if (value == 0) return 1;
+    std::vector<std::pair<int, int>> digits = signed_digits(value < 0 ? -(int64_t) value : value);
+    int lowest = digits.back().first;
+    int cost = 2 * ((int) digits.size() - 1);
+    if (lowest > 0 || digits.size() == 1) cost++;
+    if (value < 0) cost++;
+    return cost;
+}
+
+int reciprocal_div_cost(int32_t value){
+    Reciprocal r = signed_reciprocal(value);
+    int32_t high, low;
+    split_magic(r.magic, &high, &low);
+    int high_cost = std::min(mult_by_constant_cost(high), MUL_CYCLES + load_constant_cost(high));
+    return load_constant_cost(low) + load_constant_cost(high) + 2 * MUL_CYCLES + high_cost + 6 +
+           (r.magic < 0) + (r.shift > 0) + 2;
+}
+
+void emit_mult_by_constant(uint8_t rd, uint8_t rs, int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    if (mult_by_constant_cost(value) > MUL_CYCLES){
+        std::string constant = varTracker->add_temp_variable();
+        uint8_t reg_constant = varTracker->getReg(constant);
+        load_constant(reg_constant, value, mipsBuilder);
+        mipsBuilder->addInstruction(new InstrMul(rd, rs, reg_constant), "");
+        varTracker->removeVar(constant);
+        return;
+    }
+    if (value == 0){
+        mipsBuilder->addInstruction(new InstrAdd(rd, 0, 0), "");
+        return;
+    }
+
+    // horner's method: shift what's there so far up to the next digit, then add or subtract rs
+    std::vector<std::pair<int, int>> digits = signed_digits(value < 0 ? -(int64_t) value : value);
+    int lowest = digits.back().first;
+    uint8_t acc = rd != rs ? rd : 1;
+    uint8_t current = rs;
+    for (int i = 1; i < digits.size(); i++){
+        mipsBuilder->addInstruction(new InstrSll(acc, current, digits[i - 1].first - digits[i].first), "");
+        uint8_t dest = (i == digits.size() - 1 && lowest == 0) ? rd : acc;
+        if (digits[i].second > 0) mipsBuilder->addInstruction(new InstrAdd(dest, acc, rs), "");
+        else mipsBuilder->addInstruction(new InstrSub(dest, acc, rs), "");
+        current = dest;
+    }
+    if (lowest > 0) mipsBuilder->addInstruction(new InstrSll(rd, current, lowest), "");
+    else if (current != rd) mipsBuilder->addInstruction(new InstrAdd(rd, rs, 0), "");
+
+    if (value < 0) mipsBuilder->addInstruction(new InstrSub(rd, 0, rd), "");
+}
+
+// rd = rs / 2^k rounded towards 0: negative numbers get 2^k - 1 added before shifting
+void emit_pow2_div(uint8_t rd, uint8_t rs, int k, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    if (k == 1){
+        mipsBuilder->addInstruction(new InstrSra(1, rs, 31), "");
+        mipsBuilder->addInstruction(new InstrSub(1, rs, 1), "");
+        mipsBuilder->addInstruction(new InstrSra(rd, 1, 1), "");
+        return;
+    }
+    std::string mask = varTracker->add_temp_variable();
+    uint8_t reg_mask = varTracker->getReg(mask);
+    load_constant(reg_mask, (1 << k) - 1, mipsBuilder);
+    mipsBuilder->addInstruction(new InstrSra(1, rs, 31), "");
+    mipsBuilder->addInstruction(new InstrAnd(1, 1, reg_mask), "");
+    mipsBuilder->addInstruction(new InstrAdd(1, rs, 1), "");
+    mipsBuilder->addInstruction(new InstrSra(rd, 1, k), "");
+    varTracker->removeVar(mask);
+}
+
+void emit_reciprocal_div(uint8_t rd, uint8_t rs, int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    Reciprocal r = signed_reciprocal(value);
+    int32_t high, low;
+    split_magic(r.magic, &high, &low);
+
+    std::string low_part = varTracker->add_temp_variable();
+    std::string high_part = varTracker->add_temp_variable();
+    std::string product = varTracker->add_temp_variable();
+    uint8_t reg_low = varTracker->getReg(low_part);
+    uint8_t reg_high = varTracker->getReg(high_part);
+    uint8_t reg_product = varTracker->getReg(product);
+
+    // rs * low >> 16 and rs * high >> 16
+    load_constant(reg_low, low, mipsBuilder);
+    mipsBuilder->addInstruction(new InstrHMul(reg_low, rs, reg_low), "");
+    load_constant(reg_high, high, mipsBuilder);
+    mipsBuilder->addInstruction(new InstrHMul(reg_product, rs, reg_high), "");
+
+    // the bits of rs * high below 16 can carry into the top half once rs * low >> 16 is added
+    emit_mult_by_constant(reg_high, rs, high, mipsBuilder, varTracker);
+    mipsBuilder->addInstruction(new InstrSra(1, reg_high, 16), "");
+    mipsBuilder->addInstruction(new InstrSll(1, 1, 16), "");
+    mipsBuilder->addInstruction(new InstrSub(reg_high, reg_high, 1), "");
+    mipsBuilder->addInstruction(new InstrAdd(reg_high, reg_high, reg_low), "");
+    mipsBuilder->addInstruction(new InstrSra(reg_high, reg_high, 16), "");
+    mipsBuilder->addInstruction(new InstrAdd(reg_product, reg_product, reg_high), "");
+
+    if (r.magic < 0) mipsBuilder->addInstruction(new InstrAdd(reg_product, reg_product, rs), "");
+    if (r.shift > 0) mipsBuilder->addInstruction(new InstrSra(reg_product, reg_product, r.shift), "");
+
+    // the shifts round down, so negative numbers need 1 added to round towards 0
+    mipsBuilder->addInstruction(new InstrSra(1, rs, 31), "");
+    mipsBuilder->addInstruction(new InstrSub(rd, reg_product, 1), "");
+
+    varTracker->removeVar(low_part);
+    varTracker->removeVar(high_part);
+    varTracker->removeVar(product);
+}
+
+void emit_div_by_constant(uint8_t rd, uint8_t rs, int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    int64_t magnitude = value < 0 ? -(int64_t) value : value;
+    bool reducible = value != 0 && magnitude <= INT32_MAX;
+
+    if (reducible && magnitude == 1){
+        if (value > 0 && rd != rs) mipsBuilder->addInstruction(new InstrAdd(rd, rs, 0), "");
+        if (value < 0) mipsBuilder->addInstruction(new InstrSub(rd, 0, rs), "");
+        return;
+    }
+    if (reducible && is_power_of_2(magnitude)){
+        emit_pow2_div(rd, rs, floor_log2(magnitude), mipsBuilder, varTracker);
+    }
+    else if (reducible && reciprocal_div_cost((int32_t) magnitude) + (value < 0) < DIV_CYCLES + load_constant_cost(value)){
+        emit_reciprocal_div(rd, rs, (int32_t) magnitude, mipsBuilder, varTracker);
+    }
+    else {
+        std::string constant = varTracker->add_temp_variable();
+        uint8_t reg_constant = varTracker->getReg(constant);
+        load_constant(reg_constant, value, mipsBuilder);
+        mipsBuilder->addInstruction(new InstrDiv(rd, rs, reg_constant), "");
+        varTracker->removeVar(constant);
+        return;
+    }
+    if (value < 0) mipsBuilder->addInstruction(new InstrSub(rd, 0, rd), "");
+}
+
+void emit_mod_by_constant(uint8_t rd, uint8_t rs, int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker){
+    // the sign of the result only depends on rs
+    int64_t magnitude = value < 0 ? -(int64_t) value : value;
+    if (magnitude == 1){
+        mipsBuilder->addInstruction(new InstrAdd(rd, 0, 0), "");
+        return;
+    }
+
+    std::string quotient = varTracker->add_temp_variable();
+    uint8_t reg_quotient = varTracker->getReg(quotient);
+    if (value != 0 && magnitude <= INT32_MAX && is_power_of_2(magnitude)){
+        int k = floor_log2(magnitude);
+        emit_pow2_div(reg_quotient, rs, k, mipsBuilder, varTracker);
+        mipsBuilder->addInstruction(new InstrSll(reg_quotient, reg_quotient, k), "");
+    }
+    else {
+        emit_div_by_constant(reg_quotient, rs, value, mipsBuilder, varTracker);
+        emit_mult_by_constant(reg_quotient, reg_quotient, value, mipsBuilder, varTracker);
+    }
+    mipsBuilder->addInstruction(new InstrSub(rd, rs, reg_quotient), "");
+    varTracker->removeVar(quotient);
+}
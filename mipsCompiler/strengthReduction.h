@@ -0,0 +1,37 @@
+#ifndef I2C2_STRENGTHREDUCTION_H
+#define I2C2_STRENGTHREDUCTION_H
+
+#include <cstdint>
+
+#include "MipsBuilder.h"
+#include "VariableTracker.h"
+
+// cycles the multdiv unit takes, compared against the instructions a constant operation can be replaced with
+#ifndef MUL_CYCLES
+#define MUL_CYCLES 17
+#endif
+
+#ifndef DIV_CYCLES
+#define DIV_CYCLES 33
+#endif
+
+/// Instructions load_constant takes to build value
+int load_constant_cost(int32_t value);
+
+/// Cycles to compute rs * value with shifts and adds (mul is used if this is more than MUL_CYCLES)
+int mult_by_constant_cost(int32_t value);
+
+/// rd = rs * value. rd can be rs. Uses $1.
+void emit_mult_by_constant(uint8_t rd, uint8_t rs, int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
+/// rd = rs / value, rounding towards 0 like div does. rd can be rs. Uses $1.
+void emit_div_by_constant(uint8_t rd, uint8_t rs, int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
+/// rd = rs % value, with the sign of rs. rd can be rs. Uses $1.
+void emit_mod_by_constant(uint8_t rd, uint8_t rs, int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
+/// rd = rs / value for any value > 1 without a div, by multiplying with the value's reciprocal.
+/// emit_div_by_constant only uses it when it's cheaper than a div.
+void emit_reciprocal_div(uint8_t rd, uint8_t rs, int32_t value, MipsBuilder* mipsBuilder, VariableTracker* varTracker);
+
+#endif //I2C2_STRENGTHREDUCTION_H
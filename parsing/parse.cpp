@@ -155,9 +155,10 @@ Token* parseExpression(TokenIterator& iter, Scope* scope){
             op = makeOperator(tok);
 
             if (op->useLeft){
-                // go left of any non-operators -> can assume working is of type operator
-                while (precedence(op->val_type) <= precedence(working->val_type) &&
-                       op->depth <= working->depth
+                // go left of any non-operators -> can assume working is of type operator.
+                // a group that just closed is done no matter what its operators are
+                while (op->depth < working->depth ||
+                       (precedence(op->val_type) <= precedence(working->val_type) && op->depth <= working->depth)
                        ){
                     if (working->type == TYPE_OPERATOR){
                         auto* working_op = (BinaryOpToken*) working;
@@ -487,6 +488,8 @@ Token* parseDefine(TokenIterator& iter, Scope* scope){
         }
         GroupToken* body = parseGroup(iter, &funcScope);
         func->body = body;
+        // the body uses the definition's names, which can differ from the declaration's
+        func->parameters = params;
         return func;
     }
 
@@ -557,6 +560,70 @@ Token* parseWhile(TokenIterator& iter, Scope* scope){
     return new WhileToken(condition, body, 0);
 }
 
+Token* parseSwitch(TokenIterator& iter, Scope* scope){
+    // eat switch token
+    Token* start = iter.next();
+    if (start->val_type != TokenValue::SWITCH) throw std::runtime_error("Expected switch statement");
+    // check for left parenthesis
+    if (iter.peek()->val_type != TokenValue::LEFT_PAREN) throw std::runtime_error("Expected left parenthesis after switch statement");
+    TokenIterator valueIter = getCondition(iter);
+    Token* value = parseExpression(valueIter, scope);
+    if (valueIter.hasNext()) throw std::runtime_error("Too many expressions in switch statement");
+
+    if (iter.peek()->val_type != TokenValue::LEFT_BRACE) throw std::runtime_error("Expected left brace after switch statement");
+    iter.next();
+    auto* body = new GroupToken(TokenType::TYPE_GROUP, "{}", start->line);
+    auto* switchToken = new SwitchToken(value, body, start->line);
+
+    // the statements between two labels are parsed on their own, into the scope all of the cases share
+    auto* innerScope = new Scope(scope);
+    std::vector<Token*> tokens;
+    auto parseStatements = [&](){
+        TokenIterator innerIter = TokenIterator(tokens);
+        std::vector<Token*> statements = parse(innerIter, innerScope);
+        body->expressions.insert(body->expressions.end(), statements.begin(), statements.end());
+        tokens.clear();
+    };
+
+    int bracketCount = 1;
+    while (iter.hasNext()){
+        Token* t = iter.next();
+        if (t->val_type == TokenValue::LEFT_BRACE) bracketCount++;
+        else if (t->val_type == TokenValue::RIGHT_BRACE){
+            bracketCount--;
+            if (bracketCount == 0){
+                parseStatements();
+                return switchToken;
+            }
+        }
+        // labels in a block inside a case belong to a switch of their own
+        else if (bracketCount == 1 && (t->val_type == TokenValue::CASE || t->val_type == TokenValue::DEFAULT)){
+            parseStatements();
+            int statement = (int) body->expressions.size();
+            if (t->val_type == TokenValue::DEFAULT){
+                if (switchToken->defaultStart != -1) throw std::runtime_error("Switch has more than one default at " + t->toString());
+                switchToken->defaultStart = statement;
+            }
+            else {
+                Token* caseValue = iter.next();
+                if (caseValue == nullptr || caseValue->val_type != TokenValue::NUMBER_INT)
+                    throw std::runtime_error("Case value has to be a whole number at " + t->toString());
+                int v = std::stoi(caseValue->lexeme);
+                for (int other : switchToken->caseValues){
+                    if (other == v) throw std::runtime_error("Duplicate case value " + caseValue->toString());
+                }
+                switchToken->caseValues.push_back(v);
+                switchToken->caseStarts.push_back(statement);
+            }
+            Token* colon = iter.next();
+            if (colon == nullptr || colon->val_type != TokenValue::COLON) throw std::runtime_error("Expected colon after " + t->toString());
+            continue;
+        }
+        tokens.push_back(t);
+    }
+    throw std::runtime_error("Left bracket after " + start->toString() + " has no matching right bracket");
+}
+
 AsmToken* parseAsm(TokenIterator& iter){
     if (iter.peek()->val_type != TokenValue::ASM) throw std::runtime_error("Expected asm statement");
     int line = iter.peek()->line;
@@ -607,6 +674,9 @@ std::vector<Token*> parse(TokenIterator& tokens, Scope* scope){
             else if (t->val_type == TokenValue::WHILE){
                 output.push_back(parseWhile(tokens, scope));
             }
+            else if (t->val_type == TokenValue::SWITCH){
+                output.push_back(parseSwitch(tokens, scope));
+            }
             else if (t->val_type == TokenValue::RETURN){
                 if (scope->isBaseScope()) throw std::runtime_error("Return statement outside of function");
                 tokens.next();
@@ -631,6 +701,10 @@ std::vector<Token*> parse(TokenIterator& tokens, Scope* scope){
             else if (t->val_type == TokenValue::INLINE){
                 output.push_back(parseInlineFunction(tokens, scope));
             }
+            else if (t->val_type == TokenValue::PRAGMA){
+                if (!scope->isBaseScope()) throw std::runtime_error("#pragma inside a function at " + t->toString());
+                output.push_back(tokens.next());
+            }
             else {
                 // continue or return -> error
                 throw std::runtime_error("(parse keyword) Unexpected token " + t->toString());
@@ -29,6 +29,7 @@ std::map<TokenValue, std::string> tokenValueMap = {
 
         {TokenValue::COMMA,         "COMMA"},
         {TokenValue::SEMICOLON,     "SEMICOLON"},
+        {TokenValue::COLON,         "COLON"},
 
         {TokenValue::ADD,           "ADD"},
         {TokenValue::ADD_EQ,        "ADD_EQ"},
@@ -82,6 +83,10 @@ std::map<TokenValue, std::string> tokenValueMap = {
         {TokenValue::WHILE,         "WHILE"},
         {TokenValue::BREAK,         "BREAK"},
         {TokenValue::CONTINUE,      "CONTINUE"},
+        {TokenValue::SWITCH,        "SWITCH"},
+        {TokenValue::CASE,          "CASE"},
+        {TokenValue::DEFAULT,       "DEFAULT"},
+        {TokenValue::PRAGMA,        "PRAGMA"},
         {TokenValue::NIL,           "NIL"},
         {TokenValue::RETURN,        "RETURN"},
 };
@@ -150,6 +155,9 @@ std::vector<Token*> tokenize(std::string source) {
             case ';':
                 tokens.push_back(new Token(TokenType::TYPE_SEPARATOR, TokenValue::SEMICOLON, ";", line));
                 break;
+            case ':':
+                tokens.push_back(new Token(TokenType::TYPE_SEPARATOR, TokenValue::COLON, ":", line));
+                break;
 
             // OPERATOR
             case '+':
@@ -370,6 +378,9 @@ std::vector<Token*> tokenize(std::string source) {
                     else if (word == "while") tokens.push_back(new Token(TokenType::TYPE_KEYWORD, TokenValue::WHILE, word, line));
                     else if (word == "break") tokens.push_back(new Token(TokenType::TYPE_KEYWORD, TokenValue::BREAK, word, line));
                     else if (word == "continue") tokens.push_back(new Token(TokenType::TYPE_KEYWORD, TokenValue::CONTINUE, word, line));
+                    else if (word == "switch") tokens.push_back(new Token(TokenType::TYPE_KEYWORD, TokenValue::SWITCH, word, line));
+                    else if (word == "case") tokens.push_back(new Token(TokenType::TYPE_KEYWORD, TokenValue::CASE, word, line));
+                    else if (word == "default") tokens.push_back(new Token(TokenType::TYPE_KEYWORD, TokenValue::DEFAULT, word, line));
                     else if (word == "NULL") tokens.push_back(new Token(TokenType::TYPE_VALUE, TokenValue::NIL, word, line));
                     else if (word == "return") tokens.push_back(new Token(TokenType::TYPE_KEYWORD, TokenValue::RETURN, word, line));
                     else if (word == "inline") tokens.push_back(new Token(TokenType::TYPE_KEYWORD, TokenValue::INLINE, word, line));
@@ -398,6 +409,17 @@ std::vector<Token*> tokenize(std::string source) {
 
                         defines[define_key] = tokenize(define);
                     }
+                    else if (word == "#pragma"){
+                        // the rest of the line, for whatever reads it
+                        std::string pragma;
+                        current++;
+                        while (current < source.size() && source.at(current) != '\n'){
+                            pragma += source.at(current);
+                            current++;
+                        }
+                        tokens.push_back(new Token(TokenType::TYPE_KEYWORD, TokenValue::PRAGMA, pragma, line));
+                        if (current < source.size() && source.at(current) == '\n') line++;
+                    }
                     else if (defines.find(word) != defines.end()){
                         tokens.insert(tokens.end(), defines[word].begin(), defines[word].end());
                     }
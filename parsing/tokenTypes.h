@@ -32,6 +32,7 @@ enum TokenValue {
     // separators
     COMMA,
     SEMICOLON,
+    COLON,
 
     // operators
     ADD, ADD_EQ,
@@ -56,7 +57,7 @@ enum TokenValue {
     INT, FLOAT, CHAR, DOUBLE, LONG, SHORT, VOID, STRUCT,
 
     // Keywords
-    IF, ELSE, FOR, WHILE, BREAK, CONTINUE, RETURN, ASM, INLINE
+    IF, ELSE, FOR, WHILE, BREAK, CONTINUE, RETURN, ASM, INLINE, SWITCH, CASE, DEFAULT, PRAGMA
 };
 
 std::string tokenTypeAsString(TokenType type);
@@ -245,4 +246,22 @@ public:
 
 };
 
+class SwitchToken : public Token {
+public:
+    Token* value;
+    // every case's statements, one after the other. each case runs on into the next one, until a break
+    GroupToken* body;
+    std::vector<int> caseValues;
+    // the statement in body each case starts at
+    std::vector<int> caseStarts;
+    // -1 without a default
+    int defaultStart;
+
+    SwitchToken(Token* value, GroupToken* body, int line) : Token(TokenType::TYPE_KEYWORD, TokenValue::SWITCH, "switch", line) {
+        this->value = value;
+        this->body = body;
+        this->defaultStart = -1;
+    }
+};
+
 #endif //I2C2_TOKENTYPES_H
@@ -170,6 +170,7 @@ int test_with_regs(std::string source, int cycles, std::map<std::string, int32_t
     std::vector<Token*> token_ptrs =  tokenize(std::move(source));
     TokenIterator tokens_iter(token_ptrs);
     Scope scope(nullptr);
+    declare_runtime(&scope);
     std::vector<Token*> ast = parse(tokens_iter, &scope);
 
     sort_ast(&ast, &scope);
@@ -177,8 +178,10 @@ int test_with_regs(std::string source, int cycles, std::map<std::string, int32_t
     MipsBuilder builder;
     builder.addInstruction(new InstrAddi(29, 29, 2047), "");
     VariableTracker tracker(&builder);
+    find_global_effects(ast, &tracker);
     BreakScope breakScope;
     compile_instructions(&breakScope, ast, &builder, &tracker);
+    link_runtime(&builder, &tracker);
 
     builder.simplify();
 
@@ -717,6 +720,55 @@ TEST(compilation, set_var_to_not){
     test_with_regs(code3, 10, valMap3);
 }
 
+TEST(compilation, if_with_and_or){
+    char code[] = "int a = 3;"
+                  "int b = 4;"
+                  "int r = 0;"
+                  "if (a > 2 && b < 5){ r = r + 1; }"
+                  "if (a > 3 && b < 5){ r = r + 2; }"
+                  "if (a > 3 || b <= 4){ r = r + 10; }"
+                  "if (a > 3 || b > 4){ r = r + 20; }"
+                  "if (!(a == 3) || (b == 4 && a != 0)){ r = r + 100; }"
+                  "if (a == 3 && !(b == 4 || a < 0)){ r = r + 200; }";
+    std::map<std::string, int32_t> valMap = {
+            {"r", 111}
+    };
+    test_with_regs(code, 100, valMap);
+}
+
+TEST(compilation, set_var_to_and_or){
+    char code[] = "int a = 3;"
+                  "int b = 4;"
+                  "int x = a > 2 && b != 4;"
+                  "int y = a < 2 || b < 5;"
+                  "int z = a && b;"
+                  "int w = 0 || a - 3;";
+    std::map<std::string, int32_t> valMap = {
+            {"x", 0},
+            {"y", 1},
+            {"z", 1},
+            {"w", 0}
+    };
+    test_with_regs(code, 60, valMap);
+}
+
+TEST(compilation, and_or_short_circuit){
+    // bump only runs when the left side doesn't decide the result
+    char code[] = "int g = 0;"
+                  "int bump(){ g = g + 1; return 1; }"
+                  "int f(int a){"
+                  " if (a == 1 && bump()){ a = 5; }"
+                  " if (a == 0 || bump()){ a = a + 1; }"
+                  " int d = a == 1 && bump();"
+                  " return g * 10 + d;"
+                  "}"
+                  "int c = f(0);";
+    std::map<std::string, int32_t> valMap = {
+            {"c", 11}
+    };
+    test_with_regs(code, 200, valMap);
+}
+
 TEST(compilation, simple_if_else){
     char code[] = "int a = 1; "
                   "int b = a + 2;"
@@ -974,6 +1026,26 @@ TEST(compilation, for_with_no_init_condition_or_incr){
     test_with_regs(code, 60, valMap);
 }
 
+TEST(compilation, globals_first_used_in_loop){
+    // a9 is one more global than work keeps in registers, and isn't touched before the loop
+    char code[] = "int a1 = 1; int a2 = 1; int a3 = 1; int a4 = 1; int a5 = 1; int a6 = 1; int a7 = 1; int a8 = 1; int a9 = 1;"
+                  "int work(int n){"
+                  " int i = 0;"
+                  " while (i < n){"
+                  "     a1 += a1 + a1; a2 += a2 + a2; a3 += a3 + a3; a4 += a4 + a4;"
+                  "     a5 += a5 + a5; a6 += a6 + a6; a7 += a7 + a7; a8 += a8 + a8;"
+                  "     a9 = a9 + 1;"
+                  "     i += 1;"
+                  " }"
+                  " return a9;"
+                  "}"
+                  "int r = work(4);";
+    std::map<std::string, int32_t> valMap = {
+            {"r", 5}
+    };
+    test_with_regs(code, 400, valMap);
+}
+
 TEST(compilation, function_editing_global_variable){
     char code[] = "int a = 0; "
                   "void foo(){"
@@ -1528,6 +1600,57 @@ TEST(compilation, int_to_float_to_int){
     test_with_regs(code, 30, valMap);
 }
 
+TEST(compilation, fixed_point_mult_and_div){
+    char code[] = "float fmul(float a, float b){ return a * b; }"
+                  "float fdiv(float a, float b){ return a / b; }"
+                  "float lerp(float a, float b, float t){ return (a + (b - a) * t) * 3; }"
+                  "int times(int n, float f){ return n / f; }"
+                  "float p = 0.0;"
+                  "float q = 0.0;"
+                  "float s = 0.0;"
+                  "int t = 0;"
+                  "void run(){"
+                  " p = fmul(1.5, 2.25);"
+                  " q = fdiv(1.5, -2.25);"
+                  " s = lerp(1.0, 3.0, 0.25);"
+                  " t = times(9, 0.5);"
+                  "}"
+                  "run();";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+    builder.linkLabels();
+
+    // float * float is an hmul, and float / float goes through the reciprocal without a div
+    int hmuls = 0, divs = 0;
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    for (Instruction* instr : instructions){
+        if (instr->type == I_HMUL) hmuls++;
+        if (instr->type == I_DIV) divs++;
+    }
+    EXPECT_EQ(hmuls > 0, true, %d)
+    EXPECT_EQ(divs, 0, %d)
+
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.run(2000);
+    // globals live at -get_mem_addr. 1.5 / 2.25 is -43690.67 / 65536, which the reciprocal gets to within one
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("p")), 221184, %d)
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("q")), -43691, %d)
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("s")), 294912, %d)
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("t")), 18, %d)
+}
+
 TEST(compilation, simple_inline_function){
     char code[] = "int a = 0;"
                   "inline int foo(int b){"
@@ -1568,3 +1691,1688 @@ TEST(compilation, inline_function_called_within_function){
 
 }
 
+TEST(compilation, inline_arguments_from_other_scopes){
+    // twice passes its own parameter on, and f passes a global from inside a function
+    char code[] = "int g = 5;"
+                  "inline int inc(int q){"
+                  " return q + 1;"
+                  "}"
+                  "inline int twice(int p){"
+                  " return inc(p) + 1;"
+                  "}"
+                  "int f(){"
+                  " return inc(g);"
+                  "}"
+                  "int a = twice(100);"
+                  "int b = f();";
+    std::map<std::string, int32_t> valMap = {
+            {"a", 102},
+            {"b", 6}
+    };
+    test_with_regs(code, 100, valMap);
+}
+
+TEST(compilation, inline_function_returns_float){
+    char code[] = "inline float half(float x){"
+                  " return x + 0.5;"
+                  "}"
+                  "inline float widen(int x){"
+                  " return x;"
+                  "}"
+                  "inline int narrow(float x){"
+                  " return x;"
+                  "}"
+                  "int a = half(2.5) * 1000;"
+                  "int b = widen(3) * 2.5;"
+                  "int c = narrow(2.75) * 10;";
+    std::map<std::string, int32_t> valMap = {
+            {"a", 3000},
+            {"b", 7},
+            {"c", 20}
+    };
+    test_with_regs(code, 200, valMap);
+}
+
+
+TEST(compilation, values_live_across_calls_in_loop){
+    char code[] = "int foo(int x){"
+                  " return x + 1;"
+                  "}"
+                  "int bar(int a){"
+                  " int n = a;"
+                  " int total = 0;"
+                  " int unused = n * 3;"
+                  " for (int i = 0; i < n; i += 1){"
+                  "  total += foo(i);"
+                  " }"
+                  " return total + foo(n);"
+                  "}"
+                  "int e = bar(4);";
+    std::map<std::string, int32_t> valMap = {
+            {"e", 15}
+    };
+    test_with_regs(code, 300, valMap);
+}
+
+TEST(compilation, one_stack_adjustment_per_function){
+    char code[] = "int foo(int x){"
+                  " return x + 1;"
+                  "}"
+                  "int bar(int a){"
+                  " int b = foo(a);"
+                  " int c = foo(b);"
+                  " return foo(c) + b;"
+                  "}"
+                  "int e = bar(1);";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+
+    // one in bar's prologue, one in its epilogue
+    int sp_adjustments = 0;
+    for (Instruction* instr : builder.getInstructions()){
+        if (instr->export_str().rfind("addi $29, $29", 0) == 0) sp_adjustments++;
+    }
+    EXPECT_EQ(sp_adjustments, 2, %d)
+
+    std::map<std::string, int32_t> valMap = {
+            {"e", 6}
+    };
+    test_with_regs(code, 100, valMap);
+}
+
+TEST(compilation, leaf_function_does_not_touch_stack){
+    char code[] = "int sq(int x){"
+                  " if (x < 0){ return 0 - x; }"
+                  " return x * x;"
+                  "}"
+                  "int main(){"
+                  " return sq(3) + 1;"
+                  "}";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+
+    // only main saves its return address, sq never uses the stack
+    int stack_uses = 0;
+    for (Instruction* instr : builder.getInstructions()){
+        std::string str = instr->export_str();
+        if (str.find("$29") != std::string::npos) stack_uses++;
+    }
+    EXPECT_EQ(stack_uses, 4, %d)
+}
+
+TEST(compilation, return_address_saved_only_on_calling_paths){
+    char code[] = "int foo(int x){"
+                  " return x + 1;"
+                  "}"
+                  "int bar(int a){"
+                  " int r = a;"
+                  " if (a > 2){ r = foo(a); }"
+                  " return r * 2;"
+                  "}"
+                  "int e = bar(1) + bar(5);";
+    std::map<std::string, int32_t> valMap = {
+            {"e", 14}
+    };
+    test_with_regs(code, 200, valMap);
+
+    char code2[] = "int foo(int x){"
+                   " return x + 1;"
+                   "}"
+                   "int baz(int n){"
+                   " int limit = n;"
+                   " int t = 0;"
+                   " while (t < 100){"
+                   "  if (t > limit){ return t; }"
+                   "  t = foo(t);"
+                   " }"
+                   " return 0;"
+                   "}"
+                   "int g = baz(3);";
+    std::map<std::string, int32_t> valMap2 = {
+            {"g", 4}
+    };
+    test_with_regs(code2, 300, valMap2);
+}
+
+TEST(compilation, tail_calls_reuse_frame){
+    // deeper than the stack could hold if every call kept a frame
+    char code[] = "int sum(int n, int acc){"
+                  " if (n == 0){ return acc; }"
+                  " return sum(n - 1, acc + n);"
+                  "}"
+                  "int c = sum(3000, 0);";
+    std::map<std::string, int32_t> valMap = {
+            {"c", 4501500}
+    };
+    test_with_regs(code, 100000, valMap);
+
+    // a state machine that steps by calling itself
+    char code2[] = "int run(int state, int n){"
+                   " if (n == 0){ return state; }"
+                   " if (state == 0){ return run(1, n - 1); }"
+                   " return run(0, n - 1);"
+                   "}"
+                   "int d = run(0, 2501);";
+    std::map<std::string, int32_t> valMap2 = {
+            {"d", 1}
+    };
+    test_with_regs(code2, 100000, valMap2);
+}
+
+TEST(compilation, peephole_keeps_hand_written_registers_across_calls){
+    // inc relies on $8 surviving the jal, which compiled code never does
+    char code[] = "int a = 0;"
+                  "__asm__("
+                  " \"j skip\""
+                  " \"inc: addi $8 $8 1\""
+                  " \"jr $31\""
+                  " \"skip: addi $8 $0 41\""
+                  " \"jal inc\""
+                  " \"add (a) $8 $0\""
+                  ");";
+    std::map<std::string, int32_t> valMap = {
+            {"a", 42}
+    };
+    test_with_regs(code, 50, valMap);
+}
+
+TEST(compilation, peephole_removes_uncalled_functions){
+    char code[] = "int unused(int x){"
+                  " int y = x * 2;"
+                  " return y + 1;"
+                  "}"
+                  "int a = 3;"
+                  "int b = a + 4;";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+
+    std::map<std::string, int> hits = builder.getPeepholeHits();
+    EXPECT_EQ(hits["unreachable code"] > 0, true, %d)
+    for (Instruction* instr : builder.getInstructions()){
+        EXPECT_EQ(instr->type == I_MUL || instr->type == I_JR, false, %d)
+    }
+}
+
+// one peephole rule on its own, with live[i] the registers live after instructions[i].
+// returns what the window becomes, or "no match"
+std::string apply_peephole_rule(const std::string& name, const std::vector<Instruction*>& instructions,
+                                const std::vector<RegSet>& live){
+    for (const PeepholeRule& rule : peephole_rules()){
+        if (rule.name != name) continue;
+        PeepholeMatch match;
+        for (int i = 0; i < instructions.size(); i++){
+            const std::set<InstructionType>& types = rule.pattern[i];
+            if (!types.empty() && types.find(instructions[i]->type) == types.end()) return "no match";
+            match.instrs.push_back(instructions[i]);
+            match.ops.push_back(instructions[i]->get_operands());
+            match.live.push_back(live[i]);
+        }
+        if (!rule.matches(match)) return "no match";
+        std::string result;
+        for (Instruction* instr : rule.rewrite(match)) result += (result.empty() ? "" : "; ") + instr->export_str();
+        return result;
+    }
+    return "no rule " + name;
+}
+
+void expect_rule(const std::string& name, const std::vector<Instruction*>& instructions, const std::vector<RegSet>& live,
+                 const std::string& expected){
+    std::string result = apply_peephole_rule(name, instructions, live);
+    if (result != expected) printf("%s: %s\n", name.c_str(), result.c_str());
+    EXPECT_EQ_SPECIAL(result, expected, %s, .c_str(), .c_str())
+}
+
+TEST(compilation, peephole_rules_before_after){
+    RegSet all = ALL_REGS;
+    expect_rule("addi r, r, 0", {new InstrAddi(8, 8, 0)}, {all}, "");
+    expect_rule("addi r, r, 0", {new InstrAddi(8, 9, 0)}, {all}, "no match");
+
+    expect_rule("shift r, r, 0", {new InstrSll(8, 8, 0)}, {all}, "");
+    expect_rule("shift r, r, 0", {new InstrSra(8, 8, 1)}, {all}, "no match");
+
+    expect_rule("store then load same slot", {new InstrSw(8, 0, 3), new InstrLw(9, 0, 3)},
+                {all, all}, "sw $8, 3($0); add $9, $0, $8");
+    expect_rule("store then load same slot", {new InstrSw(8, 29, 1), new InstrLw(8, 29, 1)},
+                {all, all}, "sw $8, 1($29)");
+    // anywhere but dmem and the stack could be a pin, which reads something else than was written
+    expect_rule("store then load same slot", {new InstrSw(8, 10, 0), new InstrLw(9, 10, 0)},
+                {all, all}, "no match");
+
+    expect_rule("load then store back", {new InstrLw(8, 29, 2), new InstrSw(8, 29, 2)},
+                {all, all}, "lw $8, 2($29)");
+    expect_rule("load then store back", {new InstrLw(8, 29, 2), new InstrSw(8, 29, 3)},
+                {all, all}, "no match");
+
+    expect_rule("move into next use", {new InstrAdd(9, 8, 0), new InstrSub(10, 9, 11)},
+                {all, all & ~REG(9)}, "sub $10, $8, $11");
+    expect_rule("move into next use", {new InstrAdd(9, 8, 0), new InstrSub(10, 9, 11)},
+                {all, all}, "no match");
+
+    expect_rule("move into previous def", {new InstrMul(9, 10, 11), new InstrAdd(12, 9, 0)},
+                {all, all & ~REG(9)}, "mul $12, $10, $11");
+    expect_rule("move into previous def", {new InstrMul(9, 10, 11), new InstrAdd(12, 9, 0)},
+                {all, all}, "no match");
+
+    expect_rule("dead definition", {new InstrAddi(8, 0, 5)}, {all & ~REG(8)}, "");
+    expect_rule("dead definition", {new InstrAddi(8, 0, 5)}, {all}, "no match");
+    // a load from a pin may be what the program is waiting on
+    expect_rule("dead definition", {new InstrLw(8, 9, 0)}, {all & ~REG(8)}, "no match");
+}
+
+TEST(compilation, copies_propagated_across_branches){
+    char code[] = "int f(int a){"
+                  " int b = a;"
+                  " int c = 0;"
+                  " if (a > 3){ c = b + 1; } else { c = b * 2; }"
+                  " return c + b;"
+                  "}"
+                  "int e = f(2) + f(5);";
+    std::map<std::string, int32_t> valMap = {
+            {"e", 17}
+    };
+    test_with_regs(code, 100, valMap);
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+
+    // b, the call arguments and the return values are all read where they were computed
+    for (Instruction* instr : builder.getInstructions()){
+        EXPECT_EQ(move_source(instr), -1, %d)
+    }
+}
+
+TEST(compilation, constant_mult_div_mod_without_multdiv){
+    char code[] = "int f(int a){"
+                  " int b = a;"
+                  " return b * 10 + 7 * b + b / 8 + b % 16 + b * -3;"
+                  "}"
+                  "int e = f(-123);";
+    // -1230 - 861 - 15 - 11 + 369
+    std::map<std::string, int32_t> valMap = {
+            {"e", -1748}
+    };
+    test_with_regs(code, 100, valMap);
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+
+    for (Instruction* instr : builder.getInstructions()){
+        EXPECT_EQ(instr->type == I_MUL || instr->type == I_DIV, false, %d)
+    }
+}
+
+TEST(compilation, mod){
+    char code[] = "int a = -17;"
+                  "int b = 5;"
+                  "int c = a % b;"
+                  "int d = a % 7;"
+                  "b %= 3;";
+    std::map<std::string, int32_t> valMap = {
+            {"c", -2},
+            {"d", -3},
+            {"b", 2}
+    };
+    test_with_regs(code, 100, valMap);
+}
+
+TEST(compilation, reciprocal_division_matches_div){
+    int32_t values[] = {0, 1, -1, 6, -6, 7, -7, 12345, -12345, 2147483647, -2147483647 - 1};
+    int32_t divisors[] = {3, 5, 7, 10, 641, 1000000007};
+    for (int32_t d : divisors){
+        for (int32_t n : values){
+            MipsBuilder builder;
+            VariableTracker tracker(&builder);
+            tracker.add_variable("0-n", 8);
+            load_constant(8, n, &builder);
+            emit_reciprocal_div(8, 8, d, &builder, &tracker);
+            builder.linkLabels();
+
+            std::vector<Instruction*> instructions = builder.getInstructions();
+            MipsRunner runner(2048, instructions.data(), instructions.size());
+            runner.run(100);
+            EXPECT_EQ(runner.get_reg(8), n / d, %d)
+        }
+    }
+}
+
+TEST(compilation, loop_invariants_hoisted_out_of_loop){
+    char code[] = "int f(int a){"
+                  " int b = a;"
+                  " int s = 0;"
+                  " for (int i = 0; i < 10; i = i + 1){ s = s + b * 12 + 1000; }"
+                  " return s;"
+                  "}"
+                  "int e = f(3);";
+    std::map<std::string, int32_t> valMap = {
+            {"e", 10360}
+    };
+    test_with_regs(code, 300, valMap);
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+
+    // b * 12 is worked out once before the loop
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    std::map<std::string, Instruction*> labels = builder.getLabels();
+    std::vector<Loop> loops = find_loops(instructions, labels);
+    ASSERT_EQ(loops.size(), 1, %zu)
+    for (int i = loops[0].header; i <= loops[0].latch; i++){
+        EXPECT_EQ(instructions[i]->type == I_SLL, false, %d)
+    }
+}
+
+TEST(compilation, loop_loads_not_hoisted_past_pointer_stores){
+    char code[] = "int g = 5;"
+                  "int f(int* p){"
+                  " int s = 0;"
+                  " for (int i = 0; i < 3; i = i + 1){ s = s + g; *p = i + 6; }"
+                  " return s;"
+                  "}"
+                  "int e = f(&g);";
+    // 5 + 6 + 7
+    std::map<std::string, int32_t> valMap = {
+            {"e", 18}
+    };
+    test_with_regs(code, 300, valMap);
+}
+
+TEST(compilation, for_loop_trip_counts){
+    std::pair<std::string, int> loops[] = {
+            {"for (int i = 0; i < 64; i += 1){ a = a + i; }", 64},
+            {"for (int i = 0; i <= 20; i = i + 2){ a = a + i; }", 11},
+            {"for (int i = 10; i > 0; i -= 3){ a = a + i; }", 4},
+            {"for (int i = 7; i < 3; i += 1){ a = a + i; }", 0},
+            {"for (int i = 0; i != 12; i += 4){ a = a + i; }", 3},
+            {"for (int i = 0; i != 12; i += 5){ a = a + i; }", -1},
+            {"for (int i = 0; i < a; i += 1){ a = a + i; }", -1},
+            {"for (int i = 0; i < 8; i += 1){ i = i + 1; }", -1},
+            {"for (int i = 0; i < 8; i += 1){ int* p = &i; }", -1},
+    };
+    for (const auto& [loop, trips] : loops){
+        std::string code = "int a = 0;" + loop;
+        std::vector<Token*> token_ptrs = tokenize(code);
+        TokenIterator tokens_iter(token_ptrs);
+        Scope scope(nullptr);
+        std::vector<Token*> ast = parse(tokens_iter, &scope);
+        ASSERT_EQ(ast[1]->val_type, TokenValue::FOR, %d)
+        EXPECT_EQ(constant_trip_count((ForToken*) ast[1]), trips, %d)
+    }
+}
+
+TEST(compilation, unrolled_loops){
+    char code[] = "int f(int a){"
+                  " int s = 0;"
+                  " for (int i = 0; i < 8; i += 1){ int t = i * 3; s = s + t + a; }"
+                  " for (int i = 10; i > 0; i -= 3){ s = s + i; }"
+                  " for (int i = 0; i < 30; i += 1){ if (i == 25){ break; } if (i & 1){ continue; } s = s + i; }"
+                  " return s;"
+                  "}"
+                  "int e = f(2);";
+    // 84 + 16, 10 + 7 + 4 + 1, 0 + 2 + ... + 24
+    std::map<std::string, int32_t> valMap = {
+            {"e", 278}
+    };
+    test_with_regs(code, 1000, valMap);
+}
+
+TEST(compilation, short_loop_fully_unrolled){
+    char code[] = "int s = 0;"
+                  "for (int i = 0; i < 4; i += 1){ s = s + i; }";
+    std::map<std::string, int32_t> valMap = {
+            {"s", 6}
+    };
+    test_with_regs(code, 100, valMap);
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+
+    // no condition and no jump back
+    for (Instruction* instr : builder.getInstructions()){
+        std::string target = instr->get_target();
+        EXPECT_EQ_SPECIAL(target, "", %s, .c_str(),)
+    }
+}
+
+TEST(compilation, stack_array_index_keeps_variable){
+    char code[] = "int f(int k){"
+                  " int a[4] = {1, 2, 3, 4};"
+                  " int b[3] = {5, 6, 7};"
+                  " int i = k;"
+                  " int x = a[i] + b[i + 1];"
+                  " return x * 100 + i;"
+                  "}"
+                  "int e = f(1);";
+    std::map<std::string, int32_t> valMap = {
+            {"e", 901}
+    };
+    test_with_regs(code, 100, valMap);
+}
+
+TEST(compilation, array_loops_use_pointers){
+    char code[] = "int f(int n){"
+                  " int a[40];"
+                  " for (int i = 0; i < 40; i += 1){ a[i] = i * 3; }"
+                  " int s = 0;"
+                  " for (int i = 0; i < n; i += 1){ s = s + a[i]; }"
+                  " for (int i = 1; i < 39; i += 1){ s = s + a[i - 1] - a[i + 1]; }"
+                  " int b[4] = {5, 6, 7, 8};"
+                  " for (int i = 0; i < 4; i += 1){ s = s + b[i]; }"
+                  " return s;"
+                  "}"
+                  "int e = f(40);";
+    // 2340 - 38 * 6 + 26
+    std::map<std::string, int32_t> valMap = {
+            {"e", 2138}
+    };
+    test_with_regs(code, 2000, valMap);
+}
+
+TEST(compilation, nested_loops_over_one_array){
+    // both loops compare against their own end of x
+    char code[] = "int f(int n){"
+                  " int x[5] = {1, 2, 3, 4, 5};"
+                  " int s = 0;"
+                  " for (int i = 0; i < 3; i += 1){"
+                  "  for (int j = 0; j < n; j += 1){ int a = x[i]; int b = x[j]; s += a * b; }"
+                  " }"
+                  " return s;"
+                  "}"
+                  "int e = f(3);";
+    std::map<std::string, int32_t> valMap = {
+            {"e", 36}
+    };
+    test_with_regs(code, 2000, valMap);
+}
+
+TEST(compilation, array_sum_loop_loads_once_per_element){
+    char code[] = "int f(int n){"
+                  " int a[5] = {3, 1, 4, 1, 5};"
+                  " int s = 0;"
+                  " for (int i = 0; i < n; i += 1){ s = s + a[i]; }"
+                  " return s;"
+                  "}"
+                  "int e = f(5);";
+    std::map<std::string, int32_t> valMap = {
+            {"e", 14}
+    };
+    test_with_regs(code, 200, valMap);
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+
+    // lw, add to s, move the pointer, compare it to the end: nothing adds i to a
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    std::map<std::string, Instruction*> labels = builder.getLabels();
+    std::vector<Loop> loops = find_loops(instructions, labels);
+    ASSERT_EQ(loops.size(), 1, %zu)
+    int loads = 0, adds = 0;
+    for (int i = loops[0].header; i <= loops[0].latch; i++){
+        if (instructions[i]->type == I_LW) loads++;
+        if (instructions[i]->type == I_ADD) adds++;
+    }
+    EXPECT_EQ(loads, 1, %d)
+    EXPECT_EQ(adds, 1, %d)
+}
+
+TEST(compilation, loops_branch_once_per_iteration){
+    char code[] = "int f(int n, int a){"
+                  " int b = a;"
+                  " int s = 0;"
+                  " int i = 0;"
+                  " while (i < n){ s = s + b * 12; i = i + 1; if (i == 3){ continue; } s = s + 1; }"
+                  " return s;"
+                  "}"
+                  "int e = f(5, 2);";
+    // 5 * 24 + 4
+    std::map<std::string, int32_t> valMap = {
+            {"e", 124}
+    };
+    test_with_regs(code, 400, valMap);
+
+    char code2[] = "int f(int n){"
+                   " int s = 7;"
+                   " int i = 0;"
+                   " while (i < n){ s = s + 1; i = i + 1; }"
+                   " return s;"
+                   "}"
+                   "int z = f(0);";
+    std::map<std::string, int32_t> valMap2 = {
+            {"z", 7}
+    };
+    test_with_regs(code2, 100, valMap2);
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+
+    // the condition is only checked at the bottom, continue included, and b * 12 still goes in front of the guard
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    std::map<std::string, Instruction*> labels = builder.getLabels();
+    std::vector<Loop> loops = find_loops(instructions, labels);
+    ASSERT_EQ(loops.size(), 1, %zu)
+    std::vector<int> target = jump_targets(instructions, labels);
+    int backward = 0;
+    for (int i = loops[0].header; i <= loops[0].latch; i++){
+        EXPECT_EQ(instructions[i]->type == I_SLL, false, %d)
+        if (target[i] == loops[0].header) backward++;
+    }
+    EXPECT_EQ(backward, 1, %d)
+    EXPECT_EQ(instructions[loops[0].latch]->type == I_BLT, true, %d)
+}
+
+TEST(compilation, comparisons_swap_operands){
+    char code[] = "int a = 3;"
+                  "int b = 4;"
+                  "int r = 0;"
+                  "if (a <= b){ r = r + 1; }"
+                  "if (b <= a){ r = r + 2; }"
+                  "if (a >= 3){ r = r + 4; }"
+                  "if (4 > a){ r = r + 8; }"
+                  "if (3 >= b){ r = r + 16; }"
+                  "if (a <= 2147483647){ r = r + 32; }"
+                  "if (a >= -2147483648){ r = r + 64; }"
+                  "if (!(a > b)){ r = r + 128; }"
+                  "if (a == 3){ r = r + 256; } else { r = r + 512; }"
+                  "int x = a <= b;"
+                  "int y = b <= a;";
+    std::map<std::string, int32_t> valMap = {
+            {"r", 1 + 4 + 8 + 32 + 64 + 128 + 256},
+            {"x", 1},
+            {"y", 0}
+    };
+    test_with_regs(code, 100, valMap);
+
+    char code2[] = "int f(int n){"
+                   " int s = 0;"
+                   " int i = n;"
+                   " while (i <= 20){ s = s + i; i = i + 1; }"
+                   " return s;"
+                   "}"
+                   "int e = f(11);";
+    std::map<std::string, int32_t> valMap2 = {
+            {"e", 155}
+    };
+    test_with_regs(code2, 200, valMap2);
+
+    std::vector<Token*> token_ptrs = tokenize(code2);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+
+    // i <= 20 is i < 21: the loop ends in a single blt, and nothing else branches
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    std::map<std::string, Instruction*> labels = builder.getLabels();
+    std::vector<Loop> loops = find_loops(instructions, labels);
+    ASSERT_EQ(loops.size(), 1, %zu)
+    for (int i = loops[0].header; i < loops[0].latch; i++){
+        EXPECT_EQ(instructions[i]->get_target().empty(), true, %d)
+        EXPECT_EQ(instructions[i]->type == I_SGE, false, %d)
+    }
+    EXPECT_EQ(instructions[loops[0].latch]->type == I_BLT, true, %d)
+}
+
+TEST(compilation, scheduler_separates_loads_from_uses){
+    char code[] = "int g = 3;"
+                  "int h = 4;"
+                  "int f(int a){ int x = g + 1; int y = h * 2; int z = a * 3 + 5; return x + y + z; }"
+                  "int e = f(2);";
+    std::map<std::string, int32_t> valMap = {
+            {"e", 23}
+    };
+    test_with_regs(code, 100, valMap);
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+
+    // the loads of g and h go first, with the work on a filling in behind them
+    std::map<std::string, int> stalls = builder.getStallsRemoved();
+    EXPECT_EQ(stalls["f"], 2, %d)
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    for (int i = 0; i + 1 < instructions.size(); i++){
+        if (instructions[i]->type != I_LW) continue;
+        EXPECT_EQ((reg_uses(instructions[i + 1]) & REG(instructions[i]->get_operands().rd)) == 0, true, %d)
+    }
+}
+
+TEST(compilation, auto_inline_small_functions){
+    char code[] = "int sq(int x){ return x * x; }"
+                  "int add3(int a, int b, int c){ int s = a + b; return s + c; }"
+                  "int fact(int n){ if (n == 0){ return 1; } return n * fact(n - 1); }"
+                  "int f(int n){"
+                  " int t = 0;"
+                  " for (int i = 0; i < n; i += 1){ t += sq(i); }"
+                  " return add3(t, n, fact(3));"
+                  "}"
+                  "int r = f(5);";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    std::vector<InlineDecision> decisions = auto_inline(ast, &tracker);
+    std::map<std::string, bool> inlined;
+    for (const InlineDecision& d : decisions) inlined[d.callee + " in " + d.caller] = d.inlined;
+    EXPECT_EQ(inlined["sq in f"], true, %d)
+    EXPECT_EQ(inlined["add3 in f"], true, %d)
+    EXPECT_EQ(inlined["fact in f"], false, %d)
+    // f has calls inlined into it, so it stays a call
+    EXPECT_EQ(inlined["f in "], false, %d)
+
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+    builder.linkLabels();
+
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    for (Instruction* instr : instructions){
+        if (instr->type != I_JAL) continue;
+        EXPECT_EQ(instr->get_target() == "sq" || instr->get_target() == "add3", false, %d)
+    }
+
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.run(1000);
+    EXPECT_EQ(runner.get_reg(tracker.getReg("r", false)), 41, %d)
+}
+
+TEST(compilation, auto_inline_reasons){
+    // load only reads the address it's given, bump assigns to its parameter through asm
+    char code[] = "inline int load(int q){ __asm__(\"lw $return 0((q))\"); }"
+                  "inline void bump(int q){ __asm__(\"addi (q) (q) 1\"); }"
+                  "int g = 1;"
+                  "int peek(int p){ return load(p) + 1; }"
+                  "int poke(int p){ bump(p); return p; }"
+                  "int setg(int x){ g = 5; return x; }"
+                  "int a = peek(100);"
+                  "int b = poke(100);"
+                  "int c = setg(g);";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    std::map<std::string, InlineDecision> decisions;
+    for (const InlineDecision& d : auto_inline(ast, &tracker)) decisions[d.callee] = d;
+    EXPECT_EQ(decisions["peek"].inlined, true, %d)
+    EXPECT_EQ(decisions["poke"].inlined, false, %d)
+    EXPECT_EQ_SPECIAL(decisions["poke"].reason, std::string("assigns to p"), %s, .c_str(), .c_str())
+    EXPECT_EQ(decisions["setg"].inlined, false, %d)
+    EXPECT_EQ_SPECIAL(decisions["setg"].reason, std::string("changes g, which is passed to it"), %s, .c_str(), .c_str())
+}
+
+TEST(compilation, auto_inline_leaves_unkept_global_writes_to_calls){
+    // g's address is taken and work changes more globals than it keeps in registers, so h isn't promoted there
+    char code[] = "int g = 1;"
+                  "int h = 1;"
+                  "int a1 = 1; int a2 = 1; int a3 = 1; int a4 = 1; int a5 = 1; int a6 = 1; int a7 = 1; int a8 = 1;"
+                  "void incg(){ g = g + 1; }"
+                  "void inch(){ h = h + 1; }"
+                  "int bump(){"
+                  " int* q = &g;"
+                  " for (int i = 0; i < 4; i += 1){ incg(); }"
+                  " return 0;"
+                  "}"
+                  "int work(int n){"
+                  " for (int i = 0; i < n; i += 1){"
+                  "  a1 += a1 + a1; a2 += a2 + a2; a3 += a3 + a3; a4 += a4 + a4;"
+                  "  a5 += a5 + a5; a6 += a6 + a6; a7 += a7 + a7; a8 += a8 + a8;"
+                  "  inch();"
+                  " }"
+                  " return 0;"
+                  "}"
+                  "int b = bump();"
+                  "int r = work(4);"
+                  "int gs = g;"
+                  "int hs = h;";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    std::map<std::string, InlineDecision> decisions;
+    for (const InlineDecision& d : auto_inline(ast, &tracker)) decisions[d.callee + " in " + d.caller] = d;
+    EXPECT_EQ(decisions["incg in bump"].inlined, false, %d)
+    EXPECT_EQ_SPECIAL(decisions["incg in bump"].reason, std::string("changes g, which a pointer can reach"), %s, .c_str(), .c_str())
+    EXPECT_EQ(decisions["inch in work"].inlined, false, %d)
+    EXPECT_EQ_SPECIAL(decisions["inch in work"].reason, std::string("changes h, which work wouldn't keep in a register"),
+                      %s, .c_str(), .c_str())
+
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    link_runtime(&builder, &tracker);
+    builder.simplify("O2");
+    builder.linkLabels();
+
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.run(5000);
+    EXPECT_EQ(runner.get_reg(tracker.getReg("gs", false)), 5, %d)
+    EXPECT_EQ(runner.get_reg(tracker.getReg("hs", false)), 5, %d)
+}
+
+TEST(compilation, inlined_parameters_hide_caller_variables){
+    // useg's x and sub2's a and b are also the caller's names, passed in a different order
+    char code[] = "int g = 10;"
+                  "int useg(int x){ return x + g; }"
+                  "inline int sub2(int a, int b){ return a - b; }"
+                  "int f(int k){"
+                  " int x = 3;"
+                  " int a = useg(x);"
+                  " int b = useg(10);"
+                  " int c = sub2(b, a);"
+                  " int hi = c * 1000;"
+                  " int mid = a * 100;"
+                  " return hi + mid + b;"
+                  "}"
+                  "int r = f(0);";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    std::vector<InlineDecision> decisions = auto_inline(ast, &tracker);
+    int inlined = 0;
+    for (const InlineDecision& d : decisions) inlined += d.callee == "useg" && d.inlined;
+    EXPECT_EQ(inlined, 2, %d)
+
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+    builder.linkLabels();
+
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.run(1000);
+    // a = 13, b = 20, c = 7
+    EXPECT_EQ(runner.get_reg(tracker.getReg("r", false)), 8320, %d)
+}
+
+TEST(compilation, inlined_parameters_assigned_to_dont_change_caller){
+    // bump's a is the caller's a, which the body's assignment can't reach
+    char code[] = "inline int bump(int a){ a = a + 1; return a * 10; }"
+                  "int r2 = 0;"
+                  "int a = 5;"
+                  "int y = bump(a);"
+                  "r2 = a;"
+                  "int r = y * 100 + r2;";
+    std::map<std::string, int32_t> valMap = {
+            {"r", 6005}
+    };
+    test_with_regs(code, 200, valMap);
+}
+
+TEST(compilation, specialize_constant_arguments){
+    char code[] = "int scale(int x, int k, int mode){"
+                  " if (mode == 0){ return x * k; }"
+                  " return x / k;"
+                  "}"
+                  "int f(int a){ return scale(a, 2, 0) + scale(a, 2, 0) + scale(a, 1, 1) + scale(a, a, 1); }"
+                  "int b = 12;"
+                  "int r = f(b);";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    std::vector<Specialization> made = specialize_functions(ast, &tracker);
+    std::map<std::string, int> calls;
+    for (const Specialization& s : made) calls[s.constants] = s.calls;
+    EXPECT_EQ((int) made.size(), 3, %d)
+    EXPECT_EQ(calls["k = 2, mode = 0"], 2, %d)
+    EXPECT_EQ(calls["k = 1, mode = 1"], 1, %d)
+    EXPECT_EQ(calls["mode = 1"], 1, %d)
+
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+    builder.linkLabels();
+
+    // every call has its own copy, so the original is gone, and the copies have no branches left
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    for (Instruction* instr : instructions){
+        EXPECT_EQ(instr->get_target() == "scale", false, %d)
+        EXPECT_EQ(instr->type == I_BNE || instr->type == I_BLT, false, %d)
+    }
+
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.run(1000);
+    EXPECT_EQ(runner.get_reg(tracker.getReg("r", false)), 61, %d)
+}
+
+TEST(compilation, globals_kept_in_registers){
+    char code[] = "int g = 0;"
+                  "int h = 5;"
+                  "int limit = 5;"
+                  "void bump(){ h = h + 1; }"
+                  "int f(){"
+                  " for (int i = 0; i < limit; i += 1){"
+                  "  g = g + i;"
+                  "  if (i == 3){ bump(); }"
+                  " }"
+                  " return g + h;"
+                  "}"
+                  "int reset(){"
+                  " h = 5;"
+                  " bump();"
+                  " return h;"
+                  "}"
+                  "int run(){"
+                  " int a = f();"
+                  " return a * 100 + reset();"
+                  "}"
+                  "int r = run();";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    find_global_effects(ast, &tracker);
+    GlobalEffects effects;
+    EXPECT_EQ(tracker.get_global_effects("run", &effects), true, %d)
+    EXPECT_EQ((int) effects.changed.size(), 2, %d)
+    EXPECT_EQ((int) effects.changed_here.size(), 0, %d)
+
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+    builder.linkLabels();
+
+    // g is loaded once when f starts and stored once when it returns, even though it changes in the loop.
+    // limit is only read, so it's never stored after it's defined
+    std::string g_addr = std::to_string(-tracker.get_mem_addr("g")) + "($0)";
+    std::string limit_addr = std::to_string(-tracker.get_mem_addr("limit")) + "($0)";
+    int g_loads = 0, g_stores = 0, limit_stores = 0;
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    for (Instruction* instr : instructions){
+        std::string str = instr->export_str();
+        bool g = str.size() >= g_addr.size() && str.compare(str.size() - g_addr.size(), g_addr.size(), g_addr) == 0;
+        bool limit = str.size() >= limit_addr.size() &&
+                     str.compare(str.size() - limit_addr.size(), limit_addr.size(), limit_addr) == 0;
+        if (g && str.rfind("lw", 0) == 0) g_loads++;
+        if (g && str.rfind("sw", 0) == 0) g_stores++;
+        if (limit && str.rfind("sw", 0) == 0) limit_stores++;
+    }
+    EXPECT_EQ(g_loads, 1, %d)
+    EXPECT_EQ(g_stores, 2, %d)
+    EXPECT_EQ(limit_stores, 1, %d)
+
+    // bump's changes to h are seen by the functions that call it
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.run(1000);
+    EXPECT_EQ(runner.get_reg(tracker.getReg("r", false)), 1606, %d)
+}
+
+TEST(compilation, globals_stored_through_pointers_arent_written_back){
+    // g's register is only read in f, so the call and the return can't store it over what *q wrote.
+    // h is assigned to by name after its address is taken, which has to reach memory before *p reads it
+    char code[] = "int g = 5;"
+                  "int h = 1;"
+                  "int readg(){ return g; }"
+                  "int f(){"
+                  " int* q = &g;"
+                  " int s = 0;"
+                  " for (int i = 0; i < 3; i += 1){ s += g; *q = g * 2; }"
+                  " int z = readg();"
+                  " return z * 100 + s;"
+                  "}"
+                  "int k(){"
+                  " int* p = &h;"
+                  " h = 7;"
+                  " int before = *p;"
+                  " *p = 9;"
+                  " int z = readg();"
+                  " return before * 10 + h;"
+                  "}"
+                  "int r = f() * 100 + k();";
+    std::map<std::string, int32_t> valMap = {
+            {"r", 403579}
+    };
+    test_with_regs(code, 1000, valMap);
+}
+
+TEST(compilation, large_constants_built_once){
+    char code[] = "int ping(int x){ return x; }"
+                  "int mix(int x){ return x + 100000 + (x ^ 100000); }"
+                  "int spin(int n){"
+                  " int s = 0;"
+                  " for (int i = 0; i < n; i += 1){ s = s + 200001; s = s ^ 77777; }"
+                  " return s;"
+                  "}"
+                  "int pooled(int n){"
+                  " int s = 0;"
+                  " for (int i = 0; i < n; i += 1){ s = s + ping(i) + 200003; }"
+                  " return s;"
+                  "}"
+                  "int once(int x){ return x + 300003; }"
+                  "int run(){ return mix(3) + spin(10) + once(1) - pooled(4); }"
+                  "int r = run();";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+    builder.linkLabels();
+
+    // mix keeps 100000 in a register, spin builds its constants once before the loop, pooled loads 200003 from the
+    // pool after each call instead of building it, and once builds its only constant where it's used.
+    // the pool is filled in once at the start
+    int builds = 0, pool_loads = 0;
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    for (Instruction* instr : instructions){
+        std::string str = instr->export_str();
+        if (str.find("sll") == 0 && str.find(", 16") != std::string::npos) builds++;
+        if (str.find("lw") == 0 && str.find("($0)") != std::string::npos) pool_loads++;
+    }
+    EXPECT_EQ(builds, 5, %d)
+    EXPECT_EQ(pool_loads, 1, %d)
+
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.run(2000);
+    EXPECT_EQ(runner.get_reg(tracker.getReg("r", false)), 1810730 - 800018, %d)
+}
+
+TEST(compilation, switch_jump_table_and_search){
+    char code[] = "int dense(int x){"
+                  " int y = 0;"
+                  " switch (x) {"
+                  "  case 0: y = 10; break;"
+                  "  case 1: y = 11;"
+                  "  case 2: y += 12; break;"
+                  "  case 3: y = 13; break;"
+                  "  case 5: y = 15; break;"
+                  "  default: y = -1;"
+                  " }"
+                  " return y;"
+                  "}"
+                  "int sparse(int x){"
+                  " switch (x) {"
+                  "  case -100: return 1;"
+                  "  case 7: return 2;"
+                  "  case 1000: return 3;"
+                  "  case 5000: return 4;"
+                  "  case 70000: return 5;"
+                  "  case 12: return 6;"
+                  "  case 99: { return 7; }"
+                  " }"
+                  " return 0;"
+                  "}"
+                  "int a = 0;"
+                  "int b = 0;"
+                  "int n = 0;"
+                  "void run(){"
+                  " int i = 0;"
+                  " while (i < 7){ a = a * 3 + dense(i); i += 1; }"
+                  " b = sparse(-100) + sparse(7) * 10 + sparse(1000) * 100 + sparse(5000) * 1000 + sparse(70000) * 10000 +"
+                  "     sparse(12) * 100000 + sparse(99) * 1000000 + sparse(3) * 10000000;"
+                  " i = 0;"
+                  " while (i < 10){"
+                  "  i += 1;"
+                  "  switch (i % 4) { case 0: continue; case 1: n += 1; break; default: n += 10; }"
+                  "  n += 100;"
+                  " }"
+                  "}"
+                  "run();";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+    builder.linkLabels();
+
+    // the dense cases jump through the table, and only the functions return with jr $31
+    int table_jumps = 0;
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    for (Instruction* instr : instructions){
+        if (instr->type == I_JR && instr->get_operands().rd != 31) table_jumps++;
+    }
+    EXPECT_EQ(table_jumps, 1, %d)
+
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.run(5000);
+    int expected = 0;
+    for (int y : {10, 23, 12, 13, -1, 15, -1}) expected = expected * 3 + y;
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("a")), expected, %d)
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("b")), 7654321, %d)
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("n")), 853, %d)
+}
+
+TEST(compilation, jump_tables_in_data_image){
+    char code[] = "int dense(int x){"
+                  " int y = 0;"
+                  " switch (x) {"
+                  "  case 0: y = 10; break;"
+                  "  case 1: y = 11;"
+                  "  case 2: y += 12; break;"
+                  "  case 3: y = 13; break;"
+                  "  case 5: y = 15; break;"
+                  "  default: y = -1;"
+                  " }"
+                  " return y;"
+                  "}"
+                  "int run(){"
+                  " int a = 0;"
+                  " int i = 0;"
+                  " while (i < 7){ a = a * 3 + dense(i); i += 1; }"
+                  " return a;"
+                  "}"
+                  "int r = run();";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    tracker.set_data_image(true);
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+    builder.linkLabels();
+
+    // the table's labels are linked into the image, so the program doesn't store them before the call
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    EXPECT_EQ_SPECIAL(instructions[1]->export_str(), "jal run", %s, .c_str(),)
+    int la = 0;
+    for (Instruction* instr : instructions) la += instr->type == I_LA;
+    EXPECT_EQ(la, 0, %d)
+
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.load_dmem(tracker.get_static_data());
+    runner.run(2000);
+    int expected = 0;
+    for (int y : {10, 23, 12, 13, -1, 15, -1}) expected = expected * 3 + y;
+    EXPECT_EQ(runner.get_reg(tracker.getReg("r", false)), expected, %d)
+}
+
+TEST(compilation, frame_planned_before_body){
+    char code[] = "int six(int a, int b, int c, int d, int e, int f){"
+                  " return a + b + c + d + e + f;"
+                  "}"
+                  "void set(int* p, int v){ *p = v; }"
+                  "int work(int n){"
+                  " int total = 0;"
+                  " int i = 0;"
+                  " while (i < n){"
+                  "  int buf[4] = {1, 2, 3, 4};"
+                  "  total += buf[i % 4] + six(i, 1, 2, 3, 4, 5);"
+                  "  i += 1;"
+                  " }"
+                  " if (n > 2){"
+                  "  int big[3] = {7, 8, 9};"
+                  "  total += big[2];"
+                  " }"
+                  " else {"
+                  "  int small[2] = {5, 6};"
+                  "  total += small[1];"
+                  " }"
+                  " int x = 0;"
+                  " set(&x, 40);"
+                  " return total + x;"
+                  "}"
+                  "int e = work(5) * 1000 + work(1);";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+
+    // the arrays, six's last two arguments, x's slot and the saved registers all come from work's prologue
+    int sp_adjustments = 0;
+    int ra_offset = -1;
+    for (Instruction* instr : builder.getInstructions()){
+        std::string str = instr->export_str();
+        if (str.rfind("addi $29, $29", 0) == 0) sp_adjustments++;
+        if (str.rfind("sw $31, ", 0) == 0) ra_offset = std::stoi(str.substr(8));
+    }
+    EXPECT_EQ(sp_adjustments, 2, %d)
+    // the save area goes above 2 words of arguments, 1 for x and 4 for the arrays:
+    // big and small share theirs, and buf's are free again by then
+    EXPECT_EQ(ra_offset, 7, %d)
+
+    std::map<std::string, int32_t> valMap = {
+            {"e", 145062}
+    };
+    test_with_regs(code, 1000, valMap);
+}
+
+TEST(compilation, heap_runtime_linked_on_demand){
+    char code[] = "int total = 0;"
+                  "int same = 0;"
+                  "int big_same = 0;"
+                  "int after_reset = 0;"
+                  "int sum(int* p, int n){"
+                  " int s = 0;"
+                  " int i = 0;"
+                  " while (i < n){ s += p[i]; i += 1; }"
+                  " return s;"
+                  "}"
+                  "void main(){"
+                  " int* a = malloc(4);"
+                  " int* b = malloc(3);"
+                  " int i = 0;"
+                  " while (i < 4){ a[i] = i + 1; i += 1; }"
+                  " b[0] = 10; b[1] = 20; b[2] = 30;"
+                  " total = sum(a, 4) + sum(b, 3);"
+                  " free(a);"
+                  " int* c = malloc(4);"
+                  " same = c == a;"
+                  " int* d = malloc(40);"
+                  " free(d);"
+                  " int* e = malloc(30);"
+                  " big_same = e == d;"
+                  " arena_reset();"
+                  " int* f = malloc(2);"
+                  " after_reset = f == a;"
+                  "}";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    declare_runtime(&scope);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    link_runtime(&builder, &tracker);
+    builder.prependInstruction(new InstrAddi(28, 0, tracker.get_mem_offset()));
+    builder.simplify();
+    builder.linkLabels();
+
+    // the runtime functions are added under their own names, after the program
+    std::map<std::string, Instruction*> labels = builder.getLabels();
+    EXPECT_TRUE(labels.find("malloc") != labels.end())
+    EXPECT_TRUE(labels.find("free") != labels.end())
+    EXPECT_TRUE(labels.find("arena_reset") != labels.end())
+
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.run(5000);
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("total")), 70, %d)
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("same")), 1, %d)
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("big_same")), 1, %d)
+    EXPECT_EQ(runner.get_mem(-tracker.get_mem_addr("after_reset")), 1, %d)
+
+    // a program that never allocates gets none of it
+    char plain[] = "int x = 1;";
+    std::vector<Token*> plain_ptrs = tokenize(plain);
+    TokenIterator plain_iter(plain_ptrs);
+    Scope plain_scope(nullptr);
+    declare_runtime(&plain_scope);
+    std::vector<Token*> plain_ast = parse(plain_iter, &plain_scope);
+    MipsBuilder plain_builder;
+    VariableTracker plain_tracker(&plain_builder);
+    compile_instructions(&breakScope, plain_ast, &plain_builder, &plain_tracker);
+    int before = plain_builder.numInstructions();
+    link_runtime(&plain_builder, &plain_tracker);
+    EXPECT_EQ(plain_builder.numInstructions(), before, %d)
+}
+
+TEST(compilation, memory_loops_become_intrinsics){
+    char code[] = "int work(int n){"
+                  " int a[32];"
+                  " int b[32];"
+                  " int e[8];"
+                  " int big[24] = {1, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 4};"
+                  " for (int i = 0; i < n; i += 1){ a[i] = 7; }"
+                  " for (int j = 0; j < n; j += 1){ b[j] = a[j]; }"
+                  " for (int m = 0; m < 8; m += 1){ e[m] = a[m]; }"
+                  " int c[4];"
+                  " memset(c, 5, 4);"
+                  " int d[4];"
+                  " memcpy(d, c, 4);"
+                  " int s = d[0] + d[3];"
+                  " int k = 0;"
+                  " while (k < n){ s += b[k]; k += 1; }"
+                  " k = 0;"
+                  " while (k < 8){ s += e[k]; k += 1; }"
+                  " k = 0;"
+                  " while (k < 24){ s += big[k]; k += 1; }"
+                  " return s;"
+                  "}"
+                  "int r = work(30);";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    declare_runtime(&scope);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    VariableTracker tracker(&builder);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+
+    // the fill with n and the run of zeros call memset, the copy with n calls memcpy,
+    // and the rest have sizes known here, so they're done in place
+    int memset_calls = 0;
+    int memcpy_calls = 0;
+    for (Instruction* instr : builder.getInstructions()){
+        std::string str = instr->export_str();
+        if (str == "jal memset") memset_calls++;
+        if (str == "jal memcpy") memcpy_calls++;
+    }
+    EXPECT_EQ(memset_calls, 2, %d)
+    EXPECT_EQ(memcpy_calls, 1, %d)
+
+    // 10 from d, 7 * 30 from b, 7 * 8 from e and 10 from big
+    std::map<std::string, int32_t> valMap = {
+            {"r", 286}
+    };
+    test_with_regs(code, 3000, valMap);
+}
+
+TEST(compilation, program_memory_functions_not_replaced){
+    // the program's memset only sets the first word, and is called even with a size known here.
+    // the fill loop and the run of zeros don't become calls to it
+    char code[] = "void memset(int* d, int v, int n){ d[0] = 99; }"
+                  "int work(int n){"
+                  " int buf[4] = {0, 0, 0, 0};"
+                  " memset(buf, 7, 4);"
+                  " int a[20];"
+                  " for (int i = 0; i < n; i += 1){ a[i] = 3; }"
+                  " int z[20] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4};"
+                  " int s = 1000 * buf[0] + 100 * buf[1];"
+                  " s += a[0] + a[1];"
+                  " s += 10 * z[5] + z[19];"
+                  " return s;"
+                  "}"
+                  "int r = work(20);";
+    std::map<std::string, int32_t> valMap = {
+            {"r", 99010}
+    };
+    test_with_regs(code, 2000, valMap);
+}
+
+TEST(compilation, globals_start_in_data_image){
+    char code[] = "int table[8] = {3, 1, 4, 1, 5, 9, 2, 6};"
+                  "int grid[2][2] = {{1, 2}, {3, 4}};"
+                  "float scale = 1.5;"
+                  "int count = 8;"
+                  "int work(){"
+                  " int s = 0;"
+                  " for (int i = 0; i < count; i += 1){ s += table[i]; }"
+                  " int t = scale * 4;"
+                  " int corner = grid[3];"
+                  " return s * 100 + corner * 10 + t;"
+                  "}"
+                  "int r = work();";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    tracker.set_data_image(true);
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+    builder.linkLabels();
+
+    // nothing runs before the call: the globals and the arrays' addresses are all in the image
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    EXPECT_EQ_SPECIAL(instructions[1]->export_str(), "jal work", %s, .c_str(),)
+    std::vector<int32_t> data = tracker.get_static_data();
+    EXPECT_EQ(data[-tracker.get_mem_addr("scale")], 3 << 15, %d)
+    EXPECT_EQ(data[data[-tracker.get_mem_addr("table")] + 5], 9, %d)
+
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.load_dmem(data);
+    runner.run(2000);
+    EXPECT_EQ(runner.get_reg(tracker.getReg("r", false)), 3100 + 40 + 6, %d)
+}
+
+TEST(compilation, data_image_globals_first_used_in_loop){
+    // g is never in a register before the loop, and nothing stores it to memory first
+    char code[] = "int g = 5;"
+                  "int s = 0;"
+                  "int j = 0;"
+                  "while (j < 3){ s += g; j += 1; }"
+                  "int r = s;";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    tracker.set_data_image(true);
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    builder.simplify();
+    builder.linkLabels();
+
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.load_dmem(tracker.get_static_data());
+    runner.run(200);
+    EXPECT_EQ(runner.get_reg(tracker.getReg("r", false)), 15, %d)
+}
+
+TEST(compilation, constant_pool_and_heap_heads_in_data_image){
+    char code[] = "int ping(int x){ return x; }"
+                  "int pooled(int n){"
+                  " int s = 0;"
+                  " for (int i = 0; i < n; i += 1){ s = s + ping(i) + 200003; }"
+                  " return s;"
+                  "}"
+                  "int work(){"
+                  " int* a = malloc(2);"
+                  " a[1] = pooled(4);"
+                  " free(a);"
+                  " int* b = malloc(2);"
+                  " return (a == b) + a[1];"
+                  "}"
+                  "int r = work();";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    declare_runtime(&scope);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    tracker.set_data_image(true);
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    link_runtime(&builder, &tracker);
+    builder.prependInstruction(new InstrAddi(28, 0, tracker.get_mem_offset()));
+    builder.simplify();
+    builder.linkLabels();
+
+    // neither the pooled 200003 nor the empty free lists are stored by the program before the call
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    EXPECT_EQ_SPECIAL(instructions[2]->export_str(), "jal work", %s, .c_str(),)
+    std::vector<int32_t> data = tracker.get_static_data();
+    EXPECT_EQ((int) data.size(), tracker.get_mem_offset(), %d)
+    EXPECT_EQ((int) std::count(data.begin(), data.end(), 200003), 1, %d)
+
+    MipsRunner runner(2048, instructions.data(), instructions.size());
+    runner.load_dmem(data);
+    runner.run(3000);
+    EXPECT_EQ(runner.get_reg(tracker.getReg("r", false)), 1 + 6 + 4 * 200003, %d)
+}
+
+TEST(compilation, memory_budget_follows_calls){
+    char code[] = "int leaf(int x){ return x + 1; }"
+                  "int mid(int x){ int y = leaf(x); return y + leaf(y); }"
+                  "int fib(int n){ if (n < 2) { return mid(n); } return fib(n - 1) + fib(n - 2); }\n"
+                  "#pragma max_recursion fib 12\n"
+                  "int spin(int n){ if (n == 0) { return 0; } return spin(n - 1) + 1; }"
+                  "int count(int n, int acc){ if (n == 0) { return acc; } return count(n - 1, acc + n); }"
+                  "int r = fib(5);"
+                  "int s = spin(3);"
+                  "int t = count(4, 0);";
+
+    std::vector<Token*> token_ptrs = tokenize(code);
+    TokenIterator tokens_iter(token_ptrs);
+    Scope scope(nullptr);
+    std::vector<Token*> ast = parse(tokens_iter, &scope);
+    sort_ast(&ast, &scope);
+
+    MipsBuilder builder;
+    builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+    VariableTracker tracker(&builder);
+    find_global_effects(ast, &tracker);
+    BreakScope breakScope;
+    compile_instructions(&breakScope, ast, &builder, &tracker);
+    link_runtime(&builder, &tracker);
+
+    MemoryBudget budget = analyze_memory_budget(ast, &tracker);
+    std::map<std::string, FunctionStack> functions;
+    for (const FunctionStack& f : budget.functions) functions[f.name] = f;
+
+    EXPECT_EQ(functions["leaf"].depth, 0, %d)
+    EXPECT_GT(functions["mid"].frame, 0)
+    EXPECT_EQ(functions["mid"].depth, functions["mid"].frame, %d)
+    // fib can be running 12 times at once, and the last one calls mid
+    EXPECT_EQ(functions["fib"].depth, 12 * functions["fib"].frame + functions["mid"].depth, %d)
+    EXPECT_EQ_SPECIAL(show_chain(budget.deepest), std::string("fib x12 > mid > leaf"), %s, .c_str(), .c_str())
+    EXPECT_EQ(budget.stack, functions["fib"].depth, %d)
+    EXPECT_EQ(budget.free_words, 2047 - budget.globals - budget.stack, %d)
+
+    // spin has no bound, so it's counted once and warned about
+    EXPECT_EQ(functions["spin"].depth, functions["spin"].frame, %d)
+    EXPECT_EQ((int) budget.warnings.size(), 1, %d)
+    // count calls itself only as a jump that reuses its frame, so it isn't recursive as far as the stack goes
+    EXPECT_EQ(functions["count"].depth, functions["count"].frame, %d)
+    EXPECT_EQ_SPECIAL(show_chain(functions["count"].deepest), std::string("count"), %s, .c_str(), .c_str())
+
+    std::vector<Token*> bad = tokenize("#pragma max_recursion fib\nint fib(int n){ return n; }");
+    TokenIterator bad_iter(bad);
+    Scope bad_scope(nullptr);
+    std::vector<Token*> bad_ast = parse(bad_iter, &bad_scope);
+    bool threw = false;
+    try { analyze_memory_budget(bad_ast, &tracker); }
+    catch (std::runtime_error& e) { threw = true; }
+    EXPECT_TRUE(threw)
+}
+
+// instructions from a function's label to the next one's
+int function_length(MipsBuilder& builder, const std::string& function, const std::string& next){
+    std::vector<Instruction*> instructions = builder.getInstructions();
+    std::map<std::string, Instruction*> labels = builder.getLabels();
+    int start = (int) (std::find(instructions.begin(), instructions.end(), labels[function]) - instructions.begin());
+    int end = (int) (std::find(instructions.begin(), instructions.end(), labels[next]) - instructions.begin());
+    return end - start;
+}
+
+TEST(compilation, pipelines_per_function){
+    char code[] = "int slow(int n){ int s = 0; for (int i = 0; i < n; i += 1){ int k = n * 3; s += i + k; } return s; }"
+                  "int fast(int n){ int s = 0; for (int i = 0; i < n; i += 1){ int k = n * 3; s += i + k; } return s; }"
+                  "int a = slow(5);"
+                  "int b = fast(5);"
+                  "int c = a + b;";
+
+    std::map<std::string, int> lengths;
+    for (const std::string& level : {"O0", "O1", "mixed"}){
+        std::vector<Token*> token_ptrs = tokenize(code);
+        TokenIterator tokens_iter(token_ptrs);
+        Scope scope(nullptr);
+        std::vector<Token*> ast = parse(tokens_iter, &scope);
+        sort_ast(&ast, &scope);
+
+        MipsBuilder builder;
+        builder.addInstruction(new InstrAddi(29, 29, 2047), "");
+        VariableTracker tracker(&builder);
+        find_global_effects(ast, &tracker);
+        BreakScope breakScope;
+        compile_instructions(&breakScope, ast, &builder, &tracker);
+        if (level == "mixed") builder.setFunctionLevel("slow", "O0");
+        builder.simplify(level == "mixed" ? "O1" : level);
+        builder.linkLabels();
+
+        std::vector<Instruction*> instructions = builder.getInstructions();
+        MipsRunner runner(2048, instructions.data(), instructions.size());
+        runner.run(500);
+        EXPECT_EQ(runner.get_reg(tracker.getReg("c", false)), 170, %d)
+        lengths["slow " + level] = function_length(builder, "slow", "fast");
+
+        std::map<std::string, int> runs;
+        for (const PassTiming& t : builder.getPassTimings()) runs[t.pass] = t.runs;
+        EXPECT_EQ(runs["jumps"], 2, %d)
+        EXPECT_EQ(runs["schedule"], (level == "O0" ? 0 : 1), %d)
+    }
+    // slow is left as O0 would leave it, and fast still gets its multiply out of the loop
+    EXPECT_EQ(lengths["slow mixed"], lengths["slow O0"], %d)
+    EXPECT_LT(lengths["slow O1"], lengths["slow O0"])
+
+    MipsBuilder builder;
+    bool threw = false;
+    try { builder.setFunctionLevel("slow", "O9"); }
+    catch (std::runtime_error& e) { threw = true; }
+    EXPECT_TRUE(threw)
+}
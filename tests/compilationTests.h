@@ -7,6 +7,14 @@
 
 #include "testFramework/TestFramework.h"
 #include "../mipsCompiler/MipsCompiler.h"
+#include "../mipsCompiler/strengthReduction.h"
+#include "../mipsCompiler/MipsLoops.h"
+#include "../mipsCompiler/astAnalysis.h"
+#include "../mipsCompiler/inliner.h"
+#include "../mipsCompiler/specializer.h"
+#include "../mipsCompiler/globalPromotion.h"
+#include "../mipsCompiler/runtime.h"
+#include "../mipsCompiler/memoryBudget.h"
 #include "../parsing/tokenize.h"
 #include "../parsing/parse.h"
 